@@ -0,0 +1,37 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Compiles a configuration into a binary image that ConfigTree::loadFile() maps
+// without parsing.
+
+#include "config_tree.hh"
+#include <exception>
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <input.lua|.json|.ini> <output.cfb>\n";
+        return 2;
+    }
+    try {
+        confetti::ConfigTree::loadFile(argv[1]).saveBinaryFile(argv[2]);
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,202 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "config_access_log.hh"
+#include "internal/hash.hh"
+#include <algorithm>
+#include <array>
+#include <ostream>
+#include <thread>
+
+namespace confetti {
+
+namespace {
+
+constexpr size_t maxDepth = 8;
+
+std::atomic<uint64_t> nextId{1};
+
+template <typename T>
+void increment(std::atomic<T>& counter, T value) noexcept
+{
+    // Only one thread writes each counter, so there is nothing to read-modify-write.
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+} // namespace
+
+ConfigAccessLog::ConfigAccessLog()
+    : id_{nextId.fetch_add(1, std::memory_order_relaxed)}
+{
+}
+
+ConfigAccessLog::~ConfigAccessLog() = default;
+
+ConfigAccessLog::ThreadLog& ConfigAccessLog::getThreadLog()
+{
+    // Logs are told apart by id rather than by address, which a new log may reuse.
+    struct CacheEntry final {
+        uint64_t id;
+        ThreadLog* log;
+    };
+    thread_local std::array<CacheEntry, 4> cache{};
+    thread_local size_t next = 0;
+    for (const auto& entry : cache) {
+        if (entry.id == id_)
+            return *entry.log;
+    }
+
+    ThreadLog* log = nullptr;
+    {
+        std::lock_guard lock{mutex_};
+        const auto thread = std::this_thread::get_id();
+        const auto it = std::find_if(threads_.begin(), threads_.end(),
+            [thread](const auto& other) { return other->thread == thread; });
+        if (it != threads_.end()) {
+            log = it->get();
+        } else {
+            log = threads_.emplace_back(std::make_unique<ThreadLog>()).get();
+            log->thread = thread;
+        }
+    }
+    cache[next] = CacheEntry{id_, log};
+    next = (next + 1) % cache.size();
+    return *log;
+}
+
+void ConfigAccessLog::watch(const ConfigSourcePointer& root)
+{
+    std::lock_guard lock{mutex_};
+    std::erase_if(roots_, [](const auto& other) { return other.expired(); });
+    roots_.emplace_back(root);
+}
+
+void ConfigAccessLog::record(uint64_t hash, std::string_view prefix, std::string_view key,
+    bool hit, std::chrono::nanoseconds time)
+{
+    auto& log = getThreadLog();
+    auto it = log.counters.find(hash);
+    if (it == log.counters.end()) {
+        std::lock_guard lock{log.mutex};
+        it = log.counters.try_emplace(hash).first;
+        it->second.path.assign(prefix).append(key);
+    }
+    auto& counter = it->second;
+    increment(counter.reads, uint64_t{1});
+    if (!hit)
+        increment(counter.misses, uint64_t{1});
+    increment(counter.nanoseconds, static_cast<uint64_t>(time.count()));
+}
+
+std::unordered_map<uint64_t, ConfigAccessLog::KeyStats> ConfigAccessLog::merge() const
+{
+    std::unordered_map<uint64_t, KeyStats> result;
+    std::lock_guard lock{mutex_};
+    for (const auto& thread : threads_) {
+        std::lock_guard threadLock{thread->mutex};
+        for (const auto& [hash, counter] : thread->counters) {
+            auto& stats = result[hash];
+            if (stats.path.empty())
+                stats.path = counter.path;
+            stats.reads += counter.reads.load(std::memory_order_relaxed);
+            stats.misses += counter.misses.load(std::memory_order_relaxed);
+            stats.time += std::chrono::nanoseconds{
+                static_cast<int64_t>(counter.nanoseconds.load(std::memory_order_relaxed))};
+        }
+    }
+    return result;
+}
+
+std::vector<ConfigAccessLog::KeyStats> ConfigAccessLog::getStats() const
+{
+    std::vector<KeyStats> result;
+    for (auto& [hash, stats] : merge())
+        result.push_back(std::move(stats));
+    std::sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.reads != rhs.reads ? lhs.reads > rhs.reads : lhs.path < rhs.path;
+    });
+    return result;
+}
+
+// Adds paths of values under the source that were not read. Returns whether the
+// source has any named entries, as sources without them count as values.
+static bool findUnusedKeys(const ConfigSource& source,
+    const std::unordered_map<uint64_t, ConfigAccessLog::KeyStats>& stats, std::string& path,
+    size_t depth, std::vector<std::string>& result)
+{
+    const auto cursor = source.getItems();
+    const auto size = path.size();
+    bool found = false;
+    while (cursor->next()) {
+        found = true;
+        path.resize(size);
+        if (size > 0)
+            path.push_back('.');
+        path.append(cursor->getKey());
+        // Values computed by code are reported as values, without running the code.
+        if (depth + 1 < maxDepth && cursor->isTable()) {
+            if (const auto child = cursor->getChild();
+                child && findUnusedKeys(*child, stats, path, depth + 1, result))
+                continue;
+        }
+        const auto hash = internal::hash(path);
+        if (!stats.contains(hash) && !stats.contains(internal::hash("[]", hash)))
+            result.push_back(path);
+    }
+    path.resize(size);
+    return found;
+}
+
+std::vector<std::string> ConfigAccessLog::getUnusedKeys() const
+{
+    const auto stats = merge();
+    std::vector<ConfigSourcePointer> roots;
+    {
+        std::lock_guard lock{mutex_};
+        for (const auto& root : roots_) {
+            if (auto source = root.lock())
+                roots.push_back(std::move(source));
+        }
+    }
+    std::vector<std::string> result;
+    std::string path;
+    for (const auto& root : roots)
+        findUnusedKeys(*root, stats, path, 0, result);
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+void ConfigAccessLog::writeReport(std::ostream& stream, size_t hottest) const
+{
+    const auto stats = getStats();
+    stream << "Hottest keys (reads, misses, average time):\n";
+    for (size_t i = 0; i < std::min(hottest, stats.size()); ++i) {
+        const auto& key = stats[i];
+        stream << "  " << key.path << ' ' << key.reads << ' ' << key.misses << ' '
+               << (key.time / static_cast<int64_t>(key.reads)).count() << "ns\n";
+    }
+    stream << "Missed keys (misses):\n";
+    for (const auto& key : stats) {
+        if (key.misses > 0)
+            stream << "  " << key.path << ' ' << key.misses << '\n';
+    }
+    stream << "Unused keys:\n";
+    for (const auto& path : getUnusedKeys())
+        stream << "  " << path << '\n';
+}
+
+} // namespace confetti
@@ -0,0 +1,100 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_CONFIG_ACCESS_LOG_HH
+#define CONFETTI_CONFIG_ACCESS_LOG_HH
+
+#include "config_source.hh"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace confetti {
+
+/// Counts reads of instrumented configurations by path, see ConfigTree::instrument().
+/// Elements of arrays are counted together, as `path[]`.
+///
+/// Every thread counts into its own table without locks or shared writes. Readers of
+/// the log merge the tables of all threads, so they may run at any time.
+class ConfigAccessLog final {
+public:
+    struct KeyStats final {
+        std::string path;
+        uint64_t reads{};
+        uint64_t misses{};
+        std::chrono::nanoseconds time{};
+    };
+
+    ConfigAccessLog();
+
+    ConfigAccessLog(const ConfigAccessLog&) = delete;
+    ConfigAccessLog& operator=(const ConfigAccessLog&) = delete;
+
+    ~ConfigAccessLog();
+
+    /// Merged counters of all threads, most read paths first.
+    [[nodiscard]] std::vector<KeyStats> getStats() const;
+
+    /// Paths of values in the instrumented configurations that are still alive which
+    /// were never read, in no particular order. Arrays count as values.
+    [[nodiscard]] std::vector<std::string> getUnusedKeys() const;
+
+    /// Writes the hottest paths, the paths that missed, and the unused keys.
+    void writeReport(std::ostream& stream, size_t hottest = 20) const;
+
+    // Called by instrumented sources.
+    void watch(const ConfigSourcePointer& root);
+
+    void record(uint64_t hash, std::string_view prefix, std::string_view key, bool hit,
+        std::chrono::nanoseconds time);
+
+private:
+    struct Counter final {
+        std::string path;
+        std::atomic<uint64_t> reads{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> nanoseconds{0};
+    };
+
+    // Only its thread writes the counters. The mutex guards the table, which that
+    // thread changes and readers of the log walk.
+    struct ThreadLog final {
+        std::thread::id thread;
+        std::mutex mutex;
+        std::unordered_map<uint64_t, Counter> counters;
+    };
+
+    [[nodiscard]] ThreadLog& getThreadLog();
+
+    [[nodiscard]] std::unordered_map<uint64_t, KeyStats> merge() const;
+
+    const uint64_t id_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadLog>> threads_;
+    std::vector<std::weak_ptr<ConfigSource>> roots_;
+};
+
+} // namespace confetti
+
+#endif // CONFETTI_CONFIG_ACCESS_LOG_HH
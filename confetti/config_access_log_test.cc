@@ -0,0 +1,110 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "config_access_log.hh"
+#include "config_tree.hh"
+#include "internal/snapshot.hh"
+#include <gmock/gmock.h>
+#include <sstream>
+#include <thread>
+
+static confetti::ConfigTree buildTree()
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("server");
+    builder.beginTable();
+    builder.setKey("host");
+    builder.addString("localhost");
+    builder.setKey("port");
+    builder.addInteger(8080);
+    builder.setKey("backlog");
+    builder.addInteger(128);
+    builder.endTable();
+    builder.setKey("workers");
+    builder.beginTable();
+    builder.addString("first");
+    builder.addString("second");
+    builder.endTable();
+    builder.setKey("debug");
+    builder.addBoolean(false);
+    builder.endTable();
+    return confetti::ConfigTree{builder.finish()->getRootSource()};
+}
+
+TEST(ConfigAccessLog, CountsReadsByPath)
+{
+    if (!CONFETTI_INSTRUMENTATION)
+        GTEST_SKIP() << "Built without instrumentation";
+
+    auto log = std::make_shared<confetti::ConfigAccessLog>();
+    const auto tree = buildTree().instrument(log);
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ(8080, tree["server"].get<int>("port"));
+    EXPECT_EQ("localhost", tree.get<std::string>(confetti::ConfigPath{"server.host"}));
+    EXPECT_FALSE(tree["server"].tryGet<int>("timeout"));
+    EXPECT_THAT(tree["workers"].toVector<std::string>(), testing::ElementsAre("first", "second"));
+
+    std::thread{[&tree] { EXPECT_EQ(8080, tree["server"].get<int>("port")); }}.join();
+
+    const auto stats = log->getStats();
+    ASSERT_FALSE(stats.empty());
+    EXPECT_EQ("server", stats[0].path);
+    EXPECT_EQ(6, stats[0].reads);
+    auto find = [&stats](std::string_view path) {
+        const auto it = std::find_if(stats.begin(), stats.end(),
+            [path](const auto& key) { return key.path == path; });
+        return it != stats.end() ? *it : confetti::ConfigAccessLog::KeyStats{};
+    };
+    EXPECT_EQ(4, find("server.port").reads);
+    EXPECT_EQ(0, find("server.port").misses);
+    EXPECT_EQ(1, find("server.host").reads);
+    EXPECT_EQ(1, find("server.timeout").misses);
+    EXPECT_EQ(1, find("workers").reads);
+    EXPECT_LT(0, find("workers[]").reads);
+
+    EXPECT_THAT(log->getUnusedKeys(), testing::ElementsAre("debug", "server.backlog"));
+
+    std::ostringstream report;
+    log->writeReport(report, 1);
+    EXPECT_THAT(report.str(), testing::HasSubstr("  server 6 "));
+    EXPECT_THAT(report.str(), testing::HasSubstr("  server.timeout 1\n"));
+    EXPECT_THAT(report.str(), testing::HasSubstr("Unused keys:\n  debug\n  server.backlog\n"));
+}
+
+TEST(ConfigAccessLog, ItemsAndFrozenTrees)
+{
+    if (!CONFETTI_INSTRUMENTATION)
+        GTEST_SKIP() << "Built without instrumentation";
+
+    auto log = std::make_shared<confetti::ConfigAccessLog>();
+    const auto tree = buildTree().instrument(log).freeze();
+    for (const auto& item : tree["server"].items()) {
+        if (item.getKey() != "backlog")
+            (void)item.tryGet<std::string>();
+    }
+    EXPECT_FALSE(tree.get<bool>("debug"));
+    EXPECT_THAT(log->getUnusedKeys(), testing::ElementsAre("server.backlog", "workers"));
+}
+
+TEST(ConfigAccessLog, Disabled)
+{
+    auto log = std::make_shared<confetti::ConfigAccessLog>();
+    const auto tree = buildTree().instrument(nullptr);
+    EXPECT_EQ(8080, tree["server"].get<int>("port"));
+    EXPECT_TRUE(log->getStats().empty());
+    EXPECT_TRUE(log->getUnusedKeys().empty());
+}
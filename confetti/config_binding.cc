@@ -0,0 +1,40 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "config_binding.hh"
+
+namespace confetti {
+
+static std::string formatErrors(const std::vector<std::string>& errors)
+{
+    std::string message{"Cannot bind configuration"};
+    const char* separator = ": ";
+    for (const auto& error : errors) {
+        message.append(separator).append(error);
+        separator = "; ";
+    }
+    return message;
+}
+
+ConfigBindingError::ConfigBindingError(std::vector<std::string> errors)
+    : std::runtime_error{formatErrors(errors)}
+    , errors_{std::move(errors)}
+{
+}
+
+ConfigBindingError::~ConfigBindingError() = default;
+
+} // namespace confetti
@@ -0,0 +1,375 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_CONFIG_BINDING_HH
+#define CONFETTI_CONFIG_BINDING_HH
+
+#include "config_tree.hh"
+#include "internal/hash.hh"
+#include "internal/type_traits.hh"
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace confetti {
+
+/// Describes how to load a struct from a config section. Specialize it with a
+/// `fields` tuple of field() descriptors:
+///
+///     template <>
+///     struct confetti::ConfigBinding<ServerConfig> {
+///         static constexpr auto fields = std::tuple{
+///             confetti::field("host", &ServerConfig::host),
+///             confetti::optionalField("port", &ServerConfig::port),
+///         };
+///     };
+template <typename T>
+struct ConfigBinding;
+
+template <typename S, typename T>
+class ConfigField final {
+public:
+    constexpr ConfigField(std::string_view name, T S::*member, bool required) noexcept
+        : key_{name}
+        , member_{member}
+        , required_{required}
+    {
+    }
+
+    [[nodiscard]] constexpr const ConfigKey& getKey() const noexcept { return key_; }
+
+    [[nodiscard]] constexpr T S::*getMember() const noexcept { return member_; }
+
+    [[nodiscard]] constexpr bool isRequired() const noexcept { return required_; }
+
+private:
+    ConfigKey key_;
+    T S::*member_;
+    bool required_;
+};
+
+/// Field that must be present, unless it is a std::optional.
+template <typename S, typename T>
+constexpr ConfigField<S, T> field(std::string_view name, T S::*member) noexcept
+{
+    return {name, member, !internal::is_optional_v<T>};
+}
+
+/// Field that keeps its default member value when absent.
+template <typename S, typename T>
+constexpr ConfigField<S, T> optionalField(std::string_view name, T S::*member) noexcept
+{
+    return {name, member, false};
+}
+
+/// Thrown by bind() with every missing or malformed field at once.
+class ConfigBindingError final : public std::runtime_error {
+public:
+    explicit ConfigBindingError(std::vector<std::string> errors);
+
+    ConfigBindingError(const ConfigBindingError&) = default;
+    ConfigBindingError& operator=(const ConfigBindingError&) = default;
+
+    ~ConfigBindingError() override;
+
+    [[nodiscard]] const std::vector<std::string>& getErrors() const noexcept { return errors_; }
+
+private:
+    std::vector<std::string> errors_;
+};
+
+namespace internal {
+
+template <typename T, typename = void>
+constexpr static auto has_config_binding_v = false;
+
+template <typename T>
+constexpr static auto has_config_binding_v<T, std::void_t<decltype(ConfigBinding<T>::fields)>> =
+    true;
+
+class BindingContext final {
+public:
+    [[nodiscard]] size_t enter(std::string_view name)
+    {
+        const auto size = path_.size();
+        if (size != 0)
+            path_ += '.';
+        path_ += name;
+        return size;
+    }
+
+    [[nodiscard]] size_t enter(int index)
+    {
+        const auto size = path_.size();
+        path_.append(1, '[').append(std::to_string(index)).append(1, ']');
+        return size;
+    }
+
+    void leave(size_t size) { path_.resize(size); }
+
+    void addError(std::string_view message)
+    {
+        errors_.emplace_back(std::string{"'"}.append(path_).append("': ").append(message));
+    }
+
+    [[nodiscard]] std::vector<std::string>& getErrors() noexcept { return errors_; }
+
+private:
+    std::string path_;
+    std::vector<std::string> errors_;
+};
+
+template <typename T>
+void bindObject(const ConfigTree& tree, T& object, BindingContext& context);
+
+// Returns whether the value is present, even if it fails to load.
+template <typename T, typename K>
+bool loadValue(const ConfigTree& tree, K key, T& value, BindingContext& context);
+
+template <typename T, typename K>
+bool bindValue(const ConfigTree& tree, K key, T& value, BindingContext& context)
+{
+    size_t scope;
+    if constexpr (std::is_same_v<K, int>)
+        scope = context.enter(key);
+    else
+        scope = context.enter(key.getName());
+
+    bool present = true;
+    try {
+        present = loadValue(tree, key, value, context);
+    } catch (const std::exception& e) {
+        context.addError(e.what());
+    }
+
+    context.leave(scope);
+    return present;
+}
+
+template <typename T>
+void loadSection(const ConfigTree& section, T& value, BindingContext& context)
+{
+    if constexpr (is_vector_v<T>) {
+        using Item = typename T::value_type;
+        const auto size = static_cast<int>(section.size());
+        T result;
+        result.reserve(static_cast<size_t>(size));
+        for (int index = 0; index < size; ++index) {
+            Item item{};
+            if (!bindValue(section, index, item, context) && !is_optional_v<Item>) {
+                const auto scope = context.enter(index);
+                context.addError("missing value");
+                context.leave(scope);
+            }
+            result.emplace_back(std::move(item));
+        }
+        value = std::move(result);
+    } else {
+        bindObject(section, value, context);
+    }
+}
+
+template <typename T, typename K>
+bool loadValue(const ConfigTree& tree, K key, T& value, BindingContext& context)
+{
+    if constexpr (is_optional_v<T>) {
+        typename T::value_type item{};
+        const auto errors = context.getErrors().size();
+        if (!loadValue(tree, key, item, context))
+            return false;
+        if (context.getErrors().size() == errors)
+            value = std::move(item);
+    } else if constexpr (is_vector_v<T> || has_config_binding_v<T>) {
+        auto child = tree.tryGetChild(key);
+        if (child)
+            loadSection(child, value, context);
+        else if (!tree.tryGetString(key))
+            return false;
+        else
+            context.addError("expected a section");
+    } else {
+        auto result = tree.tryGet<T>(key);
+        if (!result) {
+            if (!tree.tryGetChild(key))
+                return false;
+            context.addError("expected a value");
+            return true;
+        }
+        value = *std::move(result);
+    }
+    return true;
+}
+
+// Same as loadValue(), for the entry a section walk is at.
+template <typename T>
+bool loadItem(const ConfigTree::Item& item, T& value, BindingContext& context)
+{
+    if constexpr (is_optional_v<T>) {
+        typename T::value_type inner{};
+        const auto errors = context.getErrors().size();
+        if (!loadItem(item, inner, context))
+            return false;
+        if (context.getErrors().size() == errors)
+            value = std::move(inner);
+    } else if constexpr (is_vector_v<T> || has_config_binding_v<T>) {
+        auto child = item.getChild();
+        if (child)
+            loadSection(child, value, context);
+        else if (!item.tryGet<std::string>())
+            return false;
+        else
+            context.addError("expected a section");
+    } else {
+        auto result = item.tryGet<T>();
+        if (!result) {
+            if (!item.getChild())
+                return false;
+            context.addError("expected a value");
+            return true;
+        }
+        value = *std::move(result);
+    }
+    return true;
+}
+
+template <typename T>
+bool bindItem(const ConfigTree::Item& item, T& value, BindingContext& context)
+{
+    const auto scope = context.enter(item.getKey());
+    bool present = true;
+    try {
+        present = loadItem(item, value, context);
+    } catch (const std::exception& e) {
+        context.addError(e.what());
+    }
+    context.leave(scope);
+    return present;
+}
+
+template <typename T>
+constexpr size_t fieldCount
+    = std::tuple_size_v<std::remove_cvref_t<decltype(ConfigBinding<T>::fields)>>;
+
+// Calls the function with every field of the binding and its ordinal.
+template <typename T, typename F>
+void forEachField(const F& function)
+{
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (function(std::get<I>(ConfigBinding<T>::fields), I), ...);
+    }(std::make_index_sequence<fieldCount<T>>{});
+}
+
+struct FieldSlot final {
+    uint64_t hash;
+    std::string_view name;
+    size_t field;
+};
+
+// Fields sorted by the hash of their keys, built at compile time.
+template <typename T>
+constexpr auto fieldIndex = [] {
+    std::array<FieldSlot, fieldCount<T>> index{};
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        ((index[I] = FieldSlot{std::get<I>(ConfigBinding<T>::fields).getKey().getHash(),
+              std::get<I>(ConfigBinding<T>::fields).getKey().getName(), I}),
+            ...);
+    }(std::make_index_sequence<fieldCount<T>>{});
+    std::sort(index.begin(), index.end(),
+        [](const FieldSlot& lhs, const FieldSlot& rhs) { return lhs.hash < rhs.hash; });
+    return index;
+}();
+
+// Returns the ordinal of the field bound to the key, or fieldCount<T> if there is none.
+template <typename T>
+size_t findField(std::string_view key) noexcept
+{
+    const auto hash = internal::hash(key);
+    auto it = std::lower_bound(fieldIndex<T>.begin(), fieldIndex<T>.end(), hash,
+        [](const FieldSlot& slot, uint64_t value) noexcept { return slot.hash < value; });
+    for (; it != fieldIndex<T>.end() && it->hash == hash; ++it) {
+        if (it->name == key)
+            return it->field;
+    }
+    return fieldCount<T>;
+}
+
+// Walks the entries of the section once and loads each into the field bound to its key.
+// Errors are reported in the order of the fields, whatever the order of the entries.
+template <typename T>
+void bindObject(const ConfigTree& tree, T& object, BindingContext& context)
+{
+    static_assert(has_config_binding_v<T>, "Type has no ConfigBinding specialization");
+
+    auto& errors = context.getErrors();
+    std::array<bool, fieldCount<T>> present{};
+    std::array<std::vector<std::string>, fieldCount<T>> fieldErrors;
+    for (const auto& item : tree.items()) {
+        const auto found = findField<T>(item.getKey());
+        if (found == fieldCount<T>)
+            continue;
+        const auto mark = errors.size();
+        forEachField<T>([&](const auto& field, size_t index) {
+            if (index == found)
+                present[index] = bindItem(item, object.*field.getMember(), context);
+        });
+        std::move(errors.begin() + static_cast<std::ptrdiff_t>(mark), errors.end(),
+            std::back_inserter(fieldErrors[found]));
+        errors.erase(errors.begin() + static_cast<std::ptrdiff_t>(mark), errors.end());
+    }
+
+    forEachField<T>([&](const auto& field, size_t index) {
+        if (!present[index] && field.isRequired()) {
+            const auto scope = context.enter(field.getKey().getName());
+            context.addError("missing value");
+            context.leave(scope);
+        }
+        std::move(fieldErrors[index].begin(), fieldErrors[index].end(),
+            std::back_inserter(errors));
+    });
+}
+
+} // namespace internal
+
+/// Loads all bound fields of the object from the given section, leaving absent
+/// optional fields untouched. Throws ConfigBindingError listing every problem.
+template <typename T>
+void bind(const ConfigTree& tree, T& object)
+{
+    internal::BindingContext context;
+    internal::bindObject(tree, object, context);
+    if (!context.getErrors().empty())
+        throw ConfigBindingError{std::move(context.getErrors())};
+}
+
+template <typename T>
+[[nodiscard]] T bind(const ConfigTree& tree)
+{
+    T object{};
+    bind(tree, object);
+    return object;
+}
+
+} // namespace confetti
+
+#endif // CONFETTI_CONFIG_BINDING_HH
@@ -0,0 +1,225 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "config_binding.hh"
+#include "internal/snapshot.hh"
+#include <gmock/gmock.h>
+
+namespace {
+
+struct Endpoint final {
+    std::string host;
+    uint16_t port = 80;
+};
+
+struct ServerConfig final {
+    std::string name;
+    Endpoint listen;
+    std::vector<Endpoint> upstreams;
+    std::vector<std::string> tags;
+    std::optional<double> timeout;
+    std::optional<int64_t> retries;
+    bool verbose = true;
+};
+
+} // namespace
+
+template <>
+struct confetti::ConfigBinding<Endpoint> {
+    static constexpr auto fields = std::tuple{
+        confetti::field("host", &Endpoint::host),
+        confetti::optionalField("port", &Endpoint::port),
+    };
+};
+
+template <>
+struct confetti::ConfigBinding<ServerConfig> {
+    static constexpr auto fields = std::tuple{
+        confetti::field("name", &ServerConfig::name),
+        confetti::field("listen", &ServerConfig::listen),
+        confetti::field("upstreams", &ServerConfig::upstreams),
+        confetti::optionalField("tags", &ServerConfig::tags),
+        confetti::field("timeout", &ServerConfig::timeout),
+        confetti::field("retries", &ServerConfig::retries),
+        confetti::optionalField("verbose", &ServerConfig::verbose),
+    };
+};
+
+static void addEndpoint(
+    confetti::internal::SnapshotBuilder& builder, const char* host, std::optional<int64_t> port)
+{
+    builder.beginTable();
+    builder.setKey("host");
+    builder.addString(host);
+    if (port) {
+        builder.setKey("port");
+        builder.addInteger(*port);
+    }
+    builder.endTable();
+}
+
+static confetti::ConfigTree buildServerConfig()
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("name");
+    builder.addString("frontend");
+    builder.setKey("listen");
+    addEndpoint(builder, "0.0.0.0", 8080);
+    builder.setKey("upstreams");
+    builder.beginTable();
+    addEndpoint(builder, "10.0.0.1", 9000);
+    addEndpoint(builder, "10.0.0.2", std::nullopt);
+    builder.endTable();
+    builder.setKey("tags");
+    builder.beginTable();
+    builder.addString("public");
+    builder.addString("http");
+    builder.endTable();
+    builder.setKey("timeout");
+    builder.addDouble(2.5);
+    builder.endTable();
+    return confetti::ConfigTree{builder.finish()->getRootSource()};
+}
+
+TEST(ConfigBinding, Struct)
+{
+    const auto config = confetti::bind<ServerConfig>(buildServerConfig());
+    EXPECT_EQ("frontend", config.name);
+    EXPECT_EQ("0.0.0.0", config.listen.host);
+    EXPECT_EQ(8080, config.listen.port);
+    ASSERT_EQ(2, config.upstreams.size());
+    EXPECT_EQ("10.0.0.1", config.upstreams[0].host);
+    EXPECT_EQ(9000, config.upstreams[0].port);
+    EXPECT_EQ("10.0.0.2", config.upstreams[1].host);
+    EXPECT_EQ(80, config.upstreams[1].port);
+    EXPECT_THAT(config.tags, testing::ElementsAre("public", "http"));
+    EXPECT_DOUBLE_EQ(2.5, config.timeout.value());
+    EXPECT_FALSE(config.retries);
+    EXPECT_TRUE(config.verbose);
+}
+
+TEST(ConfigBinding, AbsentOptionalKeepsDefault)
+{
+    ServerConfig config;
+    config.retries = 3;
+    config.timeout = 1.0;
+    confetti::bind(buildServerConfig(), config);
+    EXPECT_EQ(3, config.retries.value());
+    EXPECT_DOUBLE_EQ(2.5, config.timeout.value());
+}
+
+TEST(ConfigBinding, ReportsAllErrors)
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("listen");
+    builder.addString("0.0.0.0:8080");
+    builder.setKey("upstreams");
+    builder.beginTable();
+    addEndpoint(builder, "10.0.0.1", 9000);
+    builder.beginTable();
+    builder.setKey("port");
+    builder.addString("http");
+    builder.endTable();
+    builder.endTable();
+    builder.setKey("timeout");
+    builder.addString("never");
+    builder.endTable();
+    confetti::ConfigTree tree{builder.finish()->getRootSource()};
+
+    try {
+        (void)confetti::bind<ServerConfig>(tree);
+        FAIL() << "Expected ConfigBindingError";
+    } catch (const confetti::ConfigBindingError& e) {
+        EXPECT_THAT(e.getErrors(),
+            testing::ElementsAre("'name': missing value", "'listen': expected a section",
+                "'upstreams[1].host': missing value",
+                testing::StartsWith("'upstreams[1].port': "),
+                testing::StartsWith("'timeout': ")));
+        EXPECT_THAT(e.what(),
+            testing::StartsWith(
+                "Cannot bind configuration: 'name': missing value; 'listen': expected a section"));
+    }
+}
+
+TEST(ConfigBinding, ReportsMistypedValues)
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("name");
+    builder.beginTable();
+    builder.endTable();
+    builder.setKey("listen");
+    addEndpoint(builder, "0.0.0.0", 8080);
+    builder.setKey("upstreams");
+    builder.beginTable();
+    builder.endTable();
+    builder.setKey("tags");
+    builder.beginTable();
+    builder.addString("public");
+    builder.beginTable();
+    builder.endTable();
+    builder.addString("http");
+    builder.endTable();
+    builder.setKey("retries");
+    builder.beginTable();
+    builder.endTable();
+    builder.endTable();
+    confetti::ConfigTree tree{builder.finish()->getRootSource()};
+
+    ServerConfig config;
+    config.retries = 3;
+    try {
+        confetti::bind(tree, config);
+        FAIL() << "Expected ConfigBindingError";
+    } catch (const confetti::ConfigBindingError& e) {
+        EXPECT_THAT(e.getErrors(),
+            testing::ElementsAre("'name': expected a value", "'tags[1]': expected a value",
+                "'retries': expected a value"));
+    }
+    EXPECT_THAT(config.tags, testing::ElementsAre("public", "", "http"));
+    EXPECT_EQ(3, config.retries.value());
+}
+
+TEST(ConfigBinding, IgnoresOtherKeys)
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("hostname");
+    builder.addString("ignored");
+    builder.setKey("host");
+    builder.addString("localhost");
+    builder.setKey("extra");
+    builder.beginTable();
+    builder.endTable();
+    builder.endTable();
+    const auto endpoint
+        = confetti::bind<Endpoint>(confetti::ConfigTree{builder.finish()->getRootSource()});
+    EXPECT_EQ("localhost", endpoint.host);
+    EXPECT_EQ(80, endpoint.port);
+}
+
+TEST(ConfigBinding, EmptyTree)
+{
+    EXPECT_THROW((void)confetti::bind<ServerConfig>(confetti::ConfigTree{}),
+        confetti::ConfigBindingError);
+
+    Endpoint endpoint{"localhost", 443};
+    EXPECT_THROW(confetti::bind(confetti::ConfigTree{}, endpoint), confetti::ConfigBindingError);
+    EXPECT_EQ("localhost", endpoint.host);
+    EXPECT_EQ(443, endpoint.port);
+}
@@ -0,0 +1,58 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_CONFIG_KEY_HH
+#define CONFETTI_CONFIG_KEY_HH
+
+#include "internal/hash.hh"
+#include <cstdint>
+#include <string_view>
+
+namespace confetti {
+
+/// Key name together with its hash, computed at compile time where possible.
+/// Does not own the name.
+class ConfigKey final {
+public:
+    constexpr ConfigKey() noexcept
+        : ConfigKey{std::string_view{}}
+    {
+    }
+
+    constexpr explicit ConfigKey(std::string_view name) noexcept
+        : name_{name}
+        , hash_{internal::hash(name)}
+    {
+    }
+
+    constexpr ConfigKey(std::string_view name, uint64_t hash) noexcept
+        : name_{name}
+        , hash_{hash}
+    {
+    }
+
+    [[nodiscard]] constexpr std::string_view getName() const noexcept { return name_; }
+
+    [[nodiscard]] constexpr uint64_t getHash() const noexcept { return hash_; }
+
+private:
+    std::string_view name_;
+    uint64_t hash_;
+};
+
+} // namespace confetti
+
+#endif // CONFETTI_CONFIG_KEY_HH
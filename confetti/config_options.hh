@@ -0,0 +1,62 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_CONFIG_OPTIONS_HH
+#define CONFETTI_CONFIG_OPTIONS_HH
+
+namespace confetti {
+
+/// Where the Lua state of a configuration gets its memory from.
+enum class LuaAllocator {
+    /// Every allocation goes to realloc() and free().
+    System,
+
+    /// Bump allocation from large chunks. Freed memory is not reused, but all of
+    /// it goes back at once when the state is gone. Best for configs that are
+    /// frozen right after loading.
+    Arena,
+
+    /// Free lists per size class, carved from large chunks. Freed memory is
+    /// reused, and all of it goes back at once when the state is gone. Best for
+    /// long-lived Lua configs.
+    SizeClass,
+};
+
+/// When a Lua config calls values that are functions.
+enum class LuaFunctions {
+    /// On every read, so each read may see a different value.
+    EveryTime,
+
+    /// On the first read. The result is kept and returned by later reads, unless it is nil.
+    Once,
+
+    /// All of them right after loading, keeping the results as with Once.
+    Eager,
+};
+
+/// Options for loading a configuration. Settings that do not apply to the
+/// backend of a file are ignored.
+struct ConfigLoadOptions final {
+    LuaAllocator luaAllocator{LuaAllocator::System};
+    LuaFunctions luaFunctions{LuaFunctions::EveryTime};
+
+    /// Threads ConfigTree::loadFiles() loads files on, 0 for one per core.
+    unsigned loadThreads{0};
+};
+
+} // namespace confetti
+
+#endif // CONFETTI_CONFIG_OPTIONS_HH
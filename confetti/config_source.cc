@@ -15,18 +15,119 @@
 //
 
 #include "config_source.hh"
-#include <cmath>
+#include "internal/convert.hh"
+#include "internal/key_index.hh"
+#include "internal/snapshot.hh"
+#include "internal/text_cache.hh"
 
 namespace confetti {
 
-ConfigSource::~ConfigSource() = default;
+ConfigItemCursor::~ConfigItemCursor() = default;
+
+bool ConfigItemCursor::isTable() const { return getChild() != nullptr; }
+
+ConfigSource::~ConfigSource()
+{
+    delete textCache_.load(std::memory_order_relaxed);
+    delete keyIndex_.load(std::memory_order_relaxed);
+}
+
+static void freezeSource(const ConfigSource& source, internal::SnapshotBuilder& builder)
+{
+    builder.beginTable();
+    for (int index = 0;; ++index) {
+        if (auto child = source.tryGetChild(index)) {
+            freezeSource(*child, builder);
+        } else if (auto value = source.tryGetString(index)) {
+            builder.addString(*value);
+        } else {
+            break;
+        }
+    }
+    for (const auto& key : source.getKeyList()) {
+        if (auto child = source.tryGetChild(key)) {
+            builder.setKey(key);
+            freezeSource(*child, builder);
+        } else if (auto value = source.tryGetString(key)) {
+            builder.setKey(key);
+            builder.addString(*value);
+        }
+    }
+    builder.endTable();
+}
+
+ConfigSourcePointer ConfigSource::freeze() const
+{
+    internal::SnapshotBuilder builder;
+    freezeSource(*this, builder);
+    return builder.finish()->getRootSource();
+}
+
+bool ConfigSource::isThreadSafe() const noexcept { return false; }
+
+ConfigSourcePointer ConfigSource::tryGetChild(const ConfigKey& key) const
+{
+    return tryGetChild(key.getName());
+}
+
+ConfigSource* ConfigSource::tryGetChildView(const ConfigKey& key, ConfigSourcePointer& owner) const
+{
+    owner = tryGetChild(key);
+    return owner.get();
+}
+
+std::optional<bool> ConfigSource::tryGetBoolean(const ConfigKey& key) const
+{
+    return tryGetBoolean(key.getName());
+}
+
+std::optional<double> ConfigSource::tryGetDouble(const ConfigKey& key) const
+{
+    return tryGetDouble(key.getName());
+}
+
+std::optional<std::string> ConfigSource::tryGetString(const ConfigKey& key) const
+{
+    return tryGetString(key.getName());
+}
+
+template <typename T>
+std::optional<std::string_view> ConfigSource::tryGetStringViewT(T key) const
+{
+    std::optional<std::string_view> result;
+    if (auto value = tryGetString(key)) {
+        auto cache = textCache_.load(std::memory_order_acquire);
+        if (cache == nullptr) {
+            auto created = std::make_unique<internal::TextCache>();
+            if (textCache_.compare_exchange_strong(cache, created.get(), std::memory_order_acq_rel))
+                cache = created.release();
+        }
+        result.emplace(cache->intern(*value));
+    }
+    return result;
+}
+
+std::optional<std::string_view> ConfigSource::tryGetStringView(int index) const
+{
+    return tryGetStringViewT(index);
+}
+
+std::optional<std::string_view> ConfigSource::tryGetStringView(std::string_view name) const
+{
+    return tryGetStringViewT(name);
+}
+
+std::optional<std::string_view> ConfigSource::tryGetStringView(const ConfigKey& key) const
+{
+    return tryGetStringView(key.getName());
+}
 
 template <typename T>
 std::optional<int64_t> ConfigSource::tryGetNumberT(T key) const
 {
     std::optional<int64_t> result;
     if (auto number = tryGetDouble(key)) {
-        result.emplace(std::llround(*number));
+        result.emplace(internal::roundToInteger(*number));
     }
     return result;
 }
@@ -38,12 +139,17 @@ std::optional<int64_t> ConfigSource::tryGetNumber(std::string_view name) const
     return tryGetNumberT(name);
 }
 
+std::optional<int64_t> ConfigSource::tryGetNumber(const ConfigKey& key) const
+{
+    return tryGetNumberT(key);
+}
+
 template <typename T>
 std::optional<uint64_t> ConfigSource::tryGetUnsignedNumberT(T key) const
 {
     std::optional<uint64_t> result;
     if (auto number = tryGetDouble(key)) {
-        result.emplace(static_cast<uint64_t>(std::llround(*number)));
+        result.emplace(internal::roundToUnsignedInteger(*number));
     }
     return result;
 }
@@ -58,4 +164,127 @@ std::optional<uint64_t> ConfigSource::tryGetUnsignedNumber(std::string_view name
     return tryGetUnsignedNumberT(name);
 }
 
+std::optional<uint64_t> ConfigSource::tryGetUnsignedNumber(const ConfigKey& key) const
+{
+    return tryGetUnsignedNumberT(key);
+}
+
+size_t ConfigSource::getArraySize() const
+{
+    int size = 0;
+    while (hasValueAt(size) || tryGetChild(size))
+        ++size;
+    return static_cast<size_t>(size);
+}
+
+template <typename T, typename R>
+size_t ConfigSource::copyValuesT(std::span<T> values, R (ConfigSource::*getter)(int) const) const
+{
+    for (size_t i = 0; i < values.size(); ++i) {
+        auto value = (this->*getter)(static_cast<int>(i));
+        if (!value.has_value())
+            return i;
+        values[i] = *std::move(value);
+    }
+    return values.size();
+}
+
+size_t ConfigSource::copyValues(std::span<bool> values) const
+{
+    return copyValuesT(values, &ConfigSource::tryGetBoolean);
+}
+
+size_t ConfigSource::copyValues(std::span<double> values) const
+{
+    return copyValuesT(values, &ConfigSource::tryGetDouble);
+}
+
+size_t ConfigSource::copyValues(std::span<int64_t> values) const
+{
+    return copyValuesT(values, &ConfigSource::tryGetNumber);
+}
+
+size_t ConfigSource::copyValues(std::span<uint64_t> values) const
+{
+    return copyValuesT(values, &ConfigSource::tryGetUnsignedNumber);
+}
+
+size_t ConfigSource::copyValues(std::span<std::string> values) const
+{
+    return copyValuesT(values, &ConfigSource::tryGetString);
+}
+
+size_t ConfigSource::copyValues(std::span<std::string_view> values) const
+{
+    return copyValuesT(values, &ConfigSource::tryGetStringView);
+}
+
+const internal::KeyIndex& ConfigSource::getKeyIndex() const
+{
+    auto index = keyIndex_.load(std::memory_order_acquire);
+    if (index == nullptr) {
+        auto created = std::make_unique<internal::KeyIndex>(*this);
+        if (keyIndex_.compare_exchange_strong(index, created.get(), std::memory_order_acq_rel))
+            index = created.release();
+    }
+    return *index;
+}
+
+namespace {
+
+class KeyListCursor final : public ConfigItemCursor {
+public:
+    explicit KeyListCursor(const ConfigSource& source)
+        : source_{source}
+        , keys_{source.getKeyList()}
+        , next_{0}
+    {
+    }
+
+    bool next() override
+    {
+        if (next_ == keys_.size())
+            return false;
+        ++next_;
+        return true;
+    }
+
+    std::string_view getKey() const override { return keys_[next_ - 1]; }
+
+    ConfigSourcePointer getChild() const override { return source_.tryGetChild(getKey()); }
+
+    std::optional<bool> getBoolean() const override { return source_.tryGetBoolean(getKey()); }
+
+    std::optional<double> getDouble() const override { return source_.tryGetDouble(getKey()); }
+
+    std::optional<int64_t> getNumber() const override { return source_.tryGetNumber(getKey()); }
+
+    std::optional<uint64_t> getUnsignedNumber() const override
+    {
+        return source_.tryGetUnsignedNumber(getKey());
+    }
+
+    std::optional<std::string> getString() const override
+    {
+        return source_.tryGetString(getKey());
+    }
+
+    std::optional<std::string_view> getStringView() const override
+    {
+        return source_.tryGetStringView(getKey());
+    }
+
+private:
+    const ConfigSource& source_;
+    const std::vector<std::string> keys_;
+    size_t next_;
+};
+
+} // namespace
+
+std::unique_ptr<ConfigItemCursor> ConfigSource::getItems() const
+{
+    return std::make_unique<KeyListCursor>(*this);
+}
+
 } // namespace confetti
@@ -17,18 +17,64 @@
 #ifndef CONFETTI_CONFIG_SOURCE_HH
 #define CONFETTI_CONFIG_SOURCE_HH
 
+#include "config_key.hh"
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace confetti {
 
+namespace internal {
+class KeyIndex;
+class TextCache;
+} // namespace internal
+
 class ConfigSource;
 
 using ConfigSourcePointer = std::shared_ptr<ConfigSource>;
 
+/// Walks the named entries of a source once, see ConfigSource::getItems(). The key and
+/// the values read refer to the current entry only. The source must outlive the cursor.
+class ConfigItemCursor {
+public:
+    ConfigItemCursor() noexcept = default;
+
+    virtual ~ConfigItemCursor();
+
+    ConfigItemCursor(const ConfigItemCursor&) = delete;
+    ConfigItemCursor& operator=(const ConfigItemCursor&) = delete;
+
+    /// Moves to the next entry, or to the first one on the first call. Returns false
+    /// when there are no more entries.
+    [[nodiscard]] virtual bool next() = 0;
+
+    /// The view stays valid until the cursor moves on.
+    [[nodiscard]] virtual std::string_view getKey() const = 0;
+
+    [[nodiscard]] virtual ConfigSourcePointer getChild() const = 0;
+
+    /// Whether the entry is a table. Unlike getChild(), never evaluates values
+    /// computed by code, so that walking a tree has no side effects.
+    [[nodiscard]] virtual bool isTable() const;
+
+    [[nodiscard]] virtual std::optional<bool> getBoolean() const = 0;
+
+    [[nodiscard]] virtual std::optional<double> getDouble() const = 0;
+
+    [[nodiscard]] virtual std::optional<int64_t> getNumber() const = 0;
+
+    [[nodiscard]] virtual std::optional<uint64_t> getUnsignedNumber() const = 0;
+
+    [[nodiscard]] virtual std::optional<std::string> getString() const = 0;
+
+    [[nodiscard]] virtual std::optional<std::string_view> getStringView() const = 0;
+};
+
 class ConfigSource {
 public:
     ConfigSource() noexcept = default;
@@ -44,34 +90,114 @@ public:
 
     [[nodiscard]] virtual ConfigSourcePointer tryGetChild(std::string_view name) const = 0;
 
+    [[nodiscard]] virtual ConfigSourcePointer tryGetChild(const ConfigKey& key) const;
+
+    /// Steps to a child along a path without handing out a handle to it. Returns the
+    /// child or nullptr, and keeps it alive through `owner`, which must also keep this
+    /// source alive. The default implementation stores tryGetChild() in `owner`.
+    /// Backends whose children live as long as the source return them as they are and
+    /// leave `owner` alone, so path lookups touch no shared reference counts.
+    [[nodiscard]] virtual ConfigSource* tryGetChildView(
+        const ConfigKey& key, ConfigSourcePointer& owner) const;
+
     [[nodiscard]] virtual std::optional<bool> tryGetBoolean(int index) const = 0;
 
     [[nodiscard]] virtual std::optional<bool> tryGetBoolean(std::string_view name) const = 0;
 
+    [[nodiscard]] virtual std::optional<bool> tryGetBoolean(const ConfigKey& key) const;
+
     [[nodiscard]] virtual std::optional<double> tryGetDouble(int index) const = 0;
 
     [[nodiscard]] virtual std::optional<double> tryGetDouble(std::string_view name) const = 0;
 
+    [[nodiscard]] virtual std::optional<double> tryGetDouble(const ConfigKey& key) const;
+
     [[nodiscard]] virtual std::optional<int64_t> tryGetNumber(int index) const;
 
     [[nodiscard]] virtual std::optional<int64_t> tryGetNumber(std::string_view name) const;
 
+    [[nodiscard]] virtual std::optional<int64_t> tryGetNumber(const ConfigKey& key) const;
+
     [[nodiscard]] virtual std::optional<uint64_t> tryGetUnsignedNumber(int index) const;
 
     [[nodiscard]] virtual std::optional<uint64_t> tryGetUnsignedNumber(std::string_view name) const;
 
+    [[nodiscard]] virtual std::optional<uint64_t> tryGetUnsignedNumber(const ConfigKey& key) const;
+
     [[nodiscard]] virtual std::optional<std::string> tryGetString(int index) const = 0;
 
     [[nodiscard]] virtual std::optional<std::string> tryGetString(std::string_view name) const = 0;
 
+    [[nodiscard]] virtual std::optional<std::string> tryGetString(const ConfigKey& key) const;
+
+    /// Returns a view of the value as a string, without copying it where the backend
+    /// stores it as one. The default implementation keeps the result of tryGetString()
+    /// in this source, so the view stays valid for as long as the source. It allocates
+    /// and locks once per distinct value, and is slower than tryGetString(), so backends
+    /// that store strings override it.
+    [[nodiscard]] virtual std::optional<std::string_view> tryGetStringView(int index) const;
+
+    [[nodiscard]] virtual std::optional<std::string_view> tryGetStringView(
+        std::string_view name) const;
+
+    [[nodiscard]] virtual std::optional<std::string_view> tryGetStringView(
+        const ConfigKey& key) const;
+
+    /// Keys of the named entries. Elements of the array part are not named entries, and
+    /// other numeric keys are named by their string form.
     [[nodiscard]] virtual std::vector<std::string> getKeyList() const = 0;
 
+    /// Returns a cursor over named entries, values and children alike, in no particular
+    /// order. It visits the same keys as getKeyList(). The default implementation walks getKeyList() and looks up every entry by
+    /// name, backends override it to traverse their storage directly.
+    [[nodiscard]] virtual std::unique_ptr<ConfigItemCursor> getItems() const;
+
+    /// Number of elements in the array part, values and children alike.
+    [[nodiscard]] virtual size_t getArraySize() const;
+
+    /// Copies leading elements of the array part in one pass. Returns how many were
+    /// copied, which is less than requested at the first element that is missing or
+    /// not a value.
+    [[nodiscard]] virtual size_t copyValues(std::span<bool> values) const;
+
+    [[nodiscard]] virtual size_t copyValues(std::span<double> values) const;
+
+    [[nodiscard]] virtual size_t copyValues(std::span<int64_t> values) const;
+
+    [[nodiscard]] virtual size_t copyValues(std::span<uint64_t> values) const;
+
+    [[nodiscard]] virtual size_t copyValues(std::span<std::string> values) const;
+
+    [[nodiscard]] virtual size_t copyValues(std::span<std::string_view> values) const;
+
+    /// Returns an immutable native copy of this subtree that does not depend on
+    /// the original backend, or nullptr if this source is immutable already.
+    [[nodiscard]] virtual ConfigSourcePointer freeze() const;
+
+    /// Whether any number of threads may read this source and its children at once.
+    [[nodiscard]] virtual bool isThreadSafe() const noexcept;
+
+    /// Fuzzy index over the paths of this subtree, built on first use and kept for as
+    /// long as the source. Used to suggest keys when lookups miss. Backends that make
+    /// new handles to a table on every lookup keep it with the table instead.
+    [[nodiscard]] virtual const internal::KeyIndex& getKeyIndex() const;
+
 private:
     template <typename T>
     [[nodiscard]] std::optional<int64_t> tryGetNumberT(T key) const;
 
     template <typename T>
     [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumberT(T key) const;
+
+    template <typename T>
+    [[nodiscard]] std::optional<std::string_view> tryGetStringViewT(T key) const;
+
+    template <typename T, typename R>
+    [[nodiscard]] size_t copyValuesT(
+        std::span<T> values, R (ConfigSource::*getter)(int) const) const;
+
+    mutable std::atomic<internal::TextCache*> textCache_{nullptr};
+    mutable std::atomic<internal::KeyIndex*> keyIndex_{nullptr};
 };
 
 } // namespace confetti
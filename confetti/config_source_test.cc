@@ -34,6 +34,11 @@ public:
 
     ~Source() override = default;
 
+    using ConfigSource::tryGetBoolean;
+    using ConfigSource::tryGetChild;
+    using ConfigSource::tryGetDouble;
+    using ConfigSource::tryGetString;
+
     [[nodiscard]] bool hasValueAt(int) const override { return false; }
 
     [[nodiscard]] confetti::ConfigSourcePointer tryGetChild(int) const override { return {}; }
@@ -67,6 +72,51 @@ public:
     [[nodiscard]] std::vector<std::string> getKeyList() const override { return {}; }
 };
 
+// Makes up a new string on every call, like backends that convert values.
+class TextSource final : public confetti::ConfigSource {
+public:
+    using ConfigSource::tryGetBoolean;
+    using ConfigSource::tryGetChild;
+    using ConfigSource::tryGetDouble;
+    using ConfigSource::tryGetString;
+
+    [[nodiscard]] bool hasValueAt(int index) const override { return index == 0; }
+
+    [[nodiscard]] confetti::ConfigSourcePointer tryGetChild(int) const override { return {}; }
+
+    [[nodiscard]] confetti::ConfigSourcePointer tryGetChild(std::string_view) const override
+    {
+        return {};
+    }
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(int) const override { return {}; }
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(std::string_view) const override { return {}; }
+
+    [[nodiscard]] std::optional<double> tryGetDouble(int) const override { return {}; }
+
+    [[nodiscard]] std::optional<double> tryGetDouble(std::string_view) const override { return {}; }
+
+    [[nodiscard]] std::optional<std::string> tryGetString(int index) const override
+    {
+        if (index != 0)
+            return {};
+        return "zero";
+    }
+
+    [[nodiscard]] std::optional<std::string> tryGetString(std::string_view name) const override
+    {
+        if (name.empty())
+            return {};
+        return std::string{name} + " value";
+    }
+
+    [[nodiscard]] std::vector<std::string> getKeyList() const override
+    {
+        return {"first", "second"};
+    }
+};
+
 }; // namespace
 
 TEST(ConfigSource, IntFromDouble)
@@ -89,3 +139,57 @@ TEST(ConfigSource, IntFromDouble)
     EXPECT_EQ(20, source.tryGetNumber("").value());
     EXPECT_EQ(20, source.tryGetUnsignedNumber("").value());
 }
+
+TEST(ConfigSource, KeyFallsBackToName)
+{
+    Source source;
+    const confetti::ConfigKey key{"key"};
+    EXPECT_FALSE(source.tryGetChild(key));
+    EXPECT_FALSE(source.tryGetBoolean(key).has_value());
+    EXPECT_DOUBLE_EQ(19.86, source.tryGetDouble(key).value());
+    EXPECT_FALSE(source.tryGetString(key).has_value());
+    EXPECT_EQ(20, source.tryGetNumber(key).value());
+    EXPECT_EQ(20, source.tryGetUnsignedNumber(key).value());
+}
+
+TEST(ConfigSource, StringViewKeepsConvertedValues)
+{
+    TextSource source;
+    const auto first = source.tryGetStringView("name").value();
+    EXPECT_EQ("name value", first);
+    const auto second = source.tryGetStringView(confetti::ConfigKey{"name"}).value();
+    EXPECT_EQ(first.data(), second.data());
+    EXPECT_EQ("zero", source.tryGetStringView(0).value());
+    EXPECT_EQ("other value", source.tryGetStringView("other").value());
+    EXPECT_EQ("name value", first);
+    EXPECT_FALSE(source.tryGetStringView(1).has_value());
+    EXPECT_FALSE(source.tryGetStringView("").has_value());
+}
+
+TEST(ConfigSource, BulkValuesFallBackToGetters)
+{
+    TextSource source;
+    EXPECT_EQ(1, source.getArraySize());
+    std::string strings[2];
+    EXPECT_EQ(1, source.copyValues(std::span<std::string>{strings}));
+    EXPECT_EQ("zero", strings[0]);
+    double doubles[2];
+    EXPECT_EQ(0, source.copyValues(std::span<double>{doubles}));
+    EXPECT_EQ(0, Source{}.getArraySize());
+}
+
+TEST(ConfigSource, ItemsFallBackToKeyList)
+{
+    TextSource source;
+    auto cursor = source.getItems();
+    ASSERT_TRUE(cursor->next());
+    EXPECT_EQ("first", cursor->getKey());
+    EXPECT_EQ("first value", cursor->getStringView().value());
+    EXPECT_FALSE(cursor->getChild());
+    EXPECT_FALSE(cursor->getDouble().has_value());
+    ASSERT_TRUE(cursor->next());
+    EXPECT_EQ("second", cursor->getKey());
+    EXPECT_EQ("second value", cursor->getString().value());
+    EXPECT_FALSE(cursor->next());
+    EXPECT_FALSE(Source{}.getItems()->next());
+}
@@ -15,11 +15,22 @@
 //
 
 #include "config_tree.hh"
-#include "internal/levenshtein.hh"
+#include "internal/instrumented_source.hh"
+#include "internal/ini.hh"
+#include "internal/json.hh"
+#include "internal/key_index.hh"
 #include "internal/lua.hh"
+#include "internal/overrides.hh"
+#include "internal/snapshot.hh"
 #include "internal/string.hh"
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+
+extern char** environ;
 
 namespace confetti {
 
@@ -53,6 +64,94 @@ ConfigTree ConfigPath::getChildNode(ConfigTree tree) const
         [](auto node, auto key) noexcept { return std::move(node).tryGetChild(key); });
 }
 
+CompiledConfigPath::CompiledConfigPath(const ConfigPath& path)
+    : CompiledConfigPath{path.getPathString(), path.getSeparators()}
+{
+}
+
+CompiledConfigPath::CompiledConfigPath(std::string_view path, std::string_view separators)
+    : path_{std::make_shared<const std::string>(path)}
+{
+    const std::string_view str{*path_};
+    std::string_view::size_type begin = 0;
+    for (;;) {
+        const auto end = str.find_first_of(separators, begin);
+        keys_.emplace_back(str.substr(begin, end - begin));
+        if (end == std::string_view::npos)
+            break;
+        begin = end + 1;
+    }
+}
+
+std::tuple<ConfigTree, ConfigKey> CompiledConfigPath::getValueNode(ConfigTree tree) const
+{
+    return tree.findValueNode(keys_);
+}
+
+ConfigTree CompiledConfigPath::getChildNode(ConfigTree tree) const
+{
+    return tree.findChildNode(keys_);
+}
+
+BoundConfigPath CompiledConfigPath::bind(const ConfigTree& tree) const
+{
+    return BoundConfigPath{std::get<ConfigTree>(getValueNode(tree)), keys_.back()};
+}
+
+ConfigTree ConfigTree::findValueView(
+    std::span<const ConfigKey> path, ConfigSourcePointer& owner) const
+{
+    auto node = source_.get();
+    for (const auto& key : path.first(path.size() - 1)) {
+        if (node == nullptr)
+            break;
+        node = node->tryGetChildView(key, owner);
+    }
+    // Aliases no control block, so copies of it are plain pointer copies.
+    return ConfigTree{ConfigSourcePointer{std::shared_ptr<void>{}, node}};
+}
+
+std::tuple<ConfigTree, ConfigKey> ConfigTree::findValueNode(std::span<const ConfigKey> path) const
+{
+    ConfigSourcePointer owner;
+    const auto view = findValueView(path, owner);
+    const auto node = view.source_.get();
+    ConfigSourcePointer result;
+    if (node == owner.get())
+        result = std::move(owner);
+    else if (node != nullptr)
+        result = ConfigSourcePointer{owner ? std::move(owner) : source_, node};
+    return {ConfigTree{std::move(result)}, path.back()};
+}
+
+ConfigTree ConfigTree::findChildNode(std::span<const ConfigKey> path) const
+{
+    auto [tree, key] = findValueNode(path);
+    return tree.tryGetChild(key);
+}
+
+void ConfigTree::outOfRange(int index, std::string_view value)
+{
+    throw std::range_error{std::string{"Config value at index "}
+                               .append(std::to_string(index))
+                               .append(" is out of range: ")
+                               .append(value)};
+}
+
+void ConfigTree::outOfRange(std::string_view name, std::string_view value)
+{
+    throw std::range_error{std::string{"Config value '"}
+                               .append(name)
+                               .append("' is out of range: ")
+                               .append(value)};
+}
+
+void ConfigTree::notAValue(std::string_view name)
+{
+    throw std::runtime_error{
+        std::string{"Config entry '"}.append(name).append("' is not a value of this type")};
+}
+
 void ConfigTree::noSuchChild(int index)
 {
     throw std::runtime_error{
@@ -76,68 +175,177 @@ void ConfigTree::noSuchKey(std::string_view name) const
     stream << "Cannot find configuration entry '" << name << "'.";
 
     if (source_) {
-        auto lastDistance = std::numeric_limits<size_t>::max();
-        const auto keys = source_->getKeyList();
-        const std::string* suggestedKey = nullptr;
-        for (const auto& key : keys) {
-            const auto dist = internal::distance(name, key);
-            if (dist < lastDistance) {
-                suggestedKey = &key;
-                lastDistance = dist;
-            }
-        }
-        if (suggestedKey != nullptr)
-        {
-            stream << " Did you mean '" << *suggestedKey << "'?";
-        }
+        if (auto suggestion = source_->getKeyIndex().suggest(name); !suggestion.empty())
+            stream << " Did you mean '" << suggestion << "'?";
     }
 
     throw std::runtime_error{std::move(stream).str()};
 }
 
-ConfigTree ConfigTree::loadLuaCode(std::string_view code)
+ConfigTree ConfigTree::freeze() const
+{
+    if (!source_)
+        return {};
+    auto frozen = source_->freeze();
+    return frozen ? ConfigTree{std::move(frozen)} : *this;
+}
+
+ConfigTree ConfigTree::instrument([[maybe_unused]] std::shared_ptr<ConfigAccessLog> log) const
 {
-    return ConfigTree{internal::LuaSource::loadCode(code)};
+#if CONFETTI_INSTRUMENTATION
+    if (source_ && log) {
+        log->watch(source_);
+        return ConfigTree{
+            std::make_shared<internal::InstrumentedSource>(source_, std::move(log), std::string{})};
+    }
+#endif
+    return *this;
 }
 
-ConfigTree ConfigTree::loadLuaFile(const std::filesystem::path& file)
+ConfigTree ConfigTree::loadLuaCode(std::string_view code, const ConfigLoadOptions& options)
 {
-    return ConfigTree{internal::LuaSource::loadFile(file)};
+    return ConfigTree{internal::LuaSource::loadCode(code, options)};
+}
+
+ConfigTree ConfigTree::loadLuaFile(
+    const std::filesystem::path& file, const ConfigLoadOptions& options)
+{
+    return ConfigTree{internal::LuaSource::loadFile(file, options)};
 }
 
 ConfigTree ConfigTree::loadIniFile(const std::filesystem::path& file)
 {
-    const auto code = std::string{"local ini = require 'ini'\n"
-                                  "for k, v in pairs(ini.parse_file('"}
-                          .append(file.native())
-                          .append("')) do confetti[k] = v end");
-    return ConfigTree{internal::LuaSource::loadCode(code)};
+    return ConfigTree{internal::IniDocument::loadFile(file)};
 }
 
 ConfigTree ConfigTree::loadJsonFile(const std::filesystem::path& file)
 {
-    const auto code = std::string{R"!(
-local json = require 'lunajson'
-local file = assert(io.open(")!"}
-                          .append(file.native())
-                          .append(R"!(", "r"))
-local content = file:read("*all")
-file:close()
-for k, v in pairs(json.decode(content)) do confetti[k] = v end)!");
-    return ConfigTree{internal::LuaSource::loadCode(code)};
+    return ConfigTree{internal::loadJsonFile(file)};
+}
+
+ConfigTree ConfigTree::loadJson(std::istream& stream)
+{
+    return ConfigTree{internal::parseJson(stream)};
+}
+
+void ConfigTree::streamJsonFile(
+    const std::filesystem::path& file, const std::function<void(const ConfigTree&)>& callback)
+{
+    internal::streamJsonFile(file, [&callback](ConfigSourcePointer source) {
+        callback(ConfigTree{std::move(source)});
+    });
 }
 
-ConfigTree ConfigTree::loadFile(const std::filesystem::path& file)
+ConfigTree ConfigTree::loadBinaryFile(const std::filesystem::path& file)
+{
+    return ConfigTree{internal::SnapshotImage::loadFile(file)->getRootSource()};
+}
+
+ConfigTree ConfigTree::loadFile(
+    const std::filesystem::path& file, const ConfigLoadOptions& options)
 {
     const auto extension = file.extension().native();
     if (internal::strCaseEq(extension, ".lua")) {
-        return loadLuaFile(file);
+        return loadLuaFile(file, options);
     } else if (internal::strCaseEq(extension, ".json")) {
         return loadJsonFile(file);
     } else if (internal::strCaseEq(extension, ".ini")) {
         return loadIniFile(file);
+    } else if (internal::strCaseEq(extension, ".cfb")) {
+        return loadBinaryFile(file);
     }
     throw std::runtime_error{"Unknown configuration file type: " + file.native()};
 }
 
+ConfigTree ConfigTree::loadEnvironment(std::string_view prefix)
+{
+    size_t count = 0;
+    while (environ[count] != nullptr)
+        ++count;
+    return ConfigTree{internal::loadEnvironment(prefix, {environ, count})};
+}
+
+ConfigTree ConfigTree::loadArguments(int argc, const char* const* argv)
+{
+    if (argc < 1)
+        return ConfigTree{internal::loadArguments({})};
+    return ConfigTree{internal::loadArguments({argv + 1, static_cast<size_t>(argc - 1)})};
+}
+
+ConfigTree ConfigTree::loadFiles(
+    std::span<const std::filesystem::path> files, const ConfigLoadOptions& options)
+{
+    std::vector<ConfigSourcePointer> sources(files.size());
+    std::vector<std::exception_ptr> errors(files.size());
+    std::atomic<size_t> next{0};
+    const auto work = [&] {
+        for (auto i = next.fetch_add(1); i < files.size(); i = next.fetch_add(1)) {
+            try {
+                sources[i] = loadFile(files[i], options).getSnapshotSource();
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+    auto threads = static_cast<size_t>(options.loadThreads);
+    if (threads == 0)
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    {
+        std::vector<std::jthread> workers;
+        for (size_t i = 1; i < std::min(threads, files.size()); ++i)
+            workers.emplace_back(work);
+        work();
+    }
+    // The first failure in the order of files, no matter which thread was first to fail.
+    for (const auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    std::vector<const internal::SnapshotSource*> tables;
+    tables.reserve(sources.size());
+    for (const auto& source : sources)
+        tables.push_back(static_cast<const internal::SnapshotSource*>(source.get()));
+    return ConfigTree{internal::mergeSnapshots(tables)->getRootSource()};
+}
+
+ConfigTree ConfigTree::loadDirectory(
+    const std::filesystem::path& directory, const ConfigLoadOptions& options)
+{
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator{directory}) {
+        const auto extension = entry.path().extension().native();
+        if (entry.is_regular_file()
+            && (internal::strCaseEq(extension, ".lua") || internal::strCaseEq(extension, ".json")
+                || internal::strCaseEq(extension, ".ini")
+                || internal::strCaseEq(extension, ".cfb"))) {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return loadFiles(files, options);
+}
+
+ConfigSourcePointer ConfigTree::getSnapshotSource() const
+{
+    auto source = freeze().source_;
+    if (!source) {
+        internal::SnapshotBuilder builder;
+        builder.beginTable();
+        builder.endTable();
+        source = builder.finish()->getRootSource();
+    } else if (dynamic_cast<const internal::SnapshotSource*>(source.get()) == nullptr) {
+        // Immutable already, but not in the image layout.
+        source = source->ConfigSource::freeze();
+    }
+    return source;
+}
+
+void ConfigTree::saveBinaryFile(const std::filesystem::path& file) const
+{
+    const auto source = getSnapshotSource();
+    const auto& snapshot = static_cast<const internal::SnapshotSource&>(*source);
+    snapshot.getImage().saveFile(file, snapshot.getTable());
+}
+
 } // namespace confetti
@@ -17,15 +17,25 @@
 #ifndef CONFETTI_CONFIG_TREE_HH
 #define CONFETTI_CONFIG_TREE_HH
 
+#include "config_options.hh"
 #include "config_source.hh"
+#include "internal/path.hh"
+#include "internal/string.hh"
 #include "internal/type_traits.hh"
 #include <compare>
 #include <filesystem>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <span>
+#include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace confetti {
 
+class ConfigAccessLog;
 class ConfigTree;
 
 template <typename T>
@@ -57,6 +67,8 @@ public:
 
     [[nodiscard]] constexpr std::string_view getPathString() const noexcept { return path_; }
 
+    [[nodiscard]] constexpr std::string_view getSeparators() const noexcept { return sep_; }
+
 private:
     template <typename R, typename C>
     [[nodiscard]] R findNodeImpl(ConfigTree tree, const C& handler) const;
@@ -65,6 +77,56 @@ private:
     std::string_view sep_;
 };
 
+class BoundConfigPath;
+
+/// Path that is split into segments once, for lookups repeated many times.
+class CompiledConfigPath final {
+public:
+    explicit CompiledConfigPath(const ConfigPath& path);
+
+    explicit CompiledConfigPath(std::string_view path,
+        std::string_view separators = ConfigPath::getDefaultSeparators());
+
+    [[nodiscard]] ConfigTree getChildNode(ConfigTree tree) const;
+
+    [[nodiscard]] std::tuple<ConfigTree, ConfigKey> getValueNode(ConfigTree tree) const;
+
+    [[nodiscard]] const std::string& getPathString() const noexcept { return *path_; }
+
+    [[nodiscard]] std::span<const ConfigKey> getKeys() const noexcept { return keys_; }
+
+    /// Resolves all segments but the last one in the given tree.
+    [[nodiscard]] BoundConfigPath bind(const ConfigTree& tree) const;
+
+private:
+    // Keys point into the path string, which is shared by copies.
+    std::shared_ptr<const std::string> path_;
+    std::vector<ConfigKey> keys_;
+};
+
+/// Path literal that is split and hashed at compile time, see operator""_cp.
+template <internal::FixedString Path>
+class StaticConfigPath final {
+public:
+    static_assert(internal::isValidPath(Path.view(), ConfigPath::getDefaultSeparators()),
+        "Configuration path must not be empty or contain empty segments");
+
+    [[nodiscard]] static constexpr std::string_view getPathString() noexcept
+    {
+        return Path.view();
+    }
+
+    [[nodiscard]] static constexpr std::span<const ConfigKey> getKeys() noexcept { return keys_; }
+
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    constexpr operator ConfigPath() const noexcept { return ConfigPath{getPathString()}; }
+
+private:
+    static constexpr auto keys_ = internal::splitPath<internal::countPathSegments(
+                                      Path.view(), ConfigPath::getDefaultSeparators())>(
+        Path.view(), ConfigPath::getDefaultSeparators());
+};
+
 class ConfigTree final {
 public:
     struct EndIterator final {
@@ -92,6 +154,8 @@ public:
 
         decltype(auto) operator*() const { return tree_->get<T>(index_); }
 
+        [[nodiscard]] size_t getSizeHint() const { return tree_->size(); }
+
     private:
         const ConfigTree* tree_;
         int index_;
@@ -99,6 +163,12 @@ public:
 
     class ChildIterator;
 
+    class Item;
+
+    class ItemIterator;
+
+    class ItemRange;
+
     template <typename IteratorType>
     class Range final {
     public:
@@ -115,6 +185,7 @@ public:
         operator std::vector<decltype(*std::declval<IteratorType>())>() const
         {
             std::vector<decltype(*std::declval<IteratorType>())> result;
+            result.reserve(it_.getSizeHint());
             for (auto it = begin(); it != end(); ++it) {
                 result.emplace_back(*it);
             }
@@ -161,6 +232,17 @@ public:
         return path.getChildNode(*this);
     }
 
+    [[nodiscard]] ConfigTree tryGetChild(const CompiledConfigPath& path) const
+    {
+        return path.getChildNode(*this);
+    }
+
+    template <internal::FixedString P>
+    [[nodiscard]] ConfigTree tryGetChild(const StaticConfigPath<P>& path) const
+    {
+        return findChildNode(path.getKeys());
+    }
+
     template <typename K>
     [[nodiscard]] decltype(auto) getChild(K key) const
     {
@@ -236,23 +318,41 @@ public:
         return get<std::string>(key);
     }
 
+    /// Like tryGetString(), but without a copy. The view stays valid for as long as
+    /// any handle to this configuration is alive. Values that are not strings, and
+    /// those of backends that do not store strings, are converted once per distinct
+    /// value and kept under a lock. Use tryGetString() on hot paths for those.
+    template <typename K>
+    [[nodiscard]] decltype(auto) tryGetStringView(K key) const
+    {
+        return tryGet(&ConfigSource::tryGetStringView, key);
+    }
+
+    template <typename K>
+    [[nodiscard]] decltype(auto) getStringView(K key) const
+    {
+        return get<std::string_view>(key);
+    }
+
     template <typename T, typename K>
     [[nodiscard]] std::optional<T> tryGet(K key) const
     {
-        static_assert(internal::is_any_of_v<T, std::string, bool, double, int16_t, uint16_t,
-                          int32_t, uint32_t, int64_t, uint64_t>,
+        static_assert(internal::is_any_of_v<T, std::string, std::string_view, bool, double,
+                          int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t>,
             "Type not supported");
         if (source_) {
             if constexpr (std::is_same_v<T, std::string>) {
                 return source_->tryGetString(key);
+            } else if constexpr (std::is_same_v<T, std::string_view>) {
+                return source_->tryGetStringView(key);
             } else if constexpr (std::is_same_v<T, bool>) {
                 return source_->tryGetBoolean(key);
             } else if constexpr (std::is_same_v<T, double>) {
                 return source_->tryGetDouble(key);
             } else if constexpr (internal::is_any_of_v<T, int16_t, int32_t, int64_t>) {
-                return source_->tryGetNumber(key);
+                return narrow<T>(source_->tryGetNumber(key), key);
             } else if constexpr (internal::is_any_of_v<T, uint16_t, uint32_t, uint64_t>) {
-                return source_->tryGetUnsignedNumber(key);
+                return narrow<T>(source_->tryGetUnsignedNumber(key), key);
             }
         }
 
@@ -284,6 +384,34 @@ public:
         return tree.get<T>(key);
     }
 
+    template <typename T>
+    [[nodiscard]] std::optional<T> tryGet(const CompiledConfigPath& path) const
+    {
+        ConfigSourcePointer owner;
+        return findValueView(path.getKeys(), owner).tryGet<T>(path.getKeys().back());
+    }
+
+    template <typename T>
+    [[nodiscard]] T get(const CompiledConfigPath& path) const
+    {
+        ConfigSourcePointer owner;
+        return findValueView(path.getKeys(), owner).get<T>(path.getKeys().back());
+    }
+
+    template <typename T, internal::FixedString P>
+    [[nodiscard]] std::optional<T> tryGet(const StaticConfigPath<P>& path) const
+    {
+        ConfigSourcePointer owner;
+        return findValueView(path.getKeys(), owner).template tryGet<T>(path.getKeys().back());
+    }
+
+    template <typename T, internal::FixedString P>
+    [[nodiscard]] T get(const StaticConfigPath<P>& path) const
+    {
+        ConfigSourcePointer owner;
+        return findValueView(path.getKeys(), owner).template get<T>(path.getKeys().back());
+    }
+
     template <typename T, typename K>
     [[nodiscard]] T get(K key) const
     {
@@ -328,25 +456,136 @@ public:
         return Range<ValueIterator<T>>{ValueIterator<T>{*this}};
     }
 
+    /// Child sections of the array part. On trees backed by Lua, every child handle, here
+    /// or from tryGetChild(), takes a Lua registry reference and shares the Lua state, so
+    /// freeze() large trees that are walked often.
     [[nodiscard]] decltype(auto) children() const;
 
+    /// Named entries of this subtree, values and children alike, read in one pass in
+    /// no particular order. Keys are views into the backend and are not copied. Array
+    /// elements are not included, see values() and children().
+    [[nodiscard]] ItemRange items() const;
+
+    /// Number of elements in the array part, values and children alike.
+    [[nodiscard]] size_t size() const { return source_ ? source_->getArraySize() : 0; }
+
+    /// Copies leading values of the array part in one pass, which is much faster than
+    /// values() for large arrays. Returns how many were copied: fewer than requested
+    /// if the array is shorter, or has a gap or a subtree.
+    template <typename T>
+    size_t copyValues(std::span<T> values) const;
+
+    /// Reads leading values of the array part in one pass, up to the first gap or subtree.
+    template <typename T>
+    [[nodiscard]] std::vector<T> toVector() const;
+
     [[nodiscard]] ConfigValue<int> get(int index) const;
 
     [[nodiscard]] ConfigValue<std::string> get(std::string_view name) const;
 
     [[nodiscard]] ConfigValue<std::string> get(const ConfigPath& path) const;
 
-    [[nodiscard]] static ConfigTree loadLuaCode(std::string_view code);
+    [[nodiscard]] ConfigValue<std::string> get(const CompiledConfigPath& path) const;
+
+    template <internal::FixedString P>
+    [[nodiscard]] ConfigValue<std::string> get(const StaticConfigPath<P>& path) const;
+
+    /// Returns an immutable native copy of this tree. Reads from it never touch Lua,
+    /// and the original Lua state is released once the source tree is gone.
+    ///
+    /// Frozen trees are thread-safe: any number of threads may call the getters,
+    /// children() and values() of a frozen tree and its subtrees concurrently.
+    /// The read path takes no locks and does not allocate, except for returned
+    /// strings. Trees backed by Lua must not be shared between threads.
+    [[nodiscard]] ConfigTree freeze() const;
 
-    [[nodiscard]] static ConfigTree loadLuaFile(const std::filesystem::path& file);
+    [[nodiscard]] bool isThreadSafe() const noexcept { return !source_ || source_->isThreadSafe(); }
 
+    /// Returns this tree counting every read of it and of its subtrees in the log, by
+    /// path from this tree. Returns this tree as is unless the library is built with
+    /// CONFETTI_INSTRUMENTATION.
+    [[nodiscard]] ConfigTree instrument(std::shared_ptr<ConfigAccessLog> log) const;
+
+    [[nodiscard]] static ConfigTree loadLuaCode(
+        std::string_view code, const ConfigLoadOptions& options = ConfigLoadOptions{});
+
+    [[nodiscard]] static ConfigTree loadLuaFile(
+        const std::filesystem::path& file, const ConfigLoadOptions& options = ConfigLoadOptions{});
+
+    /// Parses the file natively, without Lua. The result is frozen already.
     [[nodiscard]] static ConfigTree loadJsonFile(const std::filesystem::path& file);
 
+    /// Parses JSON read from the stream in fixed-size chunks, so that the text is never
+    /// held in memory as a whole. The result is frozen already.
+    [[nodiscard]] static ConfigTree loadJson(std::istream& stream);
+
+    /// Reads a JSON file with an array at the top level in fixed-size chunks, and calls
+    /// the callback with every element, an object or an array, as soon as it is parsed.
+    /// Elements are dropped after the call unless the callback keeps them, so the array
+    /// does not have to fit in memory.
+    static void streamJsonFile(const std::filesystem::path& file,
+        const std::function<void(const ConfigTree&)>& callback);
+
+    /// Parses the file natively, without Lua. Keys and values are not copied
+    /// out of the memory mapped file, so the result changes if the file is
+    /// rewritten in place. freeze() copies them out.
     [[nodiscard]] static ConfigTree loadIniFile(const std::filesystem::path& file);
 
-    [[nodiscard]] static ConfigTree loadFile(const std::filesystem::path& file);
+    /// Maps a compiled configuration written by saveBinaryFile() or confetti-compile
+    /// read-only. Nothing is parsed or copied, and processes that load the same file
+    /// share its pages. The result is frozen already.
+    [[nodiscard]] static ConfigTree loadBinaryFile(const std::filesystem::path& file);
+
+    /// Loads a .lua, .json, .ini or compiled .cfb file, depending on its extension.
+    [[nodiscard]] static ConfigTree loadFile(
+        const std::filesystem::path& file, const ConfigLoadOptions& options = ConfigLoadOptions{});
+
+    /// Environment variables named after the prefix and a path, all separated by "__",
+    /// such as APP__SERVER__PORT for server.port with prefix APP. Values are typed once,
+    /// while loading: true and false become booleans, and numbers that read back as the
+    /// same text become numbers. The result is frozen already.
+    [[nodiscard]] static ConfigTree loadEnvironment(std::string_view prefix);
+
+    /// Options such as --server.port=8080 from the command line, typed as with
+    /// loadEnvironment(). An option without a value is true. The first argument is the
+    /// program name, and "--" ends the options.
+    [[nodiscard]] static ConfigTree loadArguments(int argc, const char* const* argv);
+
+    /// Loads the files on ConfigLoadOptions::loadThreads threads, and deep-merges them
+    /// in the order given: tables merge by key, anything else in a later file replaces
+    /// what earlier ones have, arrays as a whole. The result is frozen already. Throws
+    /// the error of the first file that fails to load.
+    [[nodiscard]] static ConfigTree loadFiles(std::span<const std::filesystem::path> files,
+        const ConfigLoadOptions& options = ConfigLoadOptions{});
+
+    /// Loads and merges all configuration files in the directory, like loadFiles(), in
+    /// the order of their names. Other files and subdirectories are ignored.
+    [[nodiscard]] static ConfigTree loadDirectory(const std::filesystem::path& directory,
+        const ConfigLoadOptions& options = ConfigLoadOptions{});
+
+    /// Compiles this tree into a file for loadBinaryFile(). Values keep their types,
+    /// except for backends that only have strings, such as INI. The file is replaced
+    /// atomically.
+    void saveBinaryFile(const std::filesystem::path& file) const;
 
 private:
+    friend class CompiledConfigPath;
+    friend class OverlayConfig;
+
+    // Frozen into the image layout, a SnapshotSource.
+    [[nodiscard]] ConfigSourcePointer getSnapshotSource() const;
+
+    [[nodiscard]] ConfigTree findChildNode(std::span<const ConfigKey> path) const;
+
+    [[nodiscard]] std::tuple<ConfigTree, ConfigKey> findValueNode(
+        std::span<const ConfigKey> path) const;
+
+    // Resolves all keys but the last one with ConfigSource::tryGetChildView(). The
+    // result does not own its source, so it is only valid while `owner` and this tree
+    // are, but reading through it touches no reference counts.
+    [[nodiscard]] ConfigTree findValueView(
+        std::span<const ConfigKey> path, ConfigSourcePointer& owner) const;
+
     template <typename R>
     [[nodiscard]] R tryGet(R (ConfigSource::*getter)(int) const, int key) const
     {
@@ -360,6 +599,13 @@ private:
         return source_ ? (source_.get()->*getter)(key) : R{};
     }
 
+    template <typename R>
+    [[nodiscard]] R tryGet(
+        R (ConfigSource::*getter)(const ConfigKey&) const, const ConfigKey& key) const
+    {
+        return source_ ? (source_.get()->*getter)(key) : R{};
+    }
+
     template <typename R>
     [[nodiscard]] R tryGet(
         R (ConfigSource::*getter)(std::string_view) const, const ConfigPath& path) const
@@ -368,21 +614,88 @@ private:
         return tree.source_ ? (tree.source_.get()->*getter)(key) : R{};
     }
 
+    template <typename R>
+    [[nodiscard]] R tryGet(
+        R (ConfigSource::*getter)(const ConfigKey&) const, const CompiledConfigPath& path) const
+    {
+        ConfigSourcePointer owner;
+        return findValueView(path.getKeys(), owner).tryGet(getter, path.getKeys().back());
+    }
+
+    template <typename R, internal::FixedString P>
+    [[nodiscard]] R tryGet(
+        R (ConfigSource::*getter)(const ConfigKey&) const, const StaticConfigPath<P>& path) const
+    {
+        ConfigSourcePointer owner;
+        return findValueView(path.getKeys(), owner).tryGet(getter, path.getKeys().back());
+    }
+
+    template <typename T, typename U, typename K>
+    [[nodiscard]] static std::optional<T> narrow(std::optional<U> value, const K& key)
+    {
+        if constexpr (std::is_same_v<T, U>) {
+            return value;
+        } else {
+            if (!value.has_value())
+                return {};
+            if (!std::in_range<T>(*value))
+                outOfRange(key, std::to_string(*value));
+            return static_cast<T>(*value);
+        }
+    }
+
+    [[noreturn]] static void outOfRange(int index, std::string_view value);
+
+    [[noreturn]] static void outOfRange(std::string_view name, std::string_view value);
+
+    [[noreturn]] static void outOfRange(const ConfigKey& key, std::string_view value)
+    {
+        outOfRange(key.getName(), value);
+    }
+
+    [[noreturn]] static void notAValue(std::string_view name);
+
     [[noreturn]] static void noSuchChild(int index);
 
     [[noreturn]] static void noSuchChild(std::string_view name);
 
+    [[noreturn]] static void noSuchChild(const ConfigKey& key) { noSuchChild(key.getName()); }
+
     [[noreturn]] static void noSuchChild(const ConfigPath& path)
     {
         noSuchChild(path.getPathString());
     }
 
+    [[noreturn]] static void noSuchChild(const CompiledConfigPath& path)
+    {
+        noSuchChild(path.getPathString());
+    }
+
+    template <internal::FixedString P>
+    [[noreturn]] static void noSuchChild(const StaticConfigPath<P>& path)
+    {
+        noSuchChild(path.getPathString());
+    }
+
     [[noreturn]] void noSuchKey(int index) const;
 
     [[noreturn]] void noSuchKey(std::string_view name) const;
 
+    [[noreturn]] void noSuchKey(const ConfigKey& key) const { noSuchKey(key.getName()); }
+
     [[noreturn]] void noSuchKey(const ConfigPath& path) const { noSuchKey(path.getPathString()); }
 
+    [[noreturn]] void noSuchKey(const CompiledConfigPath& path) const
+    {
+        noSuchKey(path.getPathString());
+    }
+
+    template <internal::FixedString P>
+    [[noreturn]] void noSuchKey(const StaticConfigPath<P>& path) const
+    {
+        noSuchKey(path.getPathString());
+    }
+
     ConfigSourcePointer source_;
 };
 
@@ -436,6 +749,63 @@ inline ConfigValue<std::string> ConfigTree::get(const ConfigPath& path) const
     return tree.get(key);
 }
 
+inline ConfigValue<std::string> ConfigTree::get(const CompiledConfigPath& path) const
+{
+    auto [tree, key] = path.getValueNode(*this);
+    return tree.get(key.getName());
+}
+
+template <internal::FixedString P>
+inline ConfigValue<std::string> ConfigTree::get(const StaticConfigPath<P>& path) const
+{
+    auto [tree, key] = findValueNode(path.getKeys());
+    return tree.get(key.getName());
+}
+
+/// Compiled path with its parent node resolved, so that reads cost a single lookup.
+class BoundConfigPath final {
+public:
+    BoundConfigPath(ConfigTree node, const ConfigKey& key)
+        : node_{std::move(node)}
+        , key_{key.getName()}
+        , hash_{key.getHash()}
+    {
+    }
+
+    [[nodiscard]] const ConfigTree& getNode() const noexcept { return node_; }
+
+    [[nodiscard]] std::string_view getKey() const noexcept { return key_; }
+
+    [[nodiscard]] ConfigTree tryGetChild() const { return node_.tryGetChild(getConfigKey()); }
+
+    [[nodiscard]] ConfigTree getChild() const { return node_.getChild(getConfigKey()); }
+
+    template <typename T>
+    [[nodiscard]] std::optional<T> tryGet() const
+    {
+        return node_.tryGet<T>(getConfigKey());
+    }
+
+    template <typename T>
+    [[nodiscard]] T get() const
+    {
+        return node_.get<T>(getConfigKey());
+    }
+
+    template <typename T, typename U>
+    [[nodiscard]] T get(U&& default_value) const
+    {
+        return node_.get<T>(getConfigKey(), std::forward<U>(default_value));
+    }
+
+private:
+    [[nodiscard]] ConfigKey getConfigKey() const noexcept { return ConfigKey{key_, hash_}; }
+
+    ConfigTree node_;
+    std::string key_;
+    uint64_t hash_;
+};
+
 class ConfigTree::ChildIterator final {
 public:
     explicit ChildIterator(const ConfigTree& tree) noexcept
@@ -455,6 +825,8 @@ public:
 
     decltype(auto) operator*() const { return child_; }
 
+    [[nodiscard]] size_t getSizeHint() const { return tree_->size(); }
+
 private:
     const ConfigTree* tree_;
     ConfigTree child_;
@@ -466,11 +838,144 @@ inline decltype(auto) ConfigTree::children() const
     return Range<ChildIterator>{ChildIterator{*this}};
 }
 
+// The current entry of items(), valid until the iterator moves on.
+class ConfigTree::Item final {
+public:
+    explicit Item(const ConfigItemCursor* cursor) noexcept
+        : cursor_{cursor}
+    {
+    }
+
+    [[nodiscard]] std::string_view getKey() const { return cursor_->getKey(); }
+
+    /// Returns an empty tree if the entry is a value.
+    [[nodiscard]] ConfigTree getChild() const { return ConfigTree{cursor_->getChild()}; }
+
+    template <typename T>
+    [[nodiscard]] std::optional<T> tryGet() const
+    {
+        static_assert(internal::is_any_of_v<T, std::string, std::string_view, bool, double,
+                          int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t>,
+            "Type not supported");
+        if constexpr (std::is_same_v<T, std::string>) {
+            return cursor_->getString();
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+            return cursor_->getStringView();
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return cursor_->getBoolean();
+        } else if constexpr (std::is_same_v<T, double>) {
+            return cursor_->getDouble();
+        } else if constexpr (internal::is_any_of_v<T, int16_t, int32_t, int64_t>) {
+            return narrow<T>(cursor_->getNumber(), getKey());
+        } else {
+            return narrow<T>(cursor_->getUnsignedNumber(), getKey());
+        }
+    }
+
+    template <typename T>
+    [[nodiscard]] T get() const
+    {
+        auto result = tryGet<T>();
+        if (!result.has_value())
+            notAValue(getKey());
+        return *std::move(result);
+    }
+
+private:
+    const ConfigItemCursor* cursor_;
+};
+
+class ConfigTree::ItemIterator final {
+public:
+    explicit ItemIterator(std::unique_ptr<ConfigItemCursor> cursor)
+        : cursor_{std::move(cursor)}
+        , item_{cursor_.get()}
+        , valid_{cursor_ && cursor_->next()}
+    {
+    }
+
+    bool operator!=(EndIterator) const noexcept { return valid_; }
+
+    ItemIterator& operator++()
+    {
+        valid_ = cursor_->next();
+        return *this;
+    }
+
+    const Item& operator*() const noexcept { return item_; }
+
+private:
+    std::unique_ptr<ConfigItemCursor> cursor_;
+    Item item_;
+    bool valid_;
+};
+
+// Single pass: every begin() starts a new traversal.
+class ConfigTree::ItemRange final {
+public:
+    explicit ItemRange(ConfigTree tree) noexcept
+        : tree_{std::move(tree)}
+    {
+    }
+
+    [[nodiscard]] ItemIterator begin() const
+    {
+        return ItemIterator{tree_.source_ ? tree_.source_->getItems() : nullptr};
+    }
+
+    static constexpr auto end() noexcept { return EndIterator{}; }
+
+private:
+    ConfigTree tree_;
+};
+
+inline ConfigTree::ItemRange ConfigTree::items() const { return ItemRange{*this}; }
+
+template <typename T>
+size_t ConfigTree::copyValues(std::span<T> values) const
+{
+    static_assert(internal::is_any_of_v<T, std::string, std::string_view, bool, double, int16_t,
+                      uint16_t, int32_t, uint32_t, int64_t, uint64_t>,
+        "Type not supported");
+    if (!source_)
+        return 0;
+    if constexpr (internal::is_any_of_v<T, std::string, std::string_view, bool, double, int64_t,
+                      uint64_t>) {
+        return source_->copyValues(values);
+    } else {
+        using Wide = std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>;
+        std::vector<Wide> wide(values.size());
+        const auto count = source_->copyValues(std::span<Wide>{wide});
+        for (size_t i = 0; i < count; ++i)
+            values[i] = *narrow<T>(std::optional<Wide>{wide[i]}, static_cast<int>(i));
+        return count;
+    }
+}
+
+template <typename T>
+std::vector<T> ConfigTree::toVector() const
+{
+    const auto size = this->size();
+    if constexpr (std::is_same_v<T, bool>) {
+        // std::vector<bool> cannot be viewed as a span.
+        auto buffer = std::make_unique<bool[]>(size);
+        const auto count = copyValues(std::span<bool>{buffer.get(), size});
+        return std::vector<bool>(buffer.get(), buffer.get() + count);
+    } else {
+        std::vector<T> result(size);
+        result.resize(copyValues(std::span<T>{result}));
+        return result;
+    }
+}
+
 namespace literals {
 
-inline ConfigPath operator""_cp(const char* data, size_t size) noexcept
+/// Path literal, e.g. "server.http.port"_cp. Segments are split and hashed at
+/// compile time, and malformed paths fail to compile.
+template <internal::FixedString Path>
+consteval StaticConfigPath<Path> operator""_cp() noexcept
 {
-    return ConfigPath{std::string_view{data, size}};
+    return {};
 }
 
 } // namespace literals
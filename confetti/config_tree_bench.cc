@@ -0,0 +1,730 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "config_tree.hh"
+#include "internal/levenshtein.hh"
+#include "internal/lua.hh"
+#include "internal/snapshot.hh"
+#include "overlay_config.hh"
+#include <algorithm>
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <new>
+#include <sstream>
+
+#if defined(__GLIBC__)
+#    include <malloc.h>
+#endif
+
+namespace {
+
+std::atomic<int64_t> allocationCount{0};
+
+} // namespace
+
+// Counts allocations made through operator new, to tell which paths allocate.
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+// GCC sees free() paired with operator new once the replacements are inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+#if defined(__GNUC__) && !defined(__clang__)
+#    pragma GCC diagnostic pop
+#endif
+
+namespace {
+
+confetti::ConfigTree makeSnapshot()
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("server");
+    builder.beginTable();
+    builder.setKey("workers");
+    builder.addInteger(64);
+    builder.setKey("http");
+    builder.beginTable();
+    builder.setKey("host");
+    builder.addString("localhost");
+    builder.setKey("port");
+    builder.addInteger(8080);
+    builder.setKey("tls");
+    builder.addBoolean(true);
+    builder.endTable();
+    builder.endTable();
+    builder.endTable();
+    return confetti::ConfigTree{builder.finish()->getRootSource()};
+}
+
+// A section of 16 string values with realistic key names.
+confetti::ConfigSourcePointer makeSection()
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    for (int i = 0; i < 16; ++i) {
+        builder.setKey("backend_connection_option_" + std::to_string(i));
+        builder.addString("value " + std::to_string(i));
+    }
+    builder.endTable();
+    return builder.finish()->getRootSource();
+}
+
+const confetti::ConfigTree& getSnapshot()
+{
+    static const auto tree = makeSnapshot();
+    return tree;
+}
+
+// Roughly 200 bytes per server entry.
+void writeJsonServers(std::ostream& stream, int64_t servers)
+{
+    for (int64_t i = 0; i < servers; ++i) {
+        stream << (i ? ",\n" : "") << "    {\"name\": \"server-" << i << "\", \"host\": \"10.0."
+               << i / 256 % 256 << "." << i % 256 << "\", \"port\": " << 8000 + i % 1000
+               << ", \"weight\": " << 0.25 * (i % 7)
+               << ", \"enabled\": " << (i % 3 ? "true" : "false")
+               << ", \"description\": \"Backend server \\\"" << i
+               << "\\\" in the default pool\", \"tags\": [\"http\", \"internal\", null]}";
+    }
+}
+
+// Generated JSON config with a list of servers.
+const std::filesystem::path& getJsonFile(int64_t servers)
+{
+    static std::map<int64_t, std::filesystem::path> files;
+    auto& path = files[servers];
+    if (!path.empty())
+        return path;
+    path = std::filesystem::temp_directory_path()
+        / ("confetti_bench_" + std::to_string(servers) + "_servers.json");
+    std::ofstream stream{path};
+    stream << "{\n  \"servers\": [\n";
+    writeJsonServers(stream, servers);
+    stream << "\n  ]\n}\n";
+    return path;
+}
+
+// The same servers as an array at the top level.
+const std::filesystem::path& getJsonArrayFile(int64_t servers)
+{
+    static std::map<int64_t, std::filesystem::path> files;
+    auto& path = files[servers];
+    if (!path.empty())
+        return path;
+    path = std::filesystem::temp_directory_path()
+        / ("confetti_bench_" + std::to_string(servers) + "_array.json");
+    std::ofstream stream{path};
+    stream << "[\n";
+    writeJsonServers(stream, servers);
+    stream << "\n]\n";
+    return path;
+}
+
+// Generated per-service INI file with a handful of sections.
+const std::filesystem::path& getIniFile()
+{
+    static const auto file = [] {
+        auto path = std::filesystem::temp_directory_path() / "confetti_bench.ini";
+        std::ofstream stream{path};
+        stream << "; Generated service configuration\nname = \"service\"\n";
+        for (int section = 0; section < 8; ++section) {
+            stream << "\n[section" << section << "]\n";
+            for (int key = 0; key < 16; ++key)
+                stream << "key" << key << " = value " << section * 16 + key << " ; comment\n";
+        }
+        return path;
+    }();
+    return file;
+}
+
+// Generated Lua config with a table per server, built by running code.
+const std::string& getLuaCode(int64_t servers)
+{
+    static std::map<int64_t, std::string> codes;
+    auto& code = codes[servers];
+    if (!code.empty())
+        return code;
+    std::ostringstream stream;
+    stream << "local servers = {}\nfor i = 0, " << servers - 1 << " do\n"
+           << "  servers[#servers + 1] = {name = 'server-' .. i, host = '10.0.' .. i // 256 "
+              "% 256 .. '.' .. i % 256, port = 8000 + i % 1000, weight = 0.25 * (i % 7), "
+              "enabled = i % 3 ~= 0, tags = {'http', 'internal'}}\nend\n"
+           << "confetti.servers = servers\n";
+    code = std::move(stream).str();
+    return code;
+}
+
+constexpr const char* generatedExtensions[] = {".lua", ".json", ".ini"};
+
+constexpr int64_t generatedSectionSize = 100;
+
+// Generated config of sections with 100 keys each, alternating strings and integers,
+// as Lua (0), JSON (1) or INI (2).
+const std::filesystem::path& getGeneratedFile(int64_t format, int64_t keys)
+{
+    static std::map<std::pair<int64_t, int64_t>, std::filesystem::path> files;
+    auto& path = files[{format, keys}];
+    if (!path.empty())
+        return path;
+    path = std::filesystem::temp_directory_path()
+        / ("confetti_bench_" + std::to_string(keys) + generatedExtensions[format]);
+    std::ofstream stream{path};
+    stream << (format == 1 ? "{" : "");
+    for (int64_t section = 0; section * generatedSectionSize < keys; ++section) {
+        const auto size = std::min(generatedSectionSize, keys - section * generatedSectionSize);
+        switch (format) {
+        case 0:
+            stream << "confetti.section_" << section << " = {";
+            for (int64_t key = 0; key < size; ++key) {
+                stream << "\n  key_" << key << " = ";
+                key % 2 ? stream << key : stream << "\"value " << key << '"';
+                stream << ',';
+            }
+            stream << "\n}\n";
+            break;
+        case 1:
+            stream << (section ? ",\n" : "\n") << "  \"section_" << section << "\": {";
+            for (int64_t key = 0; key < size; ++key) {
+                stream << (key ? ",\n" : "\n") << "    \"key_" << key << "\": ";
+                key % 2 ? stream << key : stream << "\"value " << key << '"';
+            }
+            stream << "\n  }";
+            break;
+        default:
+            stream << "[section_" << section << "]\n";
+            for (int64_t key = 0; key < size; ++key) {
+                stream << "key_" << key << " = ";
+                key % 2 ? stream << key : stream << "value " << key;
+                stream << '\n';
+            }
+            break;
+        }
+    }
+    stream << (format == 1 ? "\n}\n" : "");
+    return path;
+}
+
+void applyGeneratedArgs(benchmark::internal::Benchmark* bench)
+{
+    bench->ArgNames({"format", "keys"});
+    for (int64_t format = 0; format < 3; ++format) {
+        for (int64_t keys : {1000, 100000, 1000000})
+            bench->Args({format, keys});
+    }
+}
+
+// Generated Lua array of string arrays, like string_matrix_array in the tests.
+confetti::ConfigSourcePointer loadStringMatrix(int64_t rows)
+{
+    return confetti::internal::LuaSource::loadCode("local rows = {}\nfor i = 1, "
+        + std::to_string(rows)
+        + " do rows[i] = {'a' .. i, 'b' .. i, 'c' .. i} end\nconfetti.rows = rows\n");
+}
+
+// Bytes the process heap holds, used or not. Fragmentation keeps it from shrinking.
+double getHeapSize()
+{
+#if defined(__GLIBC__)
+    const auto info = mallinfo2();
+    return static_cast<double>(info.arena + info.hblkhd);
+#else
+    return 0;
+#endif
+}
+
+} // namespace
+
+// Values of a resolved subtree: shares nothing writable between threads.
+static void ConcurrentValueReads(benchmark::State& state)
+{
+    const auto http = getSnapshot()["server"]["http"];
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(http.get<int64_t>("port"));
+        benchmark::DoNotOptimize(http.get<bool>("tls"));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * 2);
+}
+
+BENCHMARK(ConcurrentValueReads)->ThreadRange(1, 64)->UseRealTime();
+
+// Walking down from the root: every step copies a shared subtree handle.
+static void ConcurrentPathReads(benchmark::State& state)
+{
+    const auto& tree = getSnapshot();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree["server"]["http"].get<int64_t>("port"));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(ConcurrentPathReads)->ThreadRange(1, 64)->UseRealTime();
+
+// Dotted path lookups: split and hashed on every call, once, or at compile time.
+static void RuntimePathReads(benchmark::State& state)
+{
+    const auto& tree = getSnapshot();
+    const confetti::ConfigPath path{"server.http.port"};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.get<int64_t>(path));
+    }
+}
+
+BENCHMARK(RuntimePathReads);
+
+static void CompiledPathReads(benchmark::State& state)
+{
+    const auto& tree = getSnapshot();
+    const confetti::CompiledConfigPath path{"server.http.port"};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.get<int64_t>(path));
+    }
+}
+
+BENCHMARK(CompiledPathReads);
+
+static void StaticPathReads(benchmark::State& state)
+{
+    using namespace confetti::literals;
+    const auto& tree = getSnapshot();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.get<int64_t>("server.http.port"_cp));
+    }
+}
+
+BENCHMARK(StaticPathReads);
+
+static void LoadJsonNative(benchmark::State& state)
+{
+    const auto& file = getJsonFile(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(confetti::ConfigTree::loadJsonFile(file));
+    }
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * std::filesystem::file_size(file)));
+}
+
+BENCHMARK(LoadJsonNative)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+// The same config read from a stream in chunks instead of mapped.
+static void LoadJsonStream(benchmark::State& state)
+{
+    const auto& file = getJsonFile(state.range(0));
+    for (auto _ : state) {
+        std::ifstream stream{file, std::ios::binary};
+        benchmark::DoNotOptimize(confetti::ConfigTree::loadJson(stream));
+    }
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * std::filesystem::file_size(file)));
+}
+
+BENCHMARK(LoadJsonStream)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+// The servers streamed one at a time. Reports the peak heap growth, which
+// does not depend on the number of servers.
+static void StreamJsonElements(benchmark::State& state)
+{
+    const auto& file = getJsonArrayFile(state.range(0));
+    const auto before = getHeapSize();
+    double peak = 0;
+    for (auto _ : state) {
+        int64_t ports = 0;
+        confetti::ConfigTree::streamJsonFile(file, [&](const confetti::ConfigTree& server) {
+            ports += server.get<int>("port");
+            if (server.get<int>("port") == 8999)
+                peak = std::max(peak, getHeapSize() - before);
+        });
+        benchmark::DoNotOptimize(ports);
+    }
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * std::filesystem::file_size(file)));
+    state.counters["peak_heap_growth_mb"] = peak / 1e6;
+}
+
+BENCHMARK(StreamJsonElements)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+// The same config compiled ahead of time. Loading maps the file, and the first
+// read touches only the pages it needs.
+static void LoadBinary(benchmark::State& state)
+{
+    auto file = getJsonFile(state.range(0));
+    file.replace_extension(".cfb");
+    confetti::ConfigTree::loadJsonFile(getJsonFile(state.range(0))).saveBinaryFile(file);
+    for (auto _ : state) {
+        auto tree = confetti::ConfigTree::loadFile(file);
+        benchmark::DoNotOptimize(tree["servers"][0].get<int>("port"));
+    }
+}
+
+BENCHMARK(LoadBinary)->Arg(50000)->Unit(benchmark::kMicrosecond);
+
+// The loader used before the native parser: lunajson running inside Lua.
+static void LoadJsonLunajson(benchmark::State& state)
+{
+    const auto& file = getJsonFile(state.range(0));
+    const auto code = std::string{R"!(
+local json = require 'lunajson'
+local file = assert(io.open(")!"}
+                          .append(file.native())
+                          .append(R"!(", "r"))
+local content = file:read("*all")
+file:close()
+for k, v in pairs(json.decode(content)) do confetti[k] = v end)!");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(confetti::ConfigTree::loadLuaCode(code));
+    }
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * std::filesystem::file_size(file)));
+}
+
+BENCHMARK(LoadJsonLunajson)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+static void LoadIniNative(benchmark::State& state)
+{
+    const auto& file = getIniFile();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(confetti::ConfigTree::loadIniFile(file));
+    }
+}
+
+BENCHMARK(LoadIniNative)->Unit(benchmark::kMicrosecond);
+
+// The loader used before the native parser: ini.lua running inside Lua.
+static void LoadIniLua(benchmark::State& state)
+{
+    const auto code = std::string{"local ini = require 'ini'\n"
+                                  "for k, v in pairs(ini.parse_file('"}
+                          .append(getIniFile().native())
+                          .append("')) do confetti[k] = v end");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(confetti::ConfigTree::loadLuaCode(code));
+    }
+}
+
+BENCHMARK(LoadIniLua)->Unit(benchmark::kMicrosecond);
+
+// Loads and freezes a Lua config the way LiveConfig does, then drops the Lua
+// state. Reports how much the process heap grew while doing so.
+static void LoadLuaAllocator(benchmark::State& state)
+{
+    const confetti::ConfigLoadOptions options{static_cast<confetti::LuaAllocator>(state.range(0))};
+    const auto& code = getLuaCode(state.range(1));
+    const auto before = getHeapSize();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(confetti::ConfigTree::loadLuaCode(code, options).freeze());
+    }
+    state.counters["heap_growth_mb"] = (getHeapSize() - before) / 1e6;
+}
+
+BENCHMARK(LoadLuaAllocator)
+    ->ArgNames({"allocator", "servers"})
+    ->Args({static_cast<int64_t>(confetti::LuaAllocator::System), 50000})
+    ->Args({static_cast<int64_t>(confetti::LuaAllocator::Arena), 50000})
+    ->Args({static_cast<int64_t>(confetti::LuaAllocator::SizeClass), 50000})
+    ->Unit(benchmark::kMillisecond);
+
+static confetti::ConfigTree makeWeights(bool frozen)
+{
+    auto tree = confetti::ConfigTree::loadLuaCode(R"!(
+local weights = {}
+for i = 1, 100000 do weights[i] = i / 4 end
+confetti.weights = weights
+)!")["weights"];
+    return frozen ? tree.freeze() : tree;
+}
+
+// Element by element, each one looked up twice.
+static void ArrayValues(benchmark::State& state)
+{
+    const auto tree = makeWeights(state.range(0) != 0);
+    for (auto _ : state) {
+        std::vector<double> values = tree.values<double>();
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * tree.size()));
+}
+
+BENCHMARK(ArrayValues)->ArgName("frozen")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+static void ArrayToVector(benchmark::State& state)
+{
+    const auto tree = makeWeights(state.range(0) != 0);
+    for (auto _ : state) {
+        auto values = tree.toVector<double>();
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * tree.size()));
+}
+
+BENCHMARK(ArrayToVector)->ArgName("frozen")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// Walks every child of a large array. Reports allocations and Lua registry
+// references made per child.
+static void ChildIteration(benchmark::State& state)
+{
+    const auto source = loadStringMatrix(state.range(1));
+    const auto& lua = static_cast<const confetti::internal::LuaSource&>(*source).getState();
+    auto tree = confetti::ConfigTree{source}["rows"];
+    if (state.range(0) != 0)
+        tree = tree.freeze();
+    const auto before = allocationCount.load();
+    const auto refsBefore = lua.getChildReferenceCount();
+    for (auto _ : state) {
+        size_t count = 0;
+        for (const auto& row : tree.children())
+            count += row.size();
+        benchmark::DoNotOptimize(count);
+    }
+    const auto children = static_cast<double>(state.iterations() * state.range(1));
+    state.counters["allocations_per_child"]
+        = static_cast<double>(allocationCount.load() - before) / children;
+    state.counters["registry_refs_per_child"]
+        = static_cast<double>(lua.getChildReferenceCount() - refsBefore) / children;
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(1));
+}
+
+BENCHMARK(ChildIteration)
+    ->ArgNames({"frozen", "rows"})
+    ->Args({0, 10000})
+    ->Args({1, 10000})
+    ->Unit(benchmark::kMicrosecond);
+
+// Reads every entry of a section: listing the keys and looking each one up, or in one pass.
+static void SectionKeyList(benchmark::State& state)
+{
+    const auto source = makeSection();
+    for (auto _ : state) {
+        for (const auto& key : source->getKeyList())
+            benchmark::DoNotOptimize(source->tryGetStringView(key));
+    }
+}
+
+BENCHMARK(SectionKeyList);
+
+static void SectionItems(benchmark::State& state)
+{
+    const confetti::ConfigTree tree{makeSection()};
+    for (auto _ : state) {
+        for (const auto& item : tree.items())
+            benchmark::DoNotOptimize(item.tryGet<std::string_view>());
+    }
+}
+
+BENCHMARK(SectionItems);
+
+// Error path of a lookup miss in a large section, once the key index is built.
+static void KeyNotFoundSuggestion(benchmark::State& state)
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        builder.setKey("backend_connection_option_" + std::to_string(i));
+        builder.addInteger(i);
+    }
+    builder.endTable();
+    const confetti::ConfigTree tree{builder.finish()->getRootSource()};
+    for (auto _ : state) {
+        try {
+            (void)tree.get<int>("backend_conection_option_1234");
+        } catch (const std::runtime_error& e) {
+            benchmark::DoNotOptimize(e.what());
+        }
+    }
+}
+
+BENCHMARK(KeyNotFoundSuggestion)->Arg(100)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+// Edit distance between a mistyped key and similar ones, as compared by suggestions:
+// the weighted matrix, the same bounded by the distance of the first key, and the
+// bit-parallel unit distance.
+static void EditDistance(benchmark::State& state)
+{
+    using namespace confetti::internal;
+    const std::string_view name = "backend_conection_option_1234";
+    const std::string_view keys[] = {"backend_connection_option_1234",
+        "backend_connection_option_4321", "frontend_connection_timeout", "port"};
+    const auto bound = distance(name, keys[0]);
+    for (auto _ : state) {
+        for (auto key : keys) {
+            switch (state.range(0)) {
+            case 0:
+                benchmark::DoNotOptimize(distance(name, key));
+                break;
+            case 1:
+                benchmark::DoNotOptimize(distance(name, key, {}, bound));
+                break;
+            default:
+                benchmark::DoNotOptimize(unitDistance(name, key));
+                break;
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * std::size(keys)));
+}
+
+BENCHMARK(EditDistance)->ArgName("kernel")->DenseRange(0, 2);
+
+// Reads of a value computed by a Lua function, called every time or once, and of a plain value.
+static void LuaFunctionReads(benchmark::State& state)
+{
+    const confetti::ConfigLoadOptions options{
+        confetti::LuaAllocator::System, static_cast<confetti::LuaFunctions>(state.range(0))};
+    const auto tree = confetti::ConfigTree::loadLuaCode(
+        "confetti.plain = 64\nconfetti.derived = function() return confetti.plain // 4 end\n",
+        options);
+    const auto* key = state.range(1) != 0 ? "plain" : "derived";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.get<int>(key));
+    }
+}
+
+BENCHMARK(LuaFunctionReads)
+    ->ArgNames({"functions", "plain"})
+    ->Args({static_cast<int64_t>(confetti::LuaFunctions::EveryTime), 0})
+    ->Args({static_cast<int64_t>(confetti::LuaFunctions::Once), 0})
+    ->Args({static_cast<int64_t>(confetti::LuaFunctions::Once), 1});
+
+// Loads a generated file of each format and size by its extension, as applications do.
+static void LoadGeneratedFile(benchmark::State& state)
+{
+    const auto& file = getGeneratedFile(state.range(0), state.range(1));
+    for (auto _ : state) {
+        auto tree = confetti::ConfigTree::loadFile(file);
+        benchmark::DoNotOptimize(tree["section_0"].get<int>("key_1"));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * state.range(1));
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * std::filesystem::file_size(file)));
+}
+
+BENCHMARK(LoadGeneratedFile)->Apply(applyGeneratedArgs)->Unit(benchmark::kMillisecond);
+
+// A value of a generated file, looked up by name in its section or by path from the root.
+static void GeneratedValueReads(benchmark::State& state)
+{
+    const auto tree = confetti::ConfigTree::loadFile(getGeneratedFile(state.range(0), 1000));
+    const auto section = tree["section_5"];
+    const confetti::ConfigPath path{"section_5.key_51"};
+    for (auto _ : state) {
+        if (state.range(1) != 0) {
+            benchmark::DoNotOptimize(tree.get<int>(path));
+        } else {
+            benchmark::DoNotOptimize(section.get<int>("key_51"));
+        }
+    }
+}
+
+BENCHMARK(GeneratedValueReads)
+    ->ArgNames({"format", "path"})
+    ->Args({0, 0})
+    ->Args({0, 1})
+    ->Args({1, 0})
+    ->Args({1, 1})
+    ->Args({2, 0})
+    ->Args({2, 1});
+
+// Array elements one by one, by index.
+static void IndexReads(benchmark::State& state)
+{
+    const auto tree = makeWeights(state.range(0) != 0);
+    const auto size = static_cast<int>(tree.size());
+    int index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.get<double>(index));
+        index = index + 1 < size ? index + 1 : 0;
+    }
+}
+
+BENCHMARK(IndexReads)->ArgName("frozen")->Arg(0)->Arg(1);
+
+// A conf.d directory of 200 JSON fragments, each with its own sections of 1k keys,
+// loaded on one thread or on one per core.
+static void LoadDirectory(benchmark::State& state)
+{
+    const auto directory = std::filesystem::temp_directory_path() / "confetti_bench.d";
+    std::filesystem::create_directories(directory);
+    for (int i = 0; i < 200; ++i) {
+        const auto file = directory / ("fragment_" + std::to_string(i) + ".json");
+        if (std::filesystem::exists(file))
+            continue;
+        std::ofstream stream{file};
+        stream << "{\"fragment_" << i << "\": {";
+        for (int key = 0; key < 1000; ++key)
+            stream << (key ? ", " : "") << "\"key_" << key << "\": " << key;
+        stream << "}}\n";
+    }
+    confetti::ConfigLoadOptions options;
+    options.loadThreads = static_cast<unsigned>(state.range(0));
+    for (auto _ : state) {
+        auto tree = confetti::ConfigTree::loadDirectory(directory, options);
+        benchmark::DoNotOptimize(tree["fragment_199"].get<int>("key_999"));
+    }
+}
+
+BENCHMARK(LoadDirectory)->ArgName("threads")->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond);
+
+// A value set by the second of four layers: looked up in each layer from the top until
+// found, or read from the overlay flattened once.
+static void LayeredReads(benchmark::State& state)
+{
+    std::vector<confetti::OverlayConfig::Layer> layers;
+    for (int i = 0; i < 4; ++i) {
+        confetti::internal::SnapshotBuilder builder;
+        builder.beginTable();
+        builder.setKey("server");
+        builder.beginTable();
+        builder.setKey("option_" + std::to_string(i));
+        builder.addInteger(i);
+        if (i == 1) {
+            builder.setKey("port");
+            builder.addInteger(8080);
+        }
+        builder.endTable();
+        builder.endTable();
+        layers.push_back({"layer_" + std::to_string(i),
+            confetti::ConfigTree{builder.finish()->getRootSource()}});
+    }
+    const confetti::ConfigPath path{"server.port"};
+    if (state.range(0) != 0) {
+        const auto tree = confetti::OverlayConfig{layers}.getTree();
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(tree.get<int>(path));
+        }
+    } else {
+        for (auto _ : state) {
+            std::optional<int> port;
+            for (auto it = layers.rbegin(); !port && it != layers.rend(); ++it)
+                port = it->tree.tryGet<int>(path);
+            benchmark::DoNotOptimize(port);
+        }
+    }
+}
+
+BENCHMARK(LayeredReads)->ArgName("overlay")->Arg(0)->Arg(1);
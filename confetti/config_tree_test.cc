@@ -16,6 +16,8 @@
 
 #include "config_tree.hh"
 #include <gmock/gmock.h>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 
 namespace {
@@ -23,6 +25,11 @@ namespace {
 struct EmptySource final : confetti::ConfigSource {
     ~EmptySource() override = default;
 
+    using ConfigSource::tryGetBoolean;
+    using ConfigSource::tryGetChild;
+    using ConfigSource::tryGetDouble;
+    using ConfigSource::tryGetString;
+
     [[nodiscard]] bool hasValueAt(int) const override { return false; }
 
     [[nodiscard]] confetti::ConfigSourcePointer tryGetChild(int) const override { return {}; }
@@ -53,6 +60,11 @@ struct EmptySource final : confetti::ConfigSource {
 struct FullSource final : confetti::ConfigSource {
     ~FullSource() override = default;
 
+    using ConfigSource::tryGetBoolean;
+    using ConfigSource::tryGetChild;
+    using ConfigSource::tryGetDouble;
+    using ConfigSource::tryGetString;
+
     [[nodiscard]] bool hasValueAt(int) const override { return false; }
 
     [[nodiscard]] confetti::ConfigSourcePointer tryGetChild(int) const override
@@ -374,6 +386,32 @@ static void checkIniFileConfig(const confetti::ConfigTree& cfg)
 
     EXPECT_EQ("index.html", cfg.get<std::string>("web.file"_cp));
     EXPECT_EQ("index.html", cfg["web"].get<std::string>("file"));
+
+    EXPECT_EQ("World", cfg.getStringView("Hello"));
+    EXPECT_EQ("User Name", cfg.getStringView("user.name"_cp));
+    EXPECT_EQ("127.0.0.1", cfg.get<std::string_view>(confetti::ConfigPath{"web.server"}));
+    EXPECT_EQ("80", cfg["web"].getStringView("port"));
+    EXPECT_FALSE(cfg.tryGetStringView("this_key_should_not_exist"));
+
+    std::vector<std::pair<std::string, std::string>> web;
+    for (const auto& item : cfg["web"].items()) {
+        EXPECT_FALSE(item.getChild());
+        web.emplace_back(item.getKey(), item.get<std::string>());
+    }
+    EXPECT_THAT(web,
+        testing::UnorderedElementsAre(testing::Pair("server", "127.0.0.1"),
+            testing::Pair("port", "80"), testing::Pair("file", "index.html")));
+
+    std::vector<std::string> sections;
+    for (const auto& item : cfg.items()) {
+        if (auto child = item.getChild()) {
+            sections.emplace_back(item.getKey());
+        } else {
+            EXPECT_EQ("Hello", item.getKey());
+            EXPECT_EQ("World", item.get<std::string_view>());
+        }
+    }
+    EXPECT_THAT(sections, testing::UnorderedElementsAre("user", "web"));
 }
 
 TEST(ConfigTree, LuaLoadIniFile) { checkIniFileConfig(loadLuaFile()["ini"]); }
@@ -384,6 +422,73 @@ TEST(ConfigTree, LoadIniFile) { checkIniFileConfig(loadIniFile()); }
 
 TEST(ConfigTree, LoadJsonFile) { checkIniFileConfig(loadJsonFile()); }
 
+TEST(ConfigTree, StreamJson)
+{
+    std::istringstream stream{R"({"server": {"host": "a", "port": 80}})"};
+    const auto tree = confetti::ConfigTree::loadJson(stream);
+    EXPECT_TRUE(tree.isThreadSafe());
+    EXPECT_EQ(80, tree.get<int>(confetti::ConfigPath{"server.port"}));
+
+    const auto file = std::filesystem::path{testing::TempDir()} / "confetti-stream.json";
+    std::ofstream{file} << R"([{"host": "a", "port": 80}, {"host": "b"}, {"port": 8080}])";
+    std::vector<std::string> hosts;
+    int ports = 0;
+    confetti::ConfigTree::streamJsonFile(file, [&](const confetti::ConfigTree& server) {
+        EXPECT_TRUE(server.isThreadSafe());
+        hosts.push_back(server.get<std::string>("host", "-"));
+        ports += server.get<int>("port", 0U);
+    });
+    EXPECT_THAT(hosts, testing::ElementsAre("a", "b", "-"));
+    EXPECT_EQ(8160, ports);
+    EXPECT_THROW(confetti::ConfigTree::streamJsonFile(file.string() + ".missing", [](auto&) {}),
+        std::system_error);
+}
+
+TEST(ConfigTree, LoadDirectory)
+{
+    const auto directory = std::filesystem::path{testing::TempDir()} / "confetti-conf.d";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "20-ignored.json");
+    std::ofstream{directory / "10-base.json"}
+        << R"({"server": {"host": "a", "port": 80, "tls": {"enabled": false}}, "list": [1, 2, 3],
+              "name": "base", "workers": 4})";
+    std::ofstream{directory / "20-override.json"}
+        << R"({"server": {"port": 8080, "tls": {"cert": "x"}}, "list": [4],
+              "name": {"first": "x"}})";
+    std::ofstream{directory / "30-host.ini"} << "[server]\nhost = b\n";
+    std::ofstream{directory / "README"} << "Not a configuration";
+
+    for (unsigned threads : {0U, 1U}) {
+        confetti::ConfigLoadOptions options;
+        options.loadThreads = threads;
+        const auto tree = confetti::ConfigTree::loadDirectory(directory, options);
+        EXPECT_TRUE(tree.isThreadSafe());
+        EXPECT_EQ("b", tree.get<std::string>(confetti::ConfigPath{"server.host"}));
+        EXPECT_EQ(8080, tree.get<int>(confetti::ConfigPath{"server.port"}));
+        EXPECT_FALSE(tree.get<bool>(confetti::ConfigPath{"server.tls.enabled"}));
+        EXPECT_EQ("x", tree.get<std::string>(confetti::ConfigPath{"server.tls.cert"}));
+        EXPECT_THAT(tree["list"].toVector<int>(), testing::ElementsAre(4));
+        EXPECT_EQ("x", tree["name"].get<std::string>("first"));
+        EXPECT_EQ(4, tree.get<int>("workers"));
+    }
+
+    // Files in the order given.
+    const std::filesystem::path files[]
+        = {directory / "20-override.json", directory / "10-base.json"};
+    const auto tree = confetti::ConfigTree::loadFiles(files);
+    EXPECT_EQ(80, tree.get<int>(confetti::ConfigPath{"server.port"}));
+    EXPECT_EQ("base", tree.get<std::string>("name"));
+    EXPECT_THAT(tree["list"].toVector<int>(), testing::ElementsAre(1, 2, 3));
+    EXPECT_EQ("x", tree.get<std::string>(confetti::ConfigPath{"server.tls.cert"}));
+
+    const std::filesystem::path missing[]
+        = {directory / "10-base.json", directory / "missing.json"};
+    EXPECT_THROW((void)confetti::ConfigTree::loadFiles(missing), std::runtime_error);
+    EXPECT_FALSE(confetti::ConfigTree::loadFiles({}).tryGetChild("server"));
+
+    std::filesystem::remove_all(directory);
+}
+
 TEST(ConfigTree, SimpleLuaSequenceValue)
 {
     static constexpr std::string_view code = R"(
@@ -414,6 +519,16 @@ TEST(ConfigTree, KeyNotFoundErrorMessageIniSimple)
     }
 }
 
+TEST(ConfigTree, KeyNotFoundErrorMessageOtherSection)
+{
+    try {
+        (void)loadIniFile().get<int>("prot");
+        ADD_FAILURE() << "Key should not have been found.";
+    } catch (const std::exception& e) {
+        EXPECT_STREQ("Cannot find configuration entry 'prot'. Did you mean 'web.port'?", e.what());
+    }
+}
+
 TEST(ConfigTree, KeyNotFoundErrorMessageLuaSimple)
 {
     try {
@@ -438,3 +553,165 @@ TEST(ConfigTree, KeyNotFoundInSubtreeErrorMessage)
             e.what());
     }
 }
+
+TEST(ConfigTree, FreezeEmptyTree) { EXPECT_FALSE(confetti::ConfigTree{}.freeze()); }
+
+TEST(ConfigTree, FreezeLuaFile)
+{
+    auto cfg = loadLuaFile().freeze();
+    ASSERT_TRUE(cfg);
+
+    checkIniFileConfig(cfg["ini"]);
+    checkIniFileConfig(cfg["json"]);
+
+    EXPECT_EQ("NJ", cfg.get<std::string>("a.b.c.state"));
+    EXPECT_EQ("CT", cfg.get<std::string>(confetti::ConfigPath{"a.b/c\\state"}));
+    EXPECT_EQ(2021, cfg.get<int>(confetti::ConfigPath{"a/b\\c.year"}));
+
+    std::vector<std::string> strings = cfg["string_list"].values<std::string>();
+    EXPECT_THAT(strings, testing::ElementsAre("Moscow", "never", "sleeps"));
+
+    std::vector<int> numbers = cfg["number_list"].values<int>();
+    EXPECT_THAT(numbers, testing::ElementsAre(1962, 1968, 1986, 2021));
+
+    size_t total_entries = 0;
+    for (auto entry : cfg["string_matrix_array"].children()) {
+        for (auto child : entry.children()) {
+            std::vector<std::string> array = child.values<std::string>();
+            EXPECT_EQ(total_entries % 2 ? 4 : 3, array.size());
+            ++total_entries;
+        }
+    }
+    EXPECT_EQ(4, total_entries);
+}
+
+TEST(ConfigTree, FreezeIsIdempotent)
+{
+    auto frozen = loadIniFile().freeze();
+    EXPECT_TRUE((frozen <=> frozen.freeze()) == 0);
+    checkIniFileConfig(frozen.freeze());
+}
+
+TEST(ConfigTree, FreezeEvaluatesFunctionsOnce)
+{
+    static constexpr std::string_view code = R"(
+local n = 0
+confetti.sequence = function()
+    n = n + 1
+    return n
+end
+confetti.section = function()
+    return { value = 42 }
+end
+)";
+    auto tree = confetti::ConfigTree::loadLuaCode(code).freeze();
+    for (int i = 1; i <= 10; ++i) {
+        ASSERT_EQ(1, tree.get<int>("sequence"));
+    }
+    EXPECT_EQ(42, tree["section"].get<int>("value"));
+}
+
+TEST(ConfigTree, FreezeCyclicTable)
+{
+    auto tree = confetti::ConfigTree::loadLuaCode("confetti.self = confetti");
+    EXPECT_THROW((void)tree.freeze(), std::runtime_error);
+}
+
+TEST(ConfigTree, CompiledPathWithoutValues)
+{
+    const confetti::CompiledConfigPath path{"a.b/c"};
+    EXPECT_EQ("a.b/c", path.getPathString());
+    for (auto cfg : {confetti::ConfigTree{}, confetti::ConfigTree{std::make_shared<EmptySource>()}}) {
+        EXPECT_FALSE(cfg.tryGetChild(path));
+        EXPECT_FALSE(cfg.tryGetString(path));
+        EXPECT_FALSE(cfg.tryGet<int>(path));
+        EXPECT_ANY_THROW((void)cfg.getChild(path));
+        EXPECT_ANY_THROW((void)cfg.get<int>(path));
+        EXPECT_EQ(1945, cfg.get(path, 1945));
+
+        const auto bound = path.bind(cfg);
+        EXPECT_EQ("c", bound.getKey());
+        EXPECT_FALSE(bound.tryGet<std::string>());
+        EXPECT_FALSE(bound.tryGetChild());
+        EXPECT_ANY_THROW((void)bound.get<std::string>());
+        EXPECT_EQ("lol", bound.get<std::string>("lol"));
+    }
+}
+
+TEST(ConfigTree, CompiledPathFullSource)
+{
+    confetti::ConfigTree cfg{std::make_shared<FullSource>()};
+    const confetti::CompiledConfigPath path{confetti::ConfigPath{"a/b\\c.d"}};
+    EXPECT_TRUE(cfg.tryGetChild(path));
+    EXPECT_EQ("Hello!", cfg.getString(path));
+    EXPECT_DOUBLE_EQ(19.86, cfg.get<double>(path));
+    double value = cfg.get(path);
+    EXPECT_DOUBLE_EQ(19.86, value);
+
+    const auto bound = path.bind(cfg);
+    EXPECT_TRUE(bound.getNode());
+    EXPECT_EQ("d", bound.getKey());
+    EXPECT_EQ("Hello!", bound.get<std::string>());
+    EXPECT_TRUE(bound.getChild());
+}
+
+TEST(ConfigTree, CompiledPathSeparators)
+{
+    std::istringstream stream{R"({"a": {"b": 42, "c.d": 7}})"};
+    const auto cfg = confetti::ConfigTree::loadJson(stream);
+    const confetti::ConfigPath path{"a:b", ":"};
+    EXPECT_EQ(":", path.getSeparators());
+    EXPECT_EQ(42, cfg.get(path, -1));
+    EXPECT_EQ(42, cfg.get(confetti::CompiledConfigPath{path}, -1));
+    EXPECT_EQ(7, cfg.get(confetti::CompiledConfigPath{confetti::ConfigPath{"a:c.d", ":"}}, -1));
+}
+
+TEST(ConfigTree, StaticPath)
+{
+    using namespace confetti::literals;
+    using Path = decltype("a/b\\c.d"_cp);
+    static_assert(Path::getPathString() == "a/b\\c.d");
+    static_assert(Path::getKeys().size() == 4);
+    static_assert(Path::getKeys()[2].getName() == "c");
+    static_assert(Path::getKeys()[3].getHash() == confetti::internal::hash("d"));
+    constexpr auto separators = confetti::ConfigPath::getDefaultSeparators();
+    static_assert(!confetti::internal::isValidPath("", separators));
+    static_assert(!confetti::internal::isValidPath("a..b", separators));
+    static_assert(!confetti::internal::isValidPath(".a", separators));
+    static_assert(!confetti::internal::isValidPath("a/", separators));
+
+    confetti::ConfigTree cfg{std::make_shared<FullSource>()};
+    EXPECT_TRUE(cfg.tryGetChild("a/b\\c.d"_cp));
+    EXPECT_EQ("Hello!", cfg.getString("a/b\\c.d"_cp));
+    EXPECT_EQ("Hello!", cfg.tryGetString("a.b"_cp).value());
+    EXPECT_DOUBLE_EQ(19.86, cfg.get<double>("a.b"_cp));
+    EXPECT_EQ(20, cfg.get<int>("a.b"_cp));
+    double value = cfg.get("a.b"_cp);
+    EXPECT_DOUBLE_EQ(19.86, value);
+
+    for (auto empty :
+        {confetti::ConfigTree{}, confetti::ConfigTree{std::make_shared<EmptySource>()}}) {
+        EXPECT_FALSE(empty.tryGetChild("a.b"_cp));
+        EXPECT_FALSE(empty.tryGetBoolean("a.b"_cp));
+        EXPECT_EQ(1945, empty.get("a.b"_cp, 1945));
+        EXPECT_ANY_THROW((void)empty.getChild("a.b"_cp));
+        EXPECT_ANY_THROW((void)empty.get<int>("a.b"_cp));
+    }
+}
+
+TEST(ConfigTree, CompiledPathLuaFile)
+{
+    auto cfg = loadLuaFile();
+
+    const confetti::CompiledConfigPath year{"a/b\\c.year"};
+    EXPECT_EQ(2021, cfg.get<int>(year));
+    EXPECT_TRUE(cfg.tryGetChild(confetti::CompiledConfigPath{"a.b"}));
+    EXPECT_FALSE(cfg.tryGetChild(confetti::CompiledConfigPath{"a.b.c.this_node_should_not_exist"}));
+
+    for (auto tree : {cfg, cfg.freeze()}) {
+        const auto bound = confetti::CompiledConfigPath{"a.b.c.state"}.bind(tree);
+        for (int i = 0; i < 3; ++i) {
+            EXPECT_EQ("CT", bound.get<std::string>());
+        }
+    }
+}
@@ -0,0 +1,139 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "convert.hh"
+#include "string.hh"
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace confetti::internal {
+
+bool parseBoolean(const char* data, size_t size)
+{
+    std::string_view value{data, size};
+    if (strCaseIsAnyOf(value, "y", "yes", "true", "1"))
+        return true;
+    if (strCaseIsAnyOf(value, "n", "no", "false", "0"))
+        return false;
+    errno = 0;
+    char* end_ptr{};
+    const auto n = std::strtod(data, &end_ptr);
+    return (end_ptr && *end_ptr == '\0' && errno == 0) && static_cast<bool>(n);
+}
+
+double parseDouble(const char* data, size_t size)
+{
+    char* end_ptr{};
+    errno = 0;
+    auto value = std::strtod(data, &end_ptr);
+    const auto ec = errno;
+    if (end_ptr == nullptr || *end_ptr != '\0' || ec != 0) {
+        throw std::runtime_error{std::string{"Cannot convert string '"}
+                                     .append(data, size)
+                                     .append("' to double: ")
+                                     .append(std::strerror(ec))};
+    }
+    return value;
+}
+
+template <typename F>
+static decltype(auto) withTerminator(std::string_view value, const F& parse)
+{
+    char buffer[64];
+    if (value.size() < sizeof(buffer)) {
+        std::memcpy(buffer, value.data(), value.size());
+        buffer[value.size()] = '\0';
+        return parse(buffer, value.size());
+    }
+    const std::string copy{value};
+    return parse(copy.c_str(), copy.size());
+}
+
+bool parseBoolean(std::string_view value)
+{
+    return withTerminator(
+        value, [](const char* data, size_t size) { return parseBoolean(data, size); });
+}
+
+double parseDouble(std::string_view value)
+{
+    return withTerminator(
+        value, [](const char* data, size_t size) { return parseDouble(data, size); });
+}
+
+int64_t roundToInteger(double value)
+{
+    // Both bounds are exact powers of two, so the comparisons are exact as well.
+    const auto rounded = std::round(value);
+    if (!(rounded >= -0x1p63 && rounded < 0x1p63))
+        throw std::range_error{"Number " + formatNumber(value) + " does not fit into 64 bits"};
+    return static_cast<int64_t>(rounded);
+}
+
+uint64_t roundToUnsignedInteger(double value)
+{
+    const auto rounded = std::round(value);
+    if (rounded >= 0x1p63 && rounded < 0x1p64)
+        return static_cast<uint64_t>(rounded);
+    return static_cast<uint64_t>(roundToInteger(value));
+}
+
+template <typename T>
+static bool parseExact(std::string_view value, T& result)
+{
+    const auto end = value.data() + value.size();
+    const auto [ptr, ec] = std::from_chars(value.data(), end, result);
+    return ec == std::errc{} && ptr == end;
+}
+
+int64_t parseInteger(std::string_view value)
+{
+    int64_t result{};
+    if (parseExact(value, result))
+        return result;
+    return roundToInteger(parseDouble(value));
+}
+
+uint64_t parseUnsignedInteger(std::string_view value)
+{
+    uint64_t result{};
+    if (parseExact(value, result))
+        return result;
+    int64_t negative{};
+    if (parseExact(value, negative))
+        return static_cast<uint64_t>(negative);
+    return roundToUnsignedInteger(parseDouble(value));
+}
+
+std::string formatNumber(int64_t value) { return std::to_string(value); }
+
+std::string formatNumber(double value)
+{
+    // Same as Lua's tostring(): "%.14g" and a trailing ".0" for integral values.
+    char buffer[64];
+    const auto size = std::snprintf(buffer, sizeof(buffer), "%.14g", value);
+    std::string result{buffer, static_cast<size_t>(size)};
+    if (result.find_first_of(".eEin") == std::string::npos)
+        result.append(".0");
+    return result;
+}
+
+} // namespace confetti::internal
@@ -0,0 +1,56 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_CONVERT_HH
+#define CONFETTI_INTERNAL_CONVERT_HH
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace confetti::internal {
+
+// Both parsers expect a NUL-terminated string of the given size.
+
+[[nodiscard]] bool parseBoolean(const char* data, size_t size);
+
+[[nodiscard]] double parseDouble(const char* data, size_t size);
+
+// Same as above for strings that are not NUL-terminated.
+
+[[nodiscard]] bool parseBoolean(std::string_view value);
+
+[[nodiscard]] double parseDouble(std::string_view value);
+
+// Exact for integers, rounds anything else that parseDouble() accepts.
+[[nodiscard]] int64_t parseInteger(std::string_view value);
+
+// Same as above, but also exact above INT64_MAX. Negative values wrap around.
+[[nodiscard]] uint64_t parseUnsignedInteger(std::string_view value);
+
+// Rounds to the nearest integer, throws std::range_error if it does not fit.
+[[nodiscard]] int64_t roundToInteger(double value);
+
+// Same as above, but up to UINT64_MAX. Negative values wrap around.
+[[nodiscard]] uint64_t roundToUnsignedInteger(double value);
+
+[[nodiscard]] std::string formatNumber(int64_t value);
+
+[[nodiscard]] std::string formatNumber(double value);
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_CONVERT_HH
@@ -0,0 +1,41 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_HASH_HH
+#define CONFETTI_INTERNAL_HASH_HH
+
+#include <cstdint>
+#include <string_view>
+
+namespace confetti::internal {
+
+inline constexpr uint64_t hashSeed = 14695981039346656037ULL;
+
+/// 64-bit FNV-1a, usable in constant expressions. Passing the hash of a prefix as the
+/// seed continues it, so that hash(b, hash(a)) == hash(a + b).
+[[nodiscard]] constexpr uint64_t hash(std::string_view data, uint64_t seed = hashSeed) noexcept
+{
+    uint64_t result = seed;
+    for (auto c : data) {
+        result ^= static_cast<unsigned char>(c);
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_HASH_HH
@@ -0,0 +1,416 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ini.hh"
+#include "convert.hh"
+#include "hash.hh"
+#include "snapshot.hh"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+namespace confetti::internal {
+
+static constexpr std::string_view whitespace = " \t\r\f\v";
+
+static std::string_view trim(std::string_view str) noexcept
+{
+    const auto begin = str.find_first_not_of(whitespace);
+    if (begin == std::string_view::npos)
+        return {};
+    return str.substr(begin, str.find_last_not_of(whitespace) - begin + 1);
+}
+
+static bool isComment(std::string_view str) noexcept
+{
+    return !str.empty() && (str.front() == ';' || str.front() == '#');
+}
+
+IniSource::IniSource(const IniDocument& document) noexcept
+    : document_{&document}
+{
+}
+
+IniSource::~IniSource() = default;
+
+void IniSource::add(std::string_view key, std::string_view value, const IniSource* section)
+{
+    entries_.push_back({hash(key), key, value, section});
+}
+
+void IniSource::sort()
+{
+    // Sort by hash for lookups and drop duplicates, the last one wins. A section
+    // and a value may share a name.
+    const auto order = [](const Entry& entry) noexcept {
+        return std::tuple{entry.hash, entry.key, entry.section != nullptr};
+    };
+    std::stable_sort(entries_.begin(), entries_.end(),
+        [&](const Entry& lhs, const Entry& rhs) noexcept { return order(lhs) < order(rhs); });
+    auto last = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (std::next(it) == entries_.end() || order(*it) != order(*std::next(it)))
+            *last++ = *it;
+    }
+    entries_.erase(last, entries_.end());
+}
+
+const IniSource::Entry* IniSource::findValue(const ConfigKey& key) const noexcept
+{
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), key.getHash(),
+        [](const Entry& entry, uint64_t value) noexcept { return entry.hash < value; });
+    for (; it != entries_.end() && it->hash == key.getHash(); ++it) {
+        if (!it->section && it->key == key.getName())
+            return &*it;
+    }
+    return nullptr;
+}
+
+const IniSource::Entry* IniSource::findSection(const ConfigKey& key) const noexcept
+{
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), key.getHash(),
+        [](const Entry& entry, uint64_t value) noexcept { return entry.hash < value; });
+    for (; it != entries_.end() && it->hash == key.getHash(); ++it) {
+        if (it->section && it->key == key.getName())
+            return &*it;
+    }
+    return nullptr;
+}
+
+bool IniSource::hasValueAt(int) const { return false; }
+
+ConfigSourcePointer IniSource::tryGetChild(int) const { return {}; }
+
+ConfigSourcePointer IniSource::tryGetChild(std::string_view name) const
+{
+    return tryGetChild(ConfigKey{name});
+}
+
+ConfigSourcePointer IniSource::tryGetChild(const ConfigKey& key) const
+{
+    auto entry = findSection(key);
+    return entry ? document_->getSource(*entry->section) : ConfigSourcePointer{};
+}
+
+std::optional<bool> IniSource::tryGetBoolean(int) const { return {}; }
+
+std::optional<bool> IniSource::tryGetBoolean(std::string_view name) const
+{
+    return tryGetBoolean(ConfigKey{name});
+}
+
+std::optional<bool> IniSource::tryGetBoolean(const ConfigKey& key) const
+{
+    std::optional<bool> result;
+    if (auto entry = findValue(key))
+        result.emplace(parseBoolean(entry->value));
+    return result;
+}
+
+std::optional<double> IniSource::tryGetDouble(int) const { return {}; }
+
+std::optional<double> IniSource::tryGetDouble(std::string_view name) const
+{
+    return tryGetDouble(ConfigKey{name});
+}
+
+std::optional<double> IniSource::tryGetDouble(const ConfigKey& key) const
+{
+    std::optional<double> result;
+    if (auto entry = findValue(key))
+        result.emplace(parseDouble(entry->value));
+    return result;
+}
+
+std::optional<int64_t> IniSource::tryGetNumber(int) const { return {}; }
+
+std::optional<int64_t> IniSource::tryGetNumber(std::string_view name) const
+{
+    return tryGetNumber(ConfigKey{name});
+}
+
+std::optional<int64_t> IniSource::tryGetNumber(const ConfigKey& key) const
+{
+    std::optional<int64_t> result;
+    if (auto entry = findValue(key))
+        result.emplace(parseInteger(entry->value));
+    return result;
+}
+
+std::optional<uint64_t> IniSource::tryGetUnsignedNumber(int) const { return {}; }
+
+std::optional<uint64_t> IniSource::tryGetUnsignedNumber(std::string_view name) const
+{
+    return tryGetUnsignedNumber(ConfigKey{name});
+}
+
+std::optional<uint64_t> IniSource::tryGetUnsignedNumber(const ConfigKey& key) const
+{
+    std::optional<uint64_t> result;
+    if (auto entry = findValue(key))
+        result.emplace(parseUnsignedInteger(entry->value));
+    return result;
+}
+
+std::optional<std::string> IniSource::tryGetString(int) const { return {}; }
+
+std::optional<std::string> IniSource::tryGetString(std::string_view name) const
+{
+    return tryGetString(ConfigKey{name});
+}
+
+std::optional<std::string> IniSource::tryGetString(const ConfigKey& key) const
+{
+    std::optional<std::string> result;
+    if (auto entry = findValue(key))
+        result.emplace(entry->value);
+    return result;
+}
+
+std::optional<std::string_view> IniSource::tryGetStringView(int) const { return {}; }
+
+std::optional<std::string_view> IniSource::tryGetStringView(std::string_view name) const
+{
+    return tryGetStringView(ConfigKey{name});
+}
+
+std::optional<std::string_view> IniSource::tryGetStringView(const ConfigKey& key) const
+{
+    std::optional<std::string_view> result;
+    if (auto entry = findValue(key))
+        result.emplace(entry->value);
+    return result;
+}
+
+std::vector<std::string> IniSource::getKeyList() const
+{
+    std::vector<std::string> keys;
+    keys.reserve(entries_.size());
+    for (const auto& entry : entries_)
+        keys.emplace_back(entry.key);
+    return keys;
+}
+
+class IniSource::ItemCursor final : public ConfigItemCursor {
+public:
+    explicit ItemCursor(const IniSource& source) noexcept
+        : source_{source}
+        , entry_{nullptr}
+    {
+    }
+
+    bool next() override
+    {
+        entry_ = entry_ ? entry_ + 1 : source_.entries_.data();
+        return entry_ != source_.entries_.data() + source_.entries_.size();
+    }
+
+    std::string_view getKey() const override { return entry_->key; }
+
+    ConfigSourcePointer getChild() const override
+    {
+        return entry_->section ? source_.document_->getSource(*entry_->section)
+                               : ConfigSourcePointer{};
+    }
+
+    bool isTable() const override { return entry_->section != nullptr; }
+
+    std::optional<bool> getBoolean() const override { return convert<bool>(&parseBoolean); }
+
+    std::optional<double> getDouble() const override { return convert<double>(&parseDouble); }
+
+    std::optional<int64_t> getNumber() const override { return convert<int64_t>(&parseInteger); }
+
+    std::optional<uint64_t> getUnsignedNumber() const override
+    {
+        return convert<uint64_t>(&parseUnsignedInteger);
+    }
+
+    std::optional<std::string> getString() const override
+    {
+        std::optional<std::string> result;
+        if (!entry_->section)
+            result.emplace(entry_->value);
+        return result;
+    }
+
+    std::optional<std::string_view> getStringView() const override
+    {
+        std::optional<std::string_view> result;
+        if (!entry_->section)
+            result.emplace(entry_->value);
+        return result;
+    }
+
+private:
+    template <typename T>
+    std::optional<T> convert(T (*parse)(std::string_view)) const
+    {
+        std::optional<T> result;
+        if (!entry_->section)
+            result.emplace(parse(entry_->value));
+        return result;
+    }
+
+    const IniSource& source_;
+    const Entry* entry_;
+};
+
+std::unique_ptr<ConfigItemCursor> IniSource::getItems() const
+{
+    return std::make_unique<ItemCursor>(*this);
+}
+
+// A mapped file may be rewritten in place while readers still hold a frozen
+// tree, so its text is copied out. A section wins over a value of the same name.
+ConfigSourcePointer IniSource::freeze() const
+{
+    if (!document_->isMapped())
+        return {};
+    SnapshotBuilder builder;
+    freezeSection(builder);
+    return builder.finish()->getRootSource();
+}
+
+void IniSource::freezeSection(SnapshotBuilder& builder) const
+{
+    builder.beginTable();
+    for (const auto& entry : entries_) {
+        builder.setKey(entry.key);
+        if (entry.section)
+            entry.section->freezeSection(builder);
+        else
+            builder.addString(entry.value);
+    }
+    builder.endTable();
+}
+
+bool IniSource::isThreadSafe() const noexcept { return true; }
+
+IniDocument::IniDocument(SharedConstructTag, std::string text, std::unique_ptr<MappedFile> mapping)
+    : text_{std::move(text)}
+    , mapping_{std::move(mapping)}
+{
+}
+
+IniDocument::~IniDocument() = default;
+
+ConfigSourcePointer IniDocument::load(
+    std::string text, std::unique_ptr<MappedFile> mapping, std::string_view name)
+{
+    auto document
+        = std::make_shared<IniDocument>(SharedConstructTag{}, std::move(text), std::move(mapping));
+    document->parseText(name);
+    return document->getSource(document->sources_.front());
+}
+
+ConfigSourcePointer IniDocument::parse(std::string text, std::string_view name)
+{
+    return load(std::move(text), nullptr, name);
+}
+
+ConfigSourcePointer IniDocument::loadFile(const std::filesystem::path& file)
+{
+    return load({}, std::make_unique<MappedFile>(file), file.native());
+}
+
+ConfigSourcePointer IniDocument::getSource(const IniSource& source) const
+{
+    return {shared_from_this(), const_cast<IniSource*>(&source)};
+}
+
+// Values are trimmed and may be quoted. Comments start with ';' or '#', either
+// on a line of their own or after whitespace that follows an unquoted value.
+void IniDocument::parseText(std::string_view name)
+{
+    auto text = mapping_ ? mapping_->getData() : std::string_view{text_};
+    if (text.substr(0, 3) == "\xEF\xBB\xBF")
+        text.remove_prefix(3);
+
+    size_t line = 0;
+    const auto fail = [&](std::string_view message) {
+        throw std::runtime_error{std::string{name}
+                                     .append(":")
+                                     .append(std::to_string(line))
+                                     .append(": ")
+                                     .append(message)};
+    };
+
+    auto& root = sources_.emplace_back(*this);
+    auto current = &root;
+    std::unordered_map<std::string_view, IniSource*> sections;
+    while (!text.empty()) {
+        ++line;
+        const auto end = text.find('\n');
+        const auto str = trim(text.substr(0, end));
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+        if (str.empty() || isComment(str))
+            continue;
+
+        if (str.front() == '[') {
+            const auto close = str.find(']');
+            if (close == std::string_view::npos)
+                fail("expected ']'");
+            const auto rest = trim(str.substr(close + 1));
+            if (!rest.empty() && !isComment(rest))
+                fail("unexpected data after section name");
+            const auto section = trim(str.substr(1, close - 1));
+            if (section.empty())
+                fail("empty section name");
+            auto& source = sections[section];
+            if (!source) {
+                source = &sources_.emplace_back(*this);
+                root.add(section, {}, source);
+            }
+            current = source;
+            continue;
+        }
+
+        const auto equals = str.find('=');
+        if (equals == std::string_view::npos)
+            fail("expected '='");
+        const auto key = trim(str.substr(0, equals));
+        if (key.empty())
+            fail("empty key");
+
+        auto value = trim(str.substr(equals + 1));
+        if (!value.empty() && (value.front() == '"' || value.front() == '\'')) {
+            const auto close = value.find(value.front(), 1);
+            if (close == std::string_view::npos)
+                fail("unterminated quoted value");
+            const auto rest = trim(value.substr(close + 1));
+            if (!rest.empty() && !isComment(rest))
+                fail("unexpected data after quoted value");
+            value = value.substr(1, close - 1);
+        } else {
+            for (size_t i = 1; i < value.size(); ++i) {
+                if ((value[i] == ';' || value[i] == '#')
+                    && whitespace.find(value[i - 1]) != std::string_view::npos) {
+                    value = trim(value.substr(0, i));
+                    break;
+                }
+            }
+        }
+        current->add(key, value, nullptr);
+    }
+
+    for (auto& source : sources_)
+        source.sort();
+}
+
+} // namespace confetti::internal
@@ -0,0 +1,161 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_INI_HH
+#define CONFETTI_INTERNAL_INI_HH
+
+#include "../config_source.hh"
+#include "mapped_file.hh"
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace confetti::internal {
+
+class IniDocument;
+class SnapshotBuilder;
+
+// The top level of an INI file, or one of its sections. Keys and values point
+// straight into the document text.
+class IniSource final : public ConfigSource {
+public:
+    explicit IniSource(const IniDocument& document) noexcept;
+
+    ~IniSource() override;
+
+    IniSource(const IniSource&) = delete;
+    IniSource& operator=(const IniSource&) = delete;
+
+    [[nodiscard]] bool hasValueAt(int index) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(int index) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(std::string_view name) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(int index) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(int index) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(int index) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(int index) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(
+        std::string_view name) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(
+        const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(int index) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(int index) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(
+        std::string_view name) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(
+        const ConfigKey& key) const override;
+
+    [[nodiscard]] std::vector<std::string> getKeyList() const override;
+
+    [[nodiscard]] std::unique_ptr<ConfigItemCursor> getItems() const override;
+
+    [[nodiscard]] ConfigSourcePointer freeze() const override;
+
+    [[nodiscard]] bool isThreadSafe() const noexcept override;
+
+private:
+    friend class IniDocument;
+
+    class ItemCursor;
+
+    struct Entry final {
+        uint64_t hash;
+        std::string_view key;
+        std::string_view value;
+        const IniSource* section; // Set for sections, which only the top level has.
+    };
+
+    void add(std::string_view key, std::string_view value, const IniSource* section);
+
+    void sort();
+
+    [[nodiscard]] const Entry* findValue(const ConfigKey& key) const noexcept;
+
+    [[nodiscard]] const Entry* findSection(const ConfigKey& key) const noexcept;
+
+    void freezeSection(SnapshotBuilder& builder) const;
+
+    const IniDocument* document_;
+    std::vector<Entry> entries_;
+};
+
+// Parsed INI file: the text, either mapped or owned, and all its sections.
+class IniDocument final : public std::enable_shared_from_this<IniDocument> {
+    struct SharedConstructTag final {
+    };
+
+public:
+    [[nodiscard]] static ConfigSourcePointer parse(std::string text, std::string_view name = "INI");
+
+    [[nodiscard]] static ConfigSourcePointer loadFile(const std::filesystem::path& file);
+
+    IniDocument(SharedConstructTag, std::string text, std::unique_ptr<MappedFile> mapping);
+
+    IniDocument(const IniDocument&) = delete;
+    IniDocument& operator=(const IniDocument&) = delete;
+
+    ~IniDocument();
+
+    [[nodiscard]] ConfigSourcePointer getSource(const IniSource& source) const;
+
+    [[nodiscard]] bool isMapped() const noexcept { return mapping_ != nullptr; }
+
+private:
+    [[nodiscard]] static ConfigSourcePointer load(
+        std::string text, std::unique_ptr<MappedFile> mapping, std::string_view name);
+
+    void parseText(std::string_view name);
+
+    const std::string text_;
+    const std::unique_ptr<MappedFile> mapping_;
+    std::deque<IniSource> sources_; // The top level comes first.
+};
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_INI_HH
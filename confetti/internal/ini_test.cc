@@ -0,0 +1,119 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ini.hh"
+#include <gmock/gmock.h>
+#include <filesystem>
+#include <fstream>
+
+using confetti::internal::IniDocument;
+
+TEST(Ini, Values)
+{
+    auto source = IniDocument::parse(R"(
+; comment
+# another comment
+top = level
+quoted = "  spaced ; not a comment  "
+single = 'value' ; comment
+inline = some value ; comment
+hash = a#b
+number = 19.86
+yes = true
+empty =
+duplicate = first
+duplicate = last
+
+[section]
+key = value
+[ section ] ; the same one
+other = more
+)");
+
+    EXPECT_EQ("level", source->tryGetString("top").value());
+    EXPECT_EQ("  spaced ; not a comment  ", source->tryGetString("quoted").value());
+    EXPECT_EQ("value", source->tryGetString("single").value());
+    EXPECT_EQ("some value", source->tryGetString("inline").value());
+    EXPECT_EQ("a#b", source->tryGetString("hash").value());
+    EXPECT_DOUBLE_EQ(19.86, source->tryGetDouble("number").value());
+    EXPECT_EQ(20, source->tryGetNumber("number").value());
+    EXPECT_TRUE(source->tryGetBoolean("yes").value());
+    EXPECT_EQ("", source->tryGetString("empty").value());
+    EXPECT_EQ("last", source->tryGetString("duplicate").value());
+    EXPECT_EQ("  spaced ; not a comment  ", source->tryGetStringView("quoted").value());
+    EXPECT_EQ("last", source->tryGetStringView(confetti::ConfigKey{"duplicate"}).value());
+    EXPECT_FALSE(source->tryGetStringView("section"));
+    EXPECT_FALSE(source->tryGetStringView(0));
+    EXPECT_ANY_THROW((void)source->tryGetDouble("top"));
+    EXPECT_FALSE(source->tryGetString("section"));
+    EXPECT_FALSE(source->tryGetString("key"));
+    EXPECT_FALSE(source->tryGetChild("top"));
+    EXPECT_FALSE(source->hasValueAt(0));
+    EXPECT_TRUE(source->isThreadSafe());
+    EXPECT_FALSE(source->freeze());
+    EXPECT_THAT(source->getKeyList(),
+        testing::UnorderedElementsAre("top", "quoted", "single", "inline", "hash", "number", "yes",
+            "empty", "duplicate", "section"));
+
+    auto section = source->tryGetChild("section");
+    ASSERT_TRUE(section);
+    EXPECT_EQ("value", section->tryGetString(confetti::ConfigKey{"key"}).value());
+    EXPECT_EQ("more", section->tryGetString("other").value());
+    EXPECT_THAT(section->getKeyList(), testing::UnorderedElementsAre("key", "other"));
+}
+
+TEST(Ini, SectionAndValueWithSameName)
+{
+    auto source = IniDocument::parse("same = value\n[same]\nkey = 1\n");
+    EXPECT_EQ("value", source->tryGetString("same").value());
+    EXPECT_EQ(1, source->tryGetChild("same")->tryGetNumber("key").value());
+}
+
+TEST(Ini, FreezeCopiesMappedFile)
+{
+    const auto file = std::filesystem::path{testing::TempDir()} / "confetti-freeze.ini";
+    std::ofstream{file} << "top = 1\nsame = value\n[same]\nkey = mapped\n";
+    auto frozen = IniDocument::loadFile(file)->freeze();
+    ASSERT_TRUE(frozen);
+    EXPECT_TRUE(frozen->isThreadSafe());
+
+    // Rewritten in place, as editors and deployment tools do.
+    std::ofstream{file} << "[x]\n";
+    EXPECT_EQ(1, frozen->tryGetNumber("top").value());
+    EXPECT_EQ("mapped", frozen->tryGetChild("same")->tryGetString("key").value());
+    EXPECT_THAT(frozen->getKeyList(), testing::UnorderedElementsAre("top", "same"));
+}
+
+TEST(Ini, Errors)
+{
+    const auto error = [](std::string text) {
+        try {
+            (void)IniDocument::parse(std::move(text), "test.ini");
+        } catch (const std::runtime_error& e) {
+            return std::string{e.what()};
+        }
+        return std::string{};
+    };
+
+    EXPECT_EQ("", error(""));
+    EXPECT_EQ("test.ini:2: expected '='", error("a = 1\nb\n"));
+    EXPECT_EQ("test.ini:1: empty key", error(" = 1"));
+    EXPECT_EQ("test.ini:1: expected ']'", error("[section"));
+    EXPECT_EQ("test.ini:1: empty section name", error("[ ]"));
+    EXPECT_EQ("test.ini:1: unexpected data after section name", error("[a] b"));
+    EXPECT_EQ("test.ini:1: unterminated quoted value", error("a = \"b"));
+    EXPECT_EQ("test.ini:1: unexpected data after quoted value", error("a = \"b\" c"));
+}
@@ -0,0 +1,294 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "instrumented_source.hh"
+#include "hash.hh"
+#include <chrono>
+#include <utility>
+
+namespace confetti::internal {
+
+InstrumentedSource::InstrumentedSource(
+    ConfigSourcePointer source, std::shared_ptr<ConfigAccessLog> log, std::string path)
+    : source_{std::move(source)}
+    , log_{std::move(log)}
+    , path_{std::move(path)}
+    , prefix_{path_.empty() ? std::string{} : path_ + '.'}
+    , pathHash_{hash(path_)}
+    , prefixHash_{hash(prefix_)}
+{
+}
+
+InstrumentedSource::~InstrumentedSource() = default;
+
+template <typename F>
+auto InstrumentedSource::read(std::string_view name, const F& get) const
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto result = get();
+    log_->record(hash(name, prefixHash_), prefix_, name, static_cast<bool>(result),
+        std::chrono::steady_clock::now() - start);
+    return result;
+}
+
+template <typename F>
+auto InstrumentedSource::readElement(const F& get) const
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto result = get();
+    log_->record(hash("[]", pathHash_), path_, "[]", static_cast<bool>(result),
+        std::chrono::steady_clock::now() - start);
+    return result;
+}
+
+class InstrumentedSource::ItemCursor final : public ConfigItemCursor {
+public:
+    ItemCursor(const InstrumentedSource& source, std::unique_ptr<ConfigItemCursor> cursor)
+        : source_{source}
+        , cursor_{std::move(cursor)}
+    {
+    }
+
+    ~ItemCursor() override = default;
+
+    [[nodiscard]] bool next() override { return cursor_->next(); }
+
+    [[nodiscard]] std::string_view getKey() const override { return cursor_->getKey(); }
+
+    [[nodiscard]] ConfigSourcePointer getChild() const override
+    {
+        return source_.wrap(cursor_->getChild(), source_.getChildPath(getKey()));
+    }
+
+    [[nodiscard]] bool isTable() const override { return cursor_->isTable(); }
+
+    [[nodiscard]] std::optional<bool> getBoolean() const override
+    {
+        return source_.read(getKey(), [this] { return cursor_->getBoolean(); });
+    }
+
+    [[nodiscard]] std::optional<double> getDouble() const override
+    {
+        return source_.read(getKey(), [this] { return cursor_->getDouble(); });
+    }
+
+    [[nodiscard]] std::optional<int64_t> getNumber() const override
+    {
+        return source_.read(getKey(), [this] { return cursor_->getNumber(); });
+    }
+
+    [[nodiscard]] std::optional<uint64_t> getUnsignedNumber() const override
+    {
+        return source_.read(getKey(), [this] { return cursor_->getUnsignedNumber(); });
+    }
+
+    [[nodiscard]] std::optional<std::string> getString() const override
+    {
+        return source_.read(getKey(), [this] { return cursor_->getString(); });
+    }
+
+    [[nodiscard]] std::optional<std::string_view> getStringView() const override
+    {
+        return source_.read(getKey(), [this] { return cursor_->getStringView(); });
+    }
+
+private:
+    const InstrumentedSource& source_;
+    std::unique_ptr<ConfigItemCursor> cursor_;
+};
+
+ConfigSourcePointer InstrumentedSource::wrap(ConfigSourcePointer child, std::string path) const
+{
+    if (!child)
+        return child;
+    return std::make_shared<InstrumentedSource>(std::move(child), log_, std::move(path));
+}
+
+std::string InstrumentedSource::getChildPath(std::string_view name) const
+{
+    return std::string{prefix_}.append(name);
+}
+
+bool InstrumentedSource::hasValueAt(int index) const
+{
+    return readElement([&] { return source_->hasValueAt(index); });
+}
+
+ConfigSourcePointer InstrumentedSource::tryGetChild(int index) const
+{
+    return wrap(readElement([&] { return source_->tryGetChild(index); }), path_ + "[]");
+}
+
+ConfigSourcePointer InstrumentedSource::tryGetChild(std::string_view name) const
+{
+    return wrap(read(name, [&] { return source_->tryGetChild(name); }), getChildPath(name));
+}
+
+ConfigSourcePointer InstrumentedSource::tryGetChild(const ConfigKey& key) const
+{
+    return wrap(read(key.getName(), [&] { return source_->tryGetChild(key); }),
+        getChildPath(key.getName()));
+}
+
+std::optional<bool> InstrumentedSource::tryGetBoolean(int index) const
+{
+    return readElement([&] { return source_->tryGetBoolean(index); });
+}
+
+std::optional<bool> InstrumentedSource::tryGetBoolean(std::string_view name) const
+{
+    return read(name, [&] { return source_->tryGetBoolean(name); });
+}
+
+std::optional<bool> InstrumentedSource::tryGetBoolean(const ConfigKey& key) const
+{
+    return read(key.getName(), [&] { return source_->tryGetBoolean(key); });
+}
+
+std::optional<double> InstrumentedSource::tryGetDouble(int index) const
+{
+    return readElement([&] { return source_->tryGetDouble(index); });
+}
+
+std::optional<double> InstrumentedSource::tryGetDouble(std::string_view name) const
+{
+    return read(name, [&] { return source_->tryGetDouble(name); });
+}
+
+std::optional<double> InstrumentedSource::tryGetDouble(const ConfigKey& key) const
+{
+    return read(key.getName(), [&] { return source_->tryGetDouble(key); });
+}
+
+std::optional<int64_t> InstrumentedSource::tryGetNumber(int index) const
+{
+    return readElement([&] { return source_->tryGetNumber(index); });
+}
+
+std::optional<int64_t> InstrumentedSource::tryGetNumber(std::string_view name) const
+{
+    return read(name, [&] { return source_->tryGetNumber(name); });
+}
+
+std::optional<int64_t> InstrumentedSource::tryGetNumber(const ConfigKey& key) const
+{
+    return read(key.getName(), [&] { return source_->tryGetNumber(key); });
+}
+
+std::optional<uint64_t> InstrumentedSource::tryGetUnsignedNumber(int index) const
+{
+    return readElement([&] { return source_->tryGetUnsignedNumber(index); });
+}
+
+std::optional<uint64_t> InstrumentedSource::tryGetUnsignedNumber(std::string_view name) const
+{
+    return read(name, [&] { return source_->tryGetUnsignedNumber(name); });
+}
+
+std::optional<uint64_t> InstrumentedSource::tryGetUnsignedNumber(const ConfigKey& key) const
+{
+    return read(key.getName(), [&] { return source_->tryGetUnsignedNumber(key); });
+}
+
+std::optional<std::string> InstrumentedSource::tryGetString(int index) const
+{
+    return readElement([&] { return source_->tryGetString(index); });
+}
+
+std::optional<std::string> InstrumentedSource::tryGetString(std::string_view name) const
+{
+    return read(name, [&] { return source_->tryGetString(name); });
+}
+
+std::optional<std::string> InstrumentedSource::tryGetString(const ConfigKey& key) const
+{
+    return read(key.getName(), [&] { return source_->tryGetString(key); });
+}
+
+std::optional<std::string_view> InstrumentedSource::tryGetStringView(int index) const
+{
+    return readElement([&] { return source_->tryGetStringView(index); });
+}
+
+std::optional<std::string_view> InstrumentedSource::tryGetStringView(std::string_view name) const
+{
+    return read(name, [&] { return source_->tryGetStringView(name); });
+}
+
+std::optional<std::string_view> InstrumentedSource::tryGetStringView(const ConfigKey& key) const
+{
+    return read(key.getName(), [&] { return source_->tryGetStringView(key); });
+}
+
+std::vector<std::string> InstrumentedSource::getKeyList() const { return source_->getKeyList(); }
+
+std::unique_ptr<ConfigItemCursor> InstrumentedSource::getItems() const
+{
+    return std::make_unique<ItemCursor>(*this, source_->getItems());
+}
+
+size_t InstrumentedSource::getArraySize() const { return source_->getArraySize(); }
+
+template <typename T>
+size_t InstrumentedSource::copyValuesT(std::span<T> values) const
+{
+    return readElement([&] { return source_->copyValues(values); });
+}
+
+size_t InstrumentedSource::copyValues(std::span<bool> values) const
+{
+    return copyValuesT(values);
+}
+
+size_t InstrumentedSource::copyValues(std::span<double> values) const
+{
+    return copyValuesT(values);
+}
+
+size_t InstrumentedSource::copyValues(std::span<int64_t> values) const
+{
+    return copyValuesT(values);
+}
+
+size_t InstrumentedSource::copyValues(std::span<uint64_t> values) const
+{
+    return copyValuesT(values);
+}
+
+size_t InstrumentedSource::copyValues(std::span<std::string> values) const
+{
+    return copyValuesT(values);
+}
+
+size_t InstrumentedSource::copyValues(std::span<std::string_view> values) const
+{
+    return copyValuesT(values);
+}
+
+ConfigSourcePointer InstrumentedSource::freeze() const
+{
+    auto frozen = source_->freeze();
+    if (frozen && path_.empty())
+        log_->watch(frozen);
+    return wrap(std::move(frozen), path_);
+}
+
+bool InstrumentedSource::isThreadSafe() const noexcept { return source_->isThreadSafe(); }
+
+// Wrappers are made for every lookup, the index is kept by the source they wrap.
+const KeyIndex& InstrumentedSource::getKeyIndex() const { return source_->getKeyIndex(); }
+
+} // namespace confetti::internal
@@ -0,0 +1,137 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_INSTRUMENTED_SOURCE_HH
+#define CONFETTI_INTERNAL_INSTRUMENTED_SOURCE_HH
+
+#include "../config_access_log.hh"
+#include "../config_source.hh"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace confetti::internal {
+
+// Passes every call to another source, and records reads of values and children in
+// a log under their full path. Reads while walking items are recorded for values,
+// not for children.
+class InstrumentedSource final : public ConfigSource {
+public:
+    InstrumentedSource(
+        ConfigSourcePointer source, std::shared_ptr<ConfigAccessLog> log, std::string path);
+
+    ~InstrumentedSource() override;
+
+    [[nodiscard]] bool hasValueAt(int index) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(int index) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(std::string_view name) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(int index) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(int index) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(int index) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(int index) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(
+        std::string_view name) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(
+        const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(int index) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(int index) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(
+        std::string_view name) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(
+        const ConfigKey& key) const override;
+
+    [[nodiscard]] std::vector<std::string> getKeyList() const override;
+
+    [[nodiscard]] std::unique_ptr<ConfigItemCursor> getItems() const override;
+
+    [[nodiscard]] size_t getArraySize() const override;
+
+    [[nodiscard]] size_t copyValues(std::span<bool> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<double> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<int64_t> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<uint64_t> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<std::string> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<std::string_view> values) const override;
+
+    [[nodiscard]] ConfigSourcePointer freeze() const override;
+
+    [[nodiscard]] bool isThreadSafe() const noexcept override;
+
+    [[nodiscard]] const KeyIndex& getKeyIndex() const override;
+
+private:
+    class ItemCursor;
+
+    template <typename F>
+    [[nodiscard]] auto read(std::string_view name, const F& get) const;
+
+    template <typename F>
+    [[nodiscard]] auto readElement(const F& get) const;
+
+    template <typename T>
+    [[nodiscard]] size_t copyValuesT(std::span<T> values) const;
+
+    [[nodiscard]] ConfigSourcePointer wrap(ConfigSourcePointer child, std::string path) const;
+
+    [[nodiscard]] std::string getChildPath(std::string_view name) const;
+
+    ConfigSourcePointer source_;
+    std::shared_ptr<ConfigAccessLog> log_;
+    std::string path_;
+    std::string prefix_; // Of child paths, the path and a dot unless it is the root.
+    uint64_t pathHash_;
+    uint64_t prefixHash_;
+};
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_INSTRUMENTED_SOURCE_HH
@@ -0,0 +1,602 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "json.hh"
+#include "mapped_file.hh"
+#include "snapshot.hh"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+namespace confetti::internal {
+
+namespace {
+
+constexpr int maxJsonDepth = 1024;
+
+constexpr bool isWhitespace(char c) noexcept
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+constexpr bool isDigit(char c) noexcept { return c >= '0' && c <= '9'; }
+
+constexpr bool isStringSpecial(char c) noexcept
+{
+    return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+#if defined(__SSE2__)
+
+inline __m128i load(const char* p) noexcept
+{
+    __m128i chunk;
+    std::memcpy(&chunk, p, sizeof(chunk));
+    return chunk;
+}
+
+#endif
+
+// Returns the first quote, backslash or control character at or after `p`.
+inline const char* findStringSpecial(const char* p, const char* end) noexcept
+{
+#if defined(__SSE2__)
+    const auto quote = _mm_set1_epi8('"');
+    const auto backslash = _mm_set1_epi8('\\');
+    const auto control = _mm_set1_epi8(0x1F);
+    for (; end - p >= 16; p += 16) {
+        const auto chunk = load(p);
+        const auto special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+        if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(special)))
+            return p + std::countr_zero(mask);
+    }
+#endif
+    while (p != end && !isStringSpecial(*p))
+        ++p;
+    return p;
+}
+
+// Returns the first non-whitespace character at or after `p`.
+inline const char* skipWhitespace(const char* p, const char* end) noexcept
+{
+    // Most tokens are separated by at most a single space.
+    if (p != end && !isWhitespace(*p))
+        return p;
+#if defined(__SSE2__)
+    const auto space = _mm_set1_epi8(' ');
+    const auto newline = _mm_set1_epi8('\n');
+    const auto carriageReturn = _mm_set1_epi8('\r');
+    const auto tab = _mm_set1_epi8('\t');
+    for (; end - p >= 16; p += 16) {
+        const auto chunk = load(p);
+        const auto whitespace = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, carriageReturn), _mm_cmpeq_epi8(chunk, tab)));
+        if (const auto mask = ~static_cast<unsigned>(_mm_movemask_epi8(whitespace)) & 0xFFFFu)
+            return p + std::countr_zero(mask);
+    }
+#endif
+    while (p != end && isWhitespace(*p))
+        ++p;
+    return p;
+}
+
+// Parses text in memory, or text read from a stream into a window of it. The window
+// is refilled only between tokens, and only once the whole token is in it, so that
+// the grammar below never sees the end of a chunk.
+class JsonParser final {
+public:
+    JsonParser(std::string_view text, std::string_view name) noexcept
+        : begin_{text.data()}
+        , pos_{text.data()}
+        , end_{text.data() + text.size()}
+        , name_{name}
+        , stream_{nullptr}
+        , chunkSize_{0}
+        , offset_{0}
+        , line_{1}
+        , lineBegin_{0}
+    {
+    }
+
+    JsonParser(std::istream& stream, std::string_view name, size_t chunkSize)
+        : begin_{nullptr}
+        , pos_{nullptr}
+        , end_{nullptr}
+        , name_{name}
+        , stream_{&stream}
+        , chunkSize_{std::max<size_t>(chunkSize, 1)}
+        , offset_{0}
+        , line_{1}
+        , lineBegin_{0}
+    {
+    }
+
+    [[nodiscard]] ConfigSourcePointer parse()
+    {
+        skipBom();
+        if (pos_ == end_ || (*pos_ != '{' && *pos_ != '['))
+            fail("expected an object or an array");
+        parseValue(0);
+        skip();
+        if (pos_ != end_)
+            fail("unexpected data after the document");
+        return builder_.finish()->getRootSource();
+    }
+
+    void parseElements(const std::function<void(ConfigSourcePointer)>& callback)
+    {
+        skipBom();
+        if (!consume('['))
+            fail("expected an array");
+        skip();
+        if (!consume(']')) {
+            for (;;) {
+                if (pos_ == end_ || (*pos_ != '{' && *pos_ != '['))
+                    fail("expected an object or an array");
+                parseValue(1);
+                callback(builder_.finish()->getRootSource());
+                skip();
+                if (consume(']'))
+                    break;
+                if (!consume(','))
+                    fail("expected ',' or ']'");
+                skip();
+            }
+        }
+        skip();
+        if (pos_ != end_)
+            fail("unexpected data after the document");
+    }
+
+private:
+    void skipBom()
+    {
+        while (end_ - pos_ < 3 && refill()) {
+        }
+        if (end_ - pos_ >= 3 && std::memcmp(pos_, "\xEF\xBB\xBF", 3) == 0)
+            pos_ += 3;
+        skip();
+    }
+
+    void skip()
+    {
+        for (;;) {
+            pos_ = skipWhitespace(pos_, end_);
+            if (pos_ != end_ || !refill())
+                break;
+        }
+    }
+
+    // Drops the text before pos_ and appends the next chunk to the rest of the window.
+    // Returns false at the end of the stream.
+    bool refill()
+    {
+        if (!stream_ || !*stream_)
+            return false;
+        countLines(pos_, line_, lineBegin_);
+        const auto consumed = static_cast<size_t>(pos_ - begin_);
+        offset_ += consumed;
+        window_.erase(0, consumed);
+        const auto size = window_.size();
+        window_.resize(size + chunkSize_);
+        stream_->read(window_.data() + size, static_cast<std::streamsize>(chunkSize_));
+        if (stream_->bad())
+            throw std::runtime_error{std::string{name_}.append(": read error")};
+        window_.resize(size + static_cast<size_t>(stream_->gcount()));
+        begin_ = window_.data();
+        pos_ = begin_;
+        end_ = begin_ + window_.size();
+        return window_.size() != size;
+    }
+
+    // Reads on until the string, number or literal at pos_ ends within the window.
+    void readToken()
+    {
+        if (!stream_ || *pos_ == '{' || *pos_ == '[')
+            return;
+        const auto string = *pos_ == '"';
+        size_t scanned = 1;
+        for (;;) {
+            const auto p = string ? findStringEnd(pos_ + scanned) : findWordEnd(pos_ + scanned);
+            if (p != end_)
+                return;
+            scanned = static_cast<size_t>(p - pos_);
+            if (!refill())
+                return;
+        }
+    }
+
+    // Returns the first quote at or after `p` that is not escaped. The string begins at pos_.
+    [[nodiscard]] const char* findStringEnd(const char* p) const noexcept
+    {
+        for (; p != end_; ++p) {
+            p = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(end_ - p)));
+            if (!p)
+                return end_;
+            auto escape = p;
+            while (escape[-1] == '\\')
+                --escape;
+            if ((p - escape) % 2 == 0)
+                return p;
+        }
+        return end_;
+    }
+
+    [[nodiscard]] const char* findWordEnd(const char* p) const noexcept
+    {
+        while (p != end_
+            && (isDigit(*p) || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '.'
+                || *p == '+' || *p == '-'))
+            ++p;
+        return p;
+    }
+
+    [[nodiscard]] bool consume(char c) noexcept
+    {
+        if (pos_ == end_ || *pos_ != c)
+            return false;
+        ++pos_;
+        return true;
+    }
+
+    void parseValue(int depth)
+    {
+        if (pos_ == end_)
+            fail("unexpected end of data");
+        readToken();
+        switch (*pos_) {
+            case '{':
+                parseObject(depth + 1);
+                break;
+            case '[':
+                parseArray(depth + 1);
+                break;
+            case '"':
+                builder_.addString(parseString());
+                break;
+            case 't':
+                parseLiteral("true");
+                builder_.addBoolean(true);
+                break;
+            case 'f':
+                parseLiteral("false");
+                builder_.addBoolean(false);
+                break;
+            case 'n':
+                parseLiteral("null");
+                builder_.addNil();
+                break;
+            default:
+                parseNumber();
+                break;
+        }
+    }
+
+    void parseObject(int depth)
+    {
+        if (depth > maxJsonDepth)
+            fail("too deeply nested");
+        ++pos_;
+        builder_.beginTable();
+        skip();
+        if (!consume('}')) {
+            for (;;) {
+                if (pos_ == end_ || *pos_ != '"')
+                    fail("expected a string key");
+                readToken();
+                builder_.setKey(parseString());
+                skip();
+                if (!consume(':'))
+                    fail("expected ':'");
+                skip();
+                parseValue(depth);
+                skip();
+                if (consume('}'))
+                    break;
+                if (!consume(','))
+                    fail("expected ',' or '}'");
+                skip();
+            }
+        }
+        builder_.endTable();
+    }
+
+    void parseArray(int depth)
+    {
+        if (depth > maxJsonDepth)
+            fail("too deeply nested");
+        ++pos_;
+        builder_.beginTable();
+        skip();
+        if (!consume(']')) {
+            for (;;) {
+                parseValue(depth);
+                skip();
+                if (consume(']'))
+                    break;
+                if (!consume(','))
+                    fail("expected ',' or ']'");
+                skip();
+            }
+        }
+        builder_.endTable();
+    }
+
+    // The result is valid until the next call.
+    [[nodiscard]] std::string_view parseString()
+    {
+        const auto begin = ++pos_;
+        auto p = findStringSpecial(begin, end_);
+        if (p != end_ && *p == '"') {
+            pos_ = p + 1;
+            return {begin, static_cast<size_t>(p - begin)};
+        }
+
+        buffer_.assign(begin, p);
+        for (;;) {
+            pos_ = p;
+            if (p == end_)
+                fail("unterminated string");
+            if (*p == '"')
+                break;
+            if (*p != '\\')
+                fail("control character in string");
+            pos_ = p + 1;
+            parseEscape();
+            p = findStringSpecial(pos_, end_);
+            buffer_.append(pos_, p);
+        }
+        ++pos_;
+        return buffer_;
+    }
+
+    void parseEscape()
+    {
+        if (pos_ == end_)
+            fail("unterminated string");
+        switch (*pos_++) {
+            case '"':
+                buffer_ += '"';
+                break;
+            case '\\':
+                buffer_ += '\\';
+                break;
+            case '/':
+                buffer_ += '/';
+                break;
+            case 'b':
+                buffer_ += '\b';
+                break;
+            case 'f':
+                buffer_ += '\f';
+                break;
+            case 'n':
+                buffer_ += '\n';
+                break;
+            case 'r':
+                buffer_ += '\r';
+                break;
+            case 't':
+                buffer_ += '\t';
+                break;
+            case 'u':
+                appendUtf8(parseCodePoint());
+                break;
+            default:
+                --pos_;
+                fail("invalid escape sequence");
+        }
+    }
+
+    [[nodiscard]] uint32_t parseHex4()
+    {
+        uint32_t code = 0;
+        if (end_ - pos_ < 4)
+            fail("invalid unicode escape");
+        const auto [ptr, ec] = std::from_chars(pos_, pos_ + 4, code, 16);
+        if (ec != std::errc{} || ptr != pos_ + 4)
+            fail("invalid unicode escape");
+        pos_ = ptr;
+        return code;
+    }
+
+    [[nodiscard]] uint32_t parseCodePoint()
+    {
+        const auto code = parseHex4();
+        if (code < 0xD800 || code > 0xDFFF)
+            return code;
+        if (code > 0xDBFF || end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u')
+            fail("invalid unicode surrogate pair");
+        pos_ += 2;
+        const auto low = parseHex4();
+        if (low < 0xDC00 || low > 0xDFFF)
+            fail("invalid unicode surrogate pair");
+        return 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    }
+
+    void appendUtf8(uint32_t code)
+    {
+        if (code < 0x80) {
+            buffer_ += static_cast<char>(code);
+        } else if (code < 0x800) {
+            buffer_ += static_cast<char>(0xC0 | (code >> 6));
+            buffer_ += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            buffer_ += static_cast<char>(0xE0 | (code >> 12));
+            buffer_ += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            buffer_ += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            buffer_ += static_cast<char>(0xF0 | (code >> 18));
+            buffer_ += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            buffer_ += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            buffer_ += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    void parseLiteral(std::string_view literal)
+    {
+        if (static_cast<size_t>(end_ - pos_) < literal.size()
+            || std::memcmp(pos_, literal.data(), literal.size()) != 0)
+            fail("unexpected character");
+        pos_ += literal.size();
+    }
+
+    [[nodiscard]] const char* skipDigits(const char* p)
+    {
+        if (p == end_ || !isDigit(*p)) {
+            pos_ = p;
+            fail("invalid number");
+        }
+        while (p != end_ && isDigit(*p))
+            ++p;
+        return p;
+    }
+
+    // from_chars accepts more than JSON does, so the grammar is checked first.
+    void parseNumber()
+    {
+        auto p = pos_;
+        if (*p == '-')
+            ++p;
+        else if (!isDigit(*p))
+            fail("unexpected character");
+        p = p != end_ && *p == '0' ? p + 1 : skipDigits(p);
+
+        bool integral = true;
+        if (p != end_ && *p == '.') {
+            integral = false;
+            p = skipDigits(p + 1);
+        }
+        if (p != end_ && (*p == 'e' || *p == 'E')) {
+            integral = false;
+            ++p;
+            if (p != end_ && (*p == '+' || *p == '-'))
+                ++p;
+            p = skipDigits(p);
+        }
+
+        if (integral) {
+            int64_t value;
+            if (std::from_chars(pos_, p, value).ec == std::errc{}) {
+                builder_.addInteger(value);
+                pos_ = p;
+                return;
+            }
+        }
+
+        double value;
+        if (std::from_chars(pos_, p, value).ec != std::errc{})
+            fail("number out of range");
+        builder_.addDouble(value);
+        pos_ = p;
+    }
+
+    // Adds the lines from the beginning of the window to `end`.
+    void countLines(const char* end, size_t& line, size_t& lineBegin) const noexcept
+    {
+        for (auto p = begin_; p != end; ++p) {
+            if (*p == '\n') {
+                ++line;
+                lineBegin = offset_ + static_cast<size_t>(p - begin_) + 1;
+            }
+        }
+    }
+
+    [[noreturn]] void fail(std::string_view message) const
+    {
+        auto line = line_;
+        auto lineBegin = lineBegin_;
+        countLines(pos_, line, lineBegin);
+        const auto column = offset_ + static_cast<size_t>(pos_ - begin_) - lineBegin + 1;
+        throw std::runtime_error{std::string{name_}
+                                     .append(":")
+                                     .append(std::to_string(line))
+                                     .append(":")
+                                     .append(std::to_string(column))
+                                     .append(": ")
+                                     .append(message)};
+    }
+
+    const char* begin_;
+    const char* pos_;
+    const char* end_;
+    std::string_view name_;
+    std::istream* stream_;
+    size_t chunkSize_;
+    std::string window_;
+    size_t offset_;
+    size_t line_;
+    size_t lineBegin_;
+    std::string buffer_;
+    SnapshotBuilder builder_;
+};
+
+std::ifstream openJsonFile(const std::filesystem::path& file)
+{
+    std::ifstream stream{file, std::ios::binary};
+    if (!stream) {
+        throw std::system_error{
+            errno, std::generic_category(), std::string{"Cannot open "}.append(file.native())};
+    }
+    return stream;
+}
+
+} // namespace
+
+ConfigSourcePointer parseJson(std::string_view text, std::string_view name)
+{
+    return JsonParser{text, name}.parse();
+}
+
+ConfigSourcePointer parseJson(std::istream& stream, std::string_view name, size_t chunkSize)
+{
+    return JsonParser{stream, name, chunkSize}.parse();
+}
+
+void parseJsonElements(std::istream& stream,
+    const std::function<void(ConfigSourcePointer)>& callback, std::string_view name,
+    size_t chunkSize)
+{
+    JsonParser{stream, name, chunkSize}.parseElements(callback);
+}
+
+ConfigSourcePointer loadJsonFile(const std::filesystem::path& file)
+{
+    const MappedFile mapping{file};
+    return parseJson(mapping.getData(), file.native());
+}
+
+void streamJsonFile(
+    const std::filesystem::path& file, const std::function<void(ConfigSourcePointer)>& callback)
+{
+    auto stream = openJsonFile(file);
+    parseJsonElements(stream, callback, file.native());
+}
+
+} // namespace confetti::internal
@@ -0,0 +1,52 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_JSON_HH
+#define CONFETTI_INTERNAL_JSON_HH
+
+#include "../config_source.hh"
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <string_view>
+
+namespace confetti::internal {
+
+// Parses a JSON document with an object or an array at the top level into a
+// snapshot. Null values are treated as absent, like in lunajson. Errors name
+// the document and the line and column they occurred at.
+[[nodiscard]] ConfigSourcePointer parseJson(std::string_view text, std::string_view name = "JSON");
+
+// Reads the document in chunks of the given size, so that besides the snapshot being
+// built only a chunk and the longest string in the document are kept in memory.
+[[nodiscard]] ConfigSourcePointer parseJson(
+    std::istream& stream, std::string_view name = "JSON", size_t chunkSize = 64 * 1024);
+
+// Reads a document with an array at the top level in chunks, and passes every element,
+// which must be an object or an array, to the callback as a snapshot of its own.
+void parseJsonElements(std::istream& stream,
+    const std::function<void(ConfigSourcePointer)>& callback, std::string_view name = "JSON",
+    size_t chunkSize = 64 * 1024);
+
+[[nodiscard]] ConfigSourcePointer loadJsonFile(const std::filesystem::path& file);
+
+void streamJsonFile(
+    const std::filesystem::path& file, const std::function<void(ConfigSourcePointer)>& callback);
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_JSON_HH
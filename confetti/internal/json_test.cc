@@ -0,0 +1,186 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "json.hh"
+#include <gmock/gmock.h>
+#include <sstream>
+
+using confetti::internal::parseJson;
+using confetti::internal::parseJsonElements;
+
+TEST(Json, Scalars)
+{
+    auto source = parseJson(R"({
+        "string": "Hello, World!",
+        "integer": 9007199254740993,
+        "negative": -42,
+        "double": 19.86,
+        "exponent": 1e2,
+        "huge": 18446744073709551616,
+        "yes": true,
+        "no": false,
+        "nothing": null,
+        "duplicate": 1,
+        "duplicate": 2
+    })");
+
+    EXPECT_EQ("Hello, World!", source->tryGetString("string").value());
+    EXPECT_EQ("9007199254740993", source->tryGetString("integer").value());
+    EXPECT_EQ(-42, source->tryGetNumber("negative").value());
+    EXPECT_DOUBLE_EQ(19.86, source->tryGetDouble("double").value());
+    EXPECT_EQ("100.0", source->tryGetString("exponent").value());
+    EXPECT_DOUBLE_EQ(18446744073709551616.0, source->tryGetDouble("huge").value());
+    EXPECT_TRUE(source->tryGetBoolean("yes").value());
+    EXPECT_FALSE(source->tryGetBoolean("no").value());
+    EXPECT_FALSE(source->tryGetString("nothing"));
+    EXPECT_EQ(2, source->tryGetNumber("duplicate").value());
+    EXPECT_THAT(source->getKeyList(),
+        testing::UnorderedElementsAre("string", "integer", "negative", "double", "exponent",
+            "huge", "yes", "no", "duplicate"));
+}
+
+TEST(Json, Strings)
+{
+    auto source = parseJson(
+        R"(["plain", "a \"quoted\" \\ \/ \b\f\n\r\t string", "\u00e9\u4e2d\ud83d\ude00",
+            "long string without any escapes that spans several SIMD blocks", "tail \u0041", ""])");
+
+    EXPECT_EQ("plain", source->tryGetString(0).value());
+    EXPECT_EQ("a \"quoted\" \\ / \b\f\n\r\t string", source->tryGetString(1).value());
+    EXPECT_EQ("\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80", source->tryGetString(2).value());
+    EXPECT_EQ("long string without any escapes that spans several SIMD blocks",
+        source->tryGetString(3).value());
+    EXPECT_EQ("tail A", source->tryGetString(4).value());
+    EXPECT_EQ("", source->tryGetString(5).value());
+}
+
+TEST(Json, Nested)
+{
+    auto source = parseJson("\xEF\xBB\xBF{\"a\": {\"b\": [1, null, [true], {}]}, \"c\": []}");
+
+    auto b = source->tryGetChild("a")->tryGetChild("b");
+    ASSERT_TRUE(b);
+    EXPECT_EQ(1, b->tryGetNumber(0).value());
+    EXPECT_FALSE(b->hasValueAt(1));
+    EXPECT_TRUE(b->tryGetChild(2)->tryGetBoolean(0).value());
+    EXPECT_TRUE(b->tryGetChild(3));
+    EXPECT_FALSE(b->hasValueAt(4));
+    EXPECT_FALSE(source->tryGetChild("c")->hasValueAt(0));
+    EXPECT_TRUE(source->isThreadSafe());
+}
+
+TEST(Json, Errors)
+{
+    const auto error = [](std::string_view text) {
+        std::string result;
+        try {
+            (void)parseJson(text, "test.json");
+        } catch (const std::runtime_error& e) {
+            result = e.what();
+        }
+        // Read in chunks, the same errors are reported at the same place.
+        for (size_t chunkSize : {1, 3}) {
+            std::istringstream stream{std::string{text}};
+            try {
+                (void)parseJson(stream, "test.json", chunkSize);
+                EXPECT_EQ("", result) << "chunks of " << chunkSize;
+            } catch (const std::runtime_error& e) {
+                EXPECT_EQ(result, e.what()) << "chunks of " << chunkSize;
+            }
+        }
+        return result;
+    };
+
+    EXPECT_EQ("test.json:1:1: expected an object or an array", error(""));
+    EXPECT_EQ("test.json:1:1: expected an object or an array", error("42"));
+    EXPECT_EQ("test.json:2:7: expected ':'", error("{\n  \"a\" 1}"));
+    EXPECT_EQ("test.json:1:7: expected ',' or '}'", error("{\"a\":1]"));
+    EXPECT_EQ("test.json:1:9: unexpected data after the document", error("{\"a\":1} x"));
+    EXPECT_EQ("test.json:1:2: expected a string key", error("{a:1}"));
+    EXPECT_EQ("test.json:1:2: unexpected character", error("[tru]"));
+    EXPECT_EQ("test.json:1:4: invalid number", error("[1.]"));
+    EXPECT_EQ("test.json:1:3: invalid number", error("[-]"));
+    EXPECT_EQ("test.json:1:3: expected ',' or ']'", error("[01]"));
+    EXPECT_EQ("test.json:1:2: number out of range", error("[1e999]"));
+    EXPECT_EQ("test.json:1:5: unterminated string", error("[\"ab"));
+    EXPECT_EQ("test.json:1:4: control character in string", error("[\"a\n\"]"));
+    EXPECT_EQ("test.json:1:4: invalid escape sequence", error("[\"\\x\"]"));
+    EXPECT_EQ("test.json:1:9: invalid unicode surrogate pair", error("[\"\\ud83d\"]"));
+    EXPECT_EQ("test.json:1:2: unexpected end of data", error("["));
+    EXPECT_EQ("test.json:1:1025: too deeply nested",
+        error(std::string(1025, '[') + std::string(1025, ']')));
+    EXPECT_EQ("", error(std::string(1024, '[') + std::string(1024, ']')));
+}
+
+TEST(Json, Chunks)
+{
+    const auto text = std::string{"\xEF\xBB\xBF"}
+        + R"({"strings": ["plain", "a \"quoted\" \\", "\\", "\u00e9\ud83d\ude00"],
+              "numbers": [-12, 0.5, 1e2, 18446744073709551616],)" "\r\n"
+        + R"( "literals": [true, false, null], "nested": {"a": [{}, []]}})" "\n";
+
+    for (size_t chunkSize = 1; chunkSize <= 17; ++chunkSize) {
+        std::istringstream stream{text};
+        const auto source = parseJson(stream, "test.json", chunkSize);
+        const auto strings = source->tryGetChild("strings");
+        EXPECT_EQ("plain", strings->tryGetString(0).value());
+        EXPECT_EQ("a \"quoted\" \\", strings->tryGetString(1).value());
+        EXPECT_EQ("\\", strings->tryGetString(2).value());
+        EXPECT_EQ("\xC3\xA9\xF0\x9F\x98\x80", strings->tryGetString(3).value());
+        const auto numbers = source->tryGetChild("numbers");
+        EXPECT_EQ(-12, numbers->tryGetNumber(0).value());
+        EXPECT_DOUBLE_EQ(0.5, numbers->tryGetDouble(1).value());
+        EXPECT_DOUBLE_EQ(100, numbers->tryGetDouble(2).value());
+        EXPECT_DOUBLE_EQ(18446744073709551616.0, numbers->tryGetDouble(3).value());
+        const auto literals = source->tryGetChild("literals");
+        EXPECT_TRUE(literals->tryGetBoolean(0).value());
+        EXPECT_FALSE(literals->tryGetBoolean(1).value());
+        EXPECT_FALSE(literals->hasValueAt(2));
+        EXPECT_TRUE(source->tryGetChild("nested")->tryGetChild("a")->tryGetChild(1));
+    }
+}
+
+TEST(Json, Elements)
+{
+    std::istringstream stream{R"([{"name": "a", "port": 80}, [1, 2], {"name": "b"}, {}])"};
+    std::vector<confetti::ConfigSourcePointer> elements;
+    parseJsonElements(
+        stream, [&elements](auto element) { elements.push_back(std::move(element)); }, "JSON", 4);
+
+    ASSERT_EQ(4, elements.size());
+    EXPECT_EQ("a", elements[0]->tryGetString("name").value());
+    EXPECT_EQ(80, elements[0]->tryGetNumber("port").value());
+    EXPECT_EQ(2, elements[1]->tryGetNumber(1).value());
+    EXPECT_EQ("b", elements[2]->tryGetString("name").value());
+    EXPECT_FALSE(elements[2]->tryGetNumber("port"));
+    EXPECT_TRUE(elements[3]->getKeyList().empty());
+
+    const auto error = [](std::string text) {
+        std::istringstream stream{std::move(text)};
+        size_t count = 0;
+        try {
+            parseJsonElements(stream, [&count](auto) { ++count; }, "test.json");
+        } catch (const std::runtime_error& e) {
+            return std::to_string(count).append(" ").append(e.what());
+        }
+        return std::to_string(count);
+    };
+    EXPECT_EQ("0", error(" [ ] "));
+    EXPECT_EQ("0 test.json:1:1: expected an array", error("{}"));
+    EXPECT_EQ("1 test.json:1:6: expected an object or an array", error("[{}, 1]"));
+    EXPECT_EQ("1 test.json:1:6: expected ',' or ']'", error("[[1] {}]"));
+    EXPECT_EQ("2 test.json:2:1: unexpected data after the document", error("[{}, {}]\n]"));
+}
@@ -0,0 +1,138 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "key_index.hh"
+#include "../config_source.hh"
+#include "levenshtein.hh"
+#include <algorithm>
+#include <tuple>
+
+namespace confetti::internal {
+
+// Trigrams of the name padded the usual way, so that short names and the ends of
+// names count too. Case is ignored for matching, not for ranking.
+static std::vector<uint32_t> getTrigrams(std::string_view name)
+{
+    const auto lower = [&](size_t i) -> uint32_t {
+        if (i < 2 || i >= name.size() + 2)
+            return ' ';
+        const auto c = static_cast<unsigned char>(name[i - 2]);
+        return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    };
+    std::vector<uint32_t> trigrams;
+    if (name.empty())
+        return trigrams;
+    trigrams.reserve(name.size() + 1);
+    for (size_t i = 0; i < name.size() + 1; ++i)
+        trigrams.push_back(lower(i) << 16 | lower(i + 1) << 8 | lower(i + 2));
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+KeyIndex::KeyIndex(const ConfigSource& source)
+{
+    std::string prefix;
+    add(source, prefix, 0);
+    for (uint32_t id = 0; id < entries_.size(); ++id) {
+        for (auto trigram : getTrigrams(getLeaf(entries_[id])))
+            postings_[trigram].push_back(id);
+    }
+}
+
+KeyIndex::~KeyIndex() = default;
+
+void KeyIndex::add(const ConfigSource& source, std::string& prefix, uint32_t depth)
+{
+    const auto cursor = source.getItems();
+    const auto prefixSize = prefix.size();
+    while (entries_.size() < maxEntries && paths_.size() < maxTextSize && cursor->next()) {
+        const auto key = cursor->getKey();
+        prefix.resize(prefixSize);
+        if (depth > 0)
+            prefix.push_back('.');
+        const auto leaf = prefix.size();
+        prefix.append(key);
+        if (depth == 0)
+            section_.push_back(static_cast<uint32_t>(entries_.size()));
+        entries_.push_back(Entry{static_cast<uint32_t>(paths_.size()),
+            static_cast<uint32_t>(prefix.size()), static_cast<uint32_t>(leaf), depth});
+        paths_.append(prefix);
+        if (depth + 1 >= maxDepth || !cursor->isTable())
+            continue;
+        if (const auto child = cursor->getChild())
+            add(*child, prefix, depth + 1);
+    }
+    prefix.resize(prefixSize);
+}
+
+std::string_view KeyIndex::suggest(std::string_view name) const
+{
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (auto trigram : getTrigrams(name)) {
+        if (auto it = postings_.find(trigram); it != postings_.end())
+            lists.push_back(&it->second);
+    }
+    // Trigrams that most keys have, like those of a common prefix, tell little and
+    // cost the most, so count the rare ones only.
+    std::sort(lists.begin(), lists.end(),
+        [](const auto* lhs, const auto* rhs) noexcept { return lhs->size() < rhs->size(); });
+    const auto commonSize = std::max(maxCandidates * 4, entries_.size() / 8);
+    std::unordered_map<uint32_t, uint32_t> hits;
+    for (const auto* list : lists) {
+        if (list->size() > commonSize && !hits.empty())
+            break;
+        for (auto id : *list)
+            ++hits[id];
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> candidates; // Shared trigrams and entry.
+    candidates.reserve(hits.size());
+    for (auto [id, count] : hits)
+        candidates.emplace_back(count, id);
+    const auto last = candidates.begin()
+        + static_cast<std::ptrdiff_t>(std::min(candidates.size(), maxCandidates));
+    std::partial_sort(candidates.begin(), last, candidates.end(),
+        [](const auto& lhs, const auto& rhs) noexcept {
+            return lhs.first != rhs.first ? lhs.first > rhs.first : lhs.second < rhs.second;
+        });
+    candidates.erase(last, candidates.end());
+    // Short and transposed names share no trigrams with the key they mean, so the keys
+    // of the subtree itself are compared too, and always if nothing else is in common.
+    if (candidates.empty() || section_.size() <= maxCandidates) {
+        for (auto id : section_)
+            candidates.emplace_back(0, id);
+    }
+
+    const Entry* best = nullptr;
+    auto bestRank = std::tuple{unboundedDistance, uint32_t{}, uint32_t{}};
+    for (auto [count, id] : candidates) {
+        const auto& entry = entries_[id];
+        const auto leaf = getLeaf(entry);
+        // Every edit costs one at least, so the cheap unit distance rules out most keys.
+        const auto bound = std::get<0>(bestRank);
+        if (unitDistance(name, leaf, bound) > bound)
+            continue;
+        const auto rank = std::tuple{distance(name, leaf, {}, bound), entry.depth, id};
+        if (rank < bestRank) {
+            best = &entry;
+            bestRank = rank;
+        }
+    }
+    return best ? getPath(*best) : std::string_view{};
+}
+
+} // namespace confetti::internal
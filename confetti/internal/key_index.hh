@@ -0,0 +1,86 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_KEY_INDEX_HH
+#define CONFETTI_INTERNAL_KEY_INDEX_HH
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace confetti {
+class ConfigSource;
+} // namespace confetti
+
+namespace confetti::internal {
+
+// Trigram index over the dotted paths of all named entries of a subtree, used to
+// suggest keys when a lookup misses. Only entries that share trigrams with the
+// missing name, and the keys of a small subtree itself, are compared with it, by
+// their last key. Values computed by code are never evaluated while indexing.
+// Immutable once built, so any number of threads may query it.
+class KeyIndex final {
+public:
+    static constexpr size_t maxDepth = 8;
+    static constexpr size_t maxEntries = 1 << 20;
+    static constexpr size_t maxTextSize = size_t{1} << 30;
+
+    explicit KeyIndex(const ConfigSource& source);
+
+    KeyIndex(const KeyIndex&) = delete;
+    KeyIndex& operator=(const KeyIndex&) = delete;
+
+    ~KeyIndex();
+
+    // Returns the closest path, or an empty view if there are no keys at all. Keys of
+    // the subtree itself win over deeper paths that are just as close.
+    [[nodiscard]] std::string_view suggest(std::string_view name) const;
+
+    [[nodiscard]] size_t size() const noexcept { return entries_.size(); }
+
+private:
+    static constexpr size_t maxCandidates = 64;
+
+    struct Entry final {
+        uint32_t offset; // Of the path in `paths_`.
+        uint32_t size;
+        uint32_t leaf; // Offset of the last key within the path.
+        uint32_t depth;
+    };
+
+    void add(const ConfigSource& source, std::string& prefix, uint32_t depth);
+
+    [[nodiscard]] std::string_view getPath(const Entry& entry) const noexcept
+    {
+        return std::string_view{paths_}.substr(entry.offset, entry.size);
+    }
+
+    [[nodiscard]] std::string_view getLeaf(const Entry& entry) const noexcept
+    {
+        return getPath(entry).substr(entry.leaf);
+    }
+
+    std::string paths_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> section_; // Entries of the subtree itself.
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings_;
+};
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_KEY_INDEX_HH
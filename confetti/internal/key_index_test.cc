@@ -0,0 +1,110 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "key_index.hh"
+#include "snapshot.hh"
+#include <gtest/gtest.h>
+#include <string>
+
+using confetti::internal::KeyIndex;
+using confetti::internal::SnapshotBuilder;
+
+namespace {
+
+confetti::ConfigSourcePointer buildTree()
+{
+    SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("email");
+    builder.addString("info@example.com");
+    builder.setKey("a");
+    builder.beginTable();
+    builder.setKey("b");
+    builder.beginTable();
+    builder.setKey("c");
+    builder.beginTable();
+    builder.setKey("year");
+    builder.addInteger(2021);
+    builder.setKey("state");
+    builder.addString("CT");
+    builder.endTable();
+    builder.endTable();
+    builder.endTable();
+    builder.setKey("list");
+    builder.beginTable();
+    builder.addString("array elements are not indexed");
+    builder.endTable();
+    builder.endTable();
+    return builder.finish()->getRootSource();
+}
+
+} // namespace
+
+TEST(KeyIndex, CrossSection)
+{
+    const KeyIndex index{*buildTree()};
+    EXPECT_EQ(7, index.size());
+    EXPECT_EQ("a.b.c.year", index.suggest("year"));
+    EXPECT_EQ("a.b.c.year", index.suggest("yaer"));
+    EXPECT_EQ("a.b.c.state", index.suggest("State"));
+    EXPECT_EQ("email", index.suggest("mail"));
+    // Nothing in common: the closest key of the section itself.
+    EXPECT_EQ("a", index.suggest("z"));
+}
+
+TEST(KeyIndex, ShortNames)
+{
+    SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("ba");
+    builder.addInteger(1);
+    builder.setKey("nested");
+    builder.beginTable();
+    builder.setKey("apple");
+    builder.addInteger(2);
+    builder.endTable();
+    builder.endTable();
+    const KeyIndex index{*builder.finish()->getRootSource()};
+    // Shares no trigram with "ba", but one with "apple".
+    EXPECT_EQ("ba", index.suggest("ab"));
+}
+
+TEST(KeyIndex, Empty)
+{
+    SnapshotBuilder builder;
+    builder.beginTable();
+    builder.endTable();
+    const KeyIndex index{*builder.finish()->getRootSource()};
+    EXPECT_EQ(0, index.size());
+    EXPECT_EQ("", index.suggest("anything"));
+}
+
+TEST(KeyIndex, LargeSection)
+{
+    SnapshotBuilder builder;
+    builder.beginTable();
+    for (int i = 0; i < 10000; ++i) {
+        builder.setKey("option_" + std::to_string(i));
+        builder.addInteger(i);
+    }
+    builder.endTable();
+    const auto source = builder.finish()->getRootSource();
+    const auto& index = source->getKeyIndex();
+    EXPECT_EQ(&index, &source->getKeyIndex());
+    EXPECT_EQ(10000, index.size());
+    EXPECT_EQ("option_4321", index.suggest("opton_4321"));
+    EXPECT_EQ("option_9999", index.suggest("optoin_9999"));
+}
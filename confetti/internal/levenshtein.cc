@@ -16,27 +16,81 @@
 
 #include "levenshtein.hh"
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <memory>
 
 namespace confetti::internal {
 
-size_t distance(std::string_view left, std::string_view right, TransformationCost cost)
+// Rows of the usual dynamic programming matrix. Keys are short, so they fit on the stack.
+// A path through the matrix drifts off the main diagonal by removals and back by
+// insertions, and has to end on the diagonal of the bottom right corner. Cells whose
+// drift alone costs more than the bound are skipped (Ukkonen's cutoff), which leaves
+// a band around the diagonal.
+size_t distance(
+    std::string_view left, std::string_view right, TransformationCost cost, size_t maxDistance)
 {
-    std::unique_ptr<size_t[]> buffer{new size_t[(right.size() + 1) * 3]};
-    auto r0 = buffer.get();
+    static constexpr size_t stackSize = 64;
+    static constexpr size_t infinity = unboundedDistance / 2;
+
+    const auto rows = static_cast<ptrdiff_t>(left.size());
+    const auto columns = static_cast<ptrdiff_t>(right.size());
+    const auto drift = [&](ptrdiff_t from, ptrdiff_t to) -> size_t {
+        return to > from ? static_cast<size_t>(to - from) * cost.remove
+                         : static_cast<size_t>(from - to) * cost.insert;
+    };
+    const auto detour = [&](ptrdiff_t offset) {
+        return drift(0, offset) + drift(offset, rows - columns);
+    };
+    if (detour(0) > maxDistance)
+        return detour(0);
+    // Offsets of the row index from the column index that are worth computing.
+    auto low = std::min<ptrdiff_t>(0, rows - columns);
+    while (low > -columns && detour(low - 1) <= maxDistance)
+        --low;
+    auto high = std::max<ptrdiff_t>(0, rows - columns);
+    while (high < rows && detour(high + 1) <= maxDistance)
+        ++high;
+
+    std::array<size_t, (stackSize + 1) * 3> stack;
+    std::unique_ptr<size_t[]> heap;
+    if (right.size() > stackSize)
+        heap.reset(new size_t[(right.size() + 1) * 3]);
+    auto r0 = heap ? heap.get() : stack.data();
     auto r1 = r0 + (right.size() + 1);
     auto r2 = r1 + (right.size() + 1);
-    for (size_t i = 0; i <= right.size(); ++i)
-        r1[i] = i * cost.insert;
-    for (size_t i = 0; i < left.size(); ++i) {
-        r2[0] = (i + 1) * cost.remove;
-        for (size_t j = 0; j < right.size(); ++j) {
-            r2[j + 1] = r1[j] + cost.replace * (left[i] != right[j]);
+    for (ptrdiff_t j = 0; j <= std::min(columns, -low); ++j)
+        r1[j] = static_cast<size_t>(j) * cost.insert;
+    if (-low < columns)
+        r1[-low + 1] = infinity;
+    // Every cell comes from the two rows above it, so once neither of them has a value
+    // within the bound, no later row has one either.
+    auto previousMin = size_t{0};
+    for (ptrdiff_t i = 0; i < rows; ++i) {
+        // Cells of this row and the one above it next to the band are read, but not computed.
+        const auto first = std::max<ptrdiff_t>(0, i + 1 - high);
+        const auto last = std::min(columns, i + 1 - low);
+        if (first > 0)
+            r2[first - 1] = infinity;
+        if (last < columns)
+            r2[last + 1] = infinity;
+        auto rowMin = infinity;
+        if (first == 0) {
+            r2[0] = static_cast<size_t>(i + 1) * cost.remove;
+            rowMin = r2[0];
+        }
+        for (auto j = std::max<ptrdiff_t>(first, 1) - 1; j < last; ++j) {
+            auto value = r1[j] + cost.replace * (left[i] != right[j]);
             if (i > 0 && j > 0 && left[i - 1] == right[j] && left[i] == right[j - 1])
-                r2[j + 1] = std::min(r2[j + 1], r0[j - 1] + cost.swap);
-            r2[j + 1] = std::min(r2[j + 1], r1[j + 1] + cost.remove);
-            r2[j + 1] = std::min(r2[j + 1], r2[j] + cost.insert);
+                value = std::min(value, r0[j - 1] + cost.swap);
+            value = std::min(value, r1[j + 1] + cost.remove);
+            value = std::min(value, r2[j] + cost.insert);
+            r2[j + 1] = value;
+            rowMin = std::min(rowMin, value);
         }
+        if (rowMin > maxDistance && previousMin > maxDistance)
+            return rowMin;
+        previousMin = rowMin;
         auto tmp = r0;
         r0 = r1;
         r1 = r2;
@@ -45,4 +99,53 @@ size_t distance(std::string_view left, std::string_view right, TransformationCos
     return r1[right.size()];
 }
 
+// Hyyrö's bit-vector algorithm for the optimal string alignment distance, which
+// processes a whole column of the matrix at once. `pattern` is up to 64 bytes.
+// See "A Bit-Vector Algorithm for Computing Levenshtein and Damerau Edit Distances".
+static size_t bitParallelDistance(
+    std::string_view pattern, std::string_view text, size_t maxDistance) noexcept
+{
+    std::array<uint64_t, 256> masks{};
+    for (size_t i = 0; i < pattern.size(); ++i)
+        masks[static_cast<unsigned char>(pattern[i])] |= uint64_t{1} << i;
+    const auto last = uint64_t{1} << (pattern.size() - 1);
+    uint64_t vp = ~uint64_t{0};
+    uint64_t vn = 0;
+    uint64_t d0 = 0;
+    uint64_t previousMask = 0;
+    auto result = pattern.size();
+    for (size_t j = 0; j < text.size(); ++j) {
+        const auto mask = masks[static_cast<unsigned char>(text[j])];
+        const auto transposition = ((~d0 & mask) << 1) & previousMask;
+        d0 = (((mask & vp) + vp) ^ vp) | mask | vn | transposition;
+        auto hp = vn | ~(d0 | vp);
+        auto hn = d0 & vp;
+        result += (hp & last) != 0;
+        result -= (hn & last) != 0;
+        // Each of the remaining columns lowers the distance by one at most.
+        const auto remaining = text.size() - j - 1;
+        if (result > remaining && result - remaining > maxDistance)
+            return result;
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        previousMask = mask;
+    }
+    return result;
+}
+
+size_t unitDistance(std::string_view left, std::string_view right, size_t maxDistance)
+{
+    if (left.size() > right.size())
+        std::swap(left, right);
+    if (right.size() - left.size() > maxDistance)
+        return right.size() - left.size();
+    if (left.empty())
+        return right.size();
+    if (left.size() > 64)
+        return distance(left, right, TransformationCost{1, 1, 1, 1}, maxDistance);
+    return bitParallelDistance(left, right, maxDistance);
+}
+
 } // namespace confetti::internal
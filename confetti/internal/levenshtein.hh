@@ -17,6 +17,8 @@
 #ifndef CONFETTI_INTERNAL_LEVENSHTEIN_HH
 #define CONFETTI_INTERNAL_LEVENSHTEIN_HH
 
+#include <cstddef>
+#include <limits>
 #include <string_view>
 
 namespace confetti::internal {
@@ -28,8 +30,18 @@ struct TransformationCost final {
     unsigned int remove{4};
 };
 
-size_t distance(
-    std::string_view left, std::string_view right, TransformationCost cost = TransformationCost{});
+inline constexpr size_t unboundedDistance = std::numeric_limits<size_t>::max();
+
+// Weighted optimal string alignment distance from `left` to `right`. Gives up as soon as
+// the result is known to exceed `maxDistance`, and returns some larger value then.
+size_t distance(std::string_view left, std::string_view right,
+    TransformationCost cost = TransformationCost{}, size_t maxDistance = unboundedDistance);
+
+// The same with every operation costing one, which makes it symmetric. Bit-parallel
+// when the shorter string is up to 64 bytes long. A lower bound of the weighted
+// distance once multiplied by the cheapest cost.
+size_t unitDistance(
+    std::string_view left, std::string_view right, size_t maxDistance = unboundedDistance);
 
 } // namespace confetti::internal
 
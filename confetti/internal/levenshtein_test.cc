@@ -16,8 +16,12 @@
 
 #include "levenshtein.hh"
 #include <gtest/gtest.h>
+#include <random>
+#include <string>
 
 using confetti::internal::distance;
+using confetti::internal::TransformationCost;
+using confetti::internal::unitDistance;
 
 TEST(LevenshteinDistance, Basic)
 {
@@ -29,3 +33,74 @@ TEST(LevenshteinDistance, Basic)
     EXPECT_EQ(4, distance("email", "mail"));
     EXPECT_EQ(10, distance("email", "male"));
 }
+
+TEST(LevenshteinDistance, Bounded)
+{
+    EXPECT_EQ(10, distance("email", "male", {}, 10));
+    EXPECT_LT(9, distance("email", "male", {}, 9));
+    EXPECT_LT(2, distance("backend_connection", "frontend_timeout", {}, 2));
+    EXPECT_EQ(0, distance("same", "same", {}, 0));
+}
+
+TEST(LevenshteinDistance, Unit)
+{
+    EXPECT_EQ(0, unitDistance("", ""));
+    EXPECT_EQ(4, unitDistance("", "four"));
+    EXPECT_EQ(4, unitDistance("four", ""));
+    EXPECT_EQ(1, unitDistance("meail", "email"));
+    EXPECT_EQ(1, unitDistance("mail", "email"));
+    EXPECT_EQ(3, unitDistance("email", "male"));
+    // Optimal string alignment does not edit a transposed pair again.
+    EXPECT_EQ(3, unitDistance("ca", "abc"));
+    EXPECT_LT(1, unitDistance("email", "male", 1));
+    EXPECT_LT(1, unitDistance("a", "abcd", 1));
+}
+
+// The bit-parallel kernel agrees with the matrix for unit costs, both ways around, and
+// so does the fallback for strings longer than 64 bytes.
+TEST(LevenshteinDistance, UnitMatchesMatrix)
+{
+    std::mt19937 random{42};
+    const auto generate = [&](size_t maxSize) {
+        std::string text(random() % (maxSize + 1), ' ');
+        for (auto& c : text)
+            c = static_cast<char>('a' + random() % 4);
+        return text;
+    };
+    for (int i = 0; i < 2000; ++i) {
+        const auto left = generate(i % 2 ? 20 : 100);
+        const auto right = generate(i % 3 ? 20 : 100);
+        const auto expected = distance(left, right, TransformationCost{1, 1, 1, 1});
+        ASSERT_EQ(expected, unitDistance(left, right)) << left << " " << right;
+        ASSERT_EQ(expected, unitDistance(right, left)) << left << " " << right;
+        ASSERT_EQ(expected, unitDistance(left, right, expected));
+        if (expected > 0) {
+            ASSERT_LT(expected - 1, unitDistance(left, right, expected - 1));
+        }
+        ASSERT_LE(expected, distance(left, right));
+    }
+}
+
+// Bounded results are exact within the bound, and above it otherwise.
+TEST(LevenshteinDistance, BoundedMatchesUnbounded)
+{
+    std::mt19937 random{42};
+    const auto generate = [&](size_t maxSize) {
+        std::string text(random() % (maxSize + 1), ' ');
+        for (auto& c : text)
+            c = static_cast<char>('a' + random() % 3);
+        return text;
+    };
+    for (int i = 0; i < 5000; ++i) {
+        const auto left = generate(i % 2 ? 12 : 80);
+        const auto right = generate(i % 3 ? 12 : 80);
+        const auto expected = distance(left, right);
+        const auto bound = static_cast<size_t>(random() % (expected * 2 + 2));
+        const auto bounded = distance(left, right, {}, bound);
+        if (expected <= bound) {
+            ASSERT_EQ(expected, bounded) << left << " " << right << " " << bound;
+        } else {
+            ASSERT_LT(bound, bounded) << left << " " << right << " " << bound;
+        }
+    }
+}
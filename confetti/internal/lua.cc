@@ -15,7 +15,9 @@
 //
 
 #include "lua.hh"
-#include "string.hh"
+#include "convert.hh"
+#include "key_index.hh"
+#include "snapshot.hh"
 
 extern "C" {
 #include <lauxlib.h>
@@ -23,13 +25,11 @@ extern "C" {
 #include <lualib.h>
 }
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
-#include <cstring>
 #include <string>
 
-#include <alloca.h>
-
 namespace confetti::internal {
 
 LuaException::LuaException(const char* message)
@@ -49,16 +49,26 @@ void LuaException::raise(lua_State* state)
 
 [[noreturn]] static int on_lua_panic(lua_State* state) { LuaException::raise(state); }
 
-LuaState::LuaState()
-    : state_{lua_newstate(&alloc, this)}
+LuaState::LuaState(LuaAllocator allocator)
+    : heap_{LuaHeap::create(allocator)}
+    , state_{heap_ ? lua_newstate(&allocFromHeap, heap_.get()) : lua_newstate(&alloc, this)}
+    , handles_{nullptr}
+    , childRefs_{0}
+    , results_{LUA_NOREF}
 {
     if (!state_)
         LuaException::raise("Cannot create Lua stack");
+    handles_ = LuaHandlePool::create();
     lua_atpanic(state_, &on_lua_panic);
     luaL_openlibs(state_);
 }
 
-LuaState::~LuaState() { close(); }
+LuaState::~LuaState()
+{
+    close();
+    if (handles_ != nullptr)
+        handles_->release();
+}
 
 void LuaState::raise() const { LuaException::raise(state_); }
 
@@ -73,9 +83,34 @@ void LuaState::close() noexcept
     if (state_ != nullptr) {
         lua_close(state_);
         state_ = nullptr;
+        keys_.clear();
+        results_ = LUA_NOREF;
+        indexes_.clear();
     }
 }
 
+void LuaState::keepFunctionResults()
+{
+    if (results_ == LUA_NOREF) {
+        lua_newtable(state_);
+        results_ = luaL_ref(state_, LUA_REGISTRYINDEX);
+    }
+}
+
+const KeyIndex& LuaState::getKeyIndex(const ConfigSource& source)
+{
+    const auto table = lua_topointer(state_, -1);
+    if (auto it = indexes_.find(table); it != indexes_.end())
+        return *it->second.index;
+    // Tables made by functions on every call would fill the cache.
+    if (indexes_.size() >= maxKeyIndexes)
+        return source.ConfigSource::getKeyIndex();
+    auto index = std::make_unique<KeyIndex>(source);
+    lua_pushvalue(state_, -1);
+    const auto ref = luaL_ref(state_, LUA_REGISTRYINDEX);
+    return *indexes_.emplace(table, TableIndex{ref, std::move(index)}).first->second.index;
+}
+
 void* LuaState::alloc(
     [[maybe_unused]] void* aux, void* ptr, [[maybe_unused]] size_t osize, size_t nsize) noexcept
 {
@@ -87,6 +122,11 @@ void* LuaState::alloc(
     return realloc(ptr, nsize);
 }
 
+void* LuaState::allocFromHeap(void* aux, void* ptr, size_t osize, size_t nsize) noexcept
+{
+    return static_cast<LuaHeap*>(aux)->reallocate(ptr, osize, nsize);
+}
+
 void LuaState::run()
 {
     check(lua_pcall(state_, 0, 1, 0));
@@ -106,8 +146,29 @@ void LuaState::run(std::string_view code)
     run();
 }
 
+void LuaState::pushKey(const ConfigKey& key)
+{
+    const auto name = key.getName();
+    const auto it = keys_.find(key.getHash());
+    if (it != keys_.end() && it->second.name == name) {
+        lua_rawgeti(state_, LUA_REGISTRYINDEX, it->second.ref);
+        return;
+    }
+    lua_pushlstring(state_, name.data(), name.size());
+    if (it == keys_.end() && keys_.size() < maxPinnedKeys) {
+        lua_pushvalue(state_, -1);
+        const auto ref = luaL_ref(state_, LUA_REGISTRYINDEX);
+        keys_.emplace(key.getHash(), PinnedKey{std::string{name}, ref});
+    }
+}
+
 LuaReference::LuaReference()
-    : state_{std::make_shared<LuaState>()}
+    : LuaReference{LuaAllocator::System}
+{
+}
+
+LuaReference::LuaReference(LuaAllocator allocator)
+    : state_{std::make_shared<LuaState>(allocator)}
     , ref_{LUA_NOREF}
 {
 }
@@ -165,6 +226,34 @@ LuaSource::LuaSource(SharedConstructTag, std::shared_ptr<LuaState> ref) noexcept
 LuaSource::~LuaSource() = default;
 
 int LuaSource::invoke(int type) const
+{
+    const auto results = ref_->getFunctionResults();
+    if (type != LUA_TFUNCTION || results == LUA_NOREF)
+        return call(type);
+
+    // Results are kept by function rather than by entry, so that entries read
+    // through any path, and the same function stored twice, share them.
+    if (!lua_checkstack(ref_, 3))
+        LuaException::raise("Lua stack overflow");
+    lua_rawgeti(ref_, LUA_REGISTRYINDEX, results); // function, results
+    lua_pushvalue(ref_, -2);
+    type = lua_rawget(ref_, -2); // function, results, result
+    if (type == LUA_TNIL) {
+        lua_pop(ref_, 1);
+        lua_pushvalue(ref_, -2);
+        type = call(LUA_TFUNCTION);
+        if (type != LUA_TNIL) {
+            lua_pushvalue(ref_, -3);
+            lua_pushvalue(ref_, -2);
+            lua_rawset(ref_, -4);
+        }
+    }
+    lua_replace(ref_, -3); // result, results
+    lua_pop(ref_, 1);
+    return type;
+}
+
+int LuaSource::call(int type) const
 {
     while (type == LUA_TFUNCTION) {
         if (lua_pcall(ref_, 0, 1, 0) != LUA_OK)
@@ -174,21 +263,18 @@ int LuaSource::invoke(int type) const
     return type;
 }
 
-int LuaSource::getField(int index) const noexcept { return invoke(lua_geti(ref_, -1, index + 1)); }
+int LuaSource::pushField(int index) const { return lua_geti(ref_, -1, index + 1); }
+
+int LuaSource::pushField(std::string_view name) const
+{
+    lua_pushlstring(ref_, name.data(), name.size());
+    return lua_gettable(ref_, -2);
+}
 
-int LuaSource::getField(std::string_view name) const noexcept
+int LuaSource::pushField(const ConfigKey& key) const
 {
-#if defined(__GNUC__)
-#    pragma GCC diagnostic push
-#    pragma GCC diagnostic ignored "-Walloca"
-#endif
-    auto field_name = static_cast<char*>(alloca(name.size() + 1));
-#if defined(__GNUC__)
-#    pragma GCC diagnostic pop
-#endif
-    std::memcpy(field_name, name.data(), name.size());
-    field_name[name.size()] = '\0';
-    return invoke(lua_getfield(ref_, -1, field_name));
+    ref_->pushKey(key);
+    return lua_gettable(ref_, -2);
 }
 
 bool LuaSource::hasValueAt(int index) const
@@ -214,20 +300,8 @@ std::optional<bool> LuaSource::tryConvertToBoolean(int type) const
             break;
         case LUA_TSTRING: {
             size_t size{};
-            if (auto data = lua_tolstring(ref_, -1, &size)) {
-                std::string_view value{data, size};
-                if (strCaseIsAnyOf(value, "y", "yes", "true", "1")) {
-                    result.emplace(true);
-                } else if (strCaseIsAnyOf(value, "n", "no", "false", "0")) {
-                    result.emplace(false);
-                } else {
-                    errno = 0;
-                    char* end_ptr{};
-                    const auto n = std::strtod(data, &end_ptr);
-                    result.emplace(
-                        (end_ptr && *end_ptr == '\0' && errno == 0) && static_cast<bool>(n));
-                }
-            }
+            if (auto data = lua_tolstring(ref_, -1, &size))
+                result.emplace(parseBoolean(data, size));
             break;
         }
         case LUA_TBOOLEAN:
@@ -253,6 +327,12 @@ std::optional<bool> LuaSource::tryGetBoolean(std::string_view name) const
     return tryConvertToBoolean(getField(name));
 }
 
+std::optional<bool> LuaSource::tryGetBoolean(const ConfigKey& key) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToBoolean(getField(key));
+}
+
 std::optional<double> LuaSource::tryConvertToDouble(int type) const
 {
     std::optional<double> result;
@@ -267,20 +347,8 @@ std::optional<double> LuaSource::tryConvertToDouble(int type) const
             break;
         case LUA_TSTRING: {
             size_t size{};
-            if (auto data = lua_tolstring(ref_, -1, &size)) {
-                char* end_ptr{};
-                errno = 0;
-                auto value = std::strtod(data, &end_ptr);
-                const auto ec = errno;
-                if (end_ptr != nullptr && *end_ptr == '\0' && ec == 0) {
-                    result.emplace(value);
-                } else {
-                    throw std::runtime_error{std::string{"Cannot convert string '"}
-                                                 .append(data, size)
-                                                 .append("' to double: ")
-                                                 .append(std::strerror(ec))};
-                }
-            }
+            if (auto data = lua_tolstring(ref_, -1, &size))
+                result.emplace(parseDouble(data, size));
             break;
         }
         default:
@@ -302,6 +370,106 @@ std::optional<double> LuaSource::tryGetDouble(std::string_view name) const
     return tryConvertToDouble(getField(name));
 }
 
+std::optional<double> LuaSource::tryGetDouble(const ConfigKey& key) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToDouble(getField(key));
+}
+
+std::optional<int64_t> LuaSource::tryConvertToNumber(int type) const
+{
+    std::optional<int64_t> result;
+    switch (type) {
+        case LUA_TNIL:
+        case LUA_TUSERDATA:
+        case LUA_TTABLE:
+        case LUA_TTHREAD:
+            break;
+        case LUA_TBOOLEAN:
+            result.emplace(lua_toboolean(ref_, -1));
+            break;
+        case LUA_TSTRING: {
+            size_t size{};
+            if (auto data = lua_tolstring(ref_, -1, &size))
+                result.emplace(parseInteger({data, size}));
+            break;
+        }
+        default:
+            if (lua_isinteger(ref_, -1)) {
+                result.emplace(lua_tointeger(ref_, -1));
+            } else {
+                result.emplace(roundToInteger(lua_tonumber(ref_, -1)));
+            }
+            break;
+    }
+    return result;
+}
+
+std::optional<int64_t> LuaSource::tryGetNumber(int index) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToNumber(getField(index));
+}
+
+std::optional<int64_t> LuaSource::tryGetNumber(std::string_view name) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToNumber(getField(name));
+}
+
+std::optional<int64_t> LuaSource::tryGetNumber(const ConfigKey& key) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToNumber(getField(key));
+}
+
+std::optional<uint64_t> LuaSource::tryConvertToUnsignedNumber(int type) const
+{
+    std::optional<uint64_t> result;
+    switch (type) {
+        case LUA_TNIL:
+        case LUA_TUSERDATA:
+        case LUA_TTABLE:
+        case LUA_TTHREAD:
+            break;
+        case LUA_TBOOLEAN:
+            result.emplace(lua_toboolean(ref_, -1));
+            break;
+        case LUA_TSTRING: {
+            size_t size{};
+            if (auto data = lua_tolstring(ref_, -1, &size))
+                result.emplace(parseUnsignedInteger({data, size}));
+            break;
+        }
+        default:
+            if (lua_isinteger(ref_, -1)) {
+                result.emplace(static_cast<uint64_t>(lua_tointeger(ref_, -1)));
+            } else {
+                result.emplace(roundToUnsignedInteger(lua_tonumber(ref_, -1)));
+            }
+            break;
+    }
+    return result;
+}
+
+std::optional<uint64_t> LuaSource::tryGetUnsignedNumber(int index) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToUnsignedNumber(getField(index));
+}
+
+std::optional<uint64_t> LuaSource::tryGetUnsignedNumber(std::string_view name) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToUnsignedNumber(getField(name));
+}
+
+std::optional<uint64_t> LuaSource::tryGetUnsignedNumber(const ConfigKey& key) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToUnsignedNumber(getField(key));
+}
+
 std::optional<std::string> LuaSource::tryConvertToString(int type) const
 {
     std::optional<std::string> result;
@@ -336,12 +504,58 @@ std::optional<std::string> LuaSource::tryGetString(std::string_view name) const
     return tryConvertToString(getField(name));
 }
 
+std::optional<std::string> LuaSource::tryGetString(const ConfigKey& key) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToString(getField(key));
+}
+
+std::optional<std::string_view> LuaSource::tryConvertToStringView(int type) const
+{
+    std::optional<std::string_view> result;
+    if (type == LUA_TFUNCTION && ref_->getFunctionResults() != LUA_NOREF)
+        type = invoke(type);
+    if (type == LUA_TSTRING) {
+        // The table, or that of kept results, holds on to the string, and Lua never
+        // moves strings.
+        size_t size{};
+        auto data = lua_tolstring(ref_, -1, &size);
+        result.emplace(data, size);
+    } else if (auto text = tryConvertToString(invoke(type))) {
+        result.emplace(ref_->getTextCache().intern(*text));
+    }
+    return result;
+}
+
+std::optional<std::string_view> LuaSource::tryGetStringView(int index) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToStringView(pushField(index));
+}
+
+std::optional<std::string_view> LuaSource::tryGetStringView(std::string_view name) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToStringView(pushField(name));
+}
+
+std::optional<std::string_view> LuaSource::tryGetStringView(const ConfigKey& key) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToStringView(pushField(key));
+}
+
 ConfigSourcePointer LuaSource::tryConvertToChild(int type) const
 {
     ConfigSourcePointer result;
     switch (type) {
         case LUA_TTABLE:
-            result = std::make_shared<LuaSource>(SharedConstructTag{}, ref_.getState());
+            // Pooled, since walking a tree creates and drops a handle for every table.
+            // The handle still copies the state pointer and takes a registry reference.
+            ref_->countChildReference();
+            result = std::allocate_shared<LuaSource>(
+                LuaHandleAllocator<LuaSource>{ref_->getHandlePool()}, SharedConstructTag{},
+                ref_.getState());
             break;
     }
     return result;
@@ -359,35 +573,352 @@ ConfigSourcePointer LuaSource::tryGetChild(std::string_view name) const
     return tryConvertToChild(getField(name));
 }
 
+ConfigSourcePointer LuaSource::tryGetChild(const ConfigKey& key) const
+{
+    LuaStackGuard _{ref_};
+    return tryConvertToChild(getField(key));
+}
+
+size_t LuaSource::getArraySize() const
+{
+    LuaStackGuard _{ref_};
+    return static_cast<size_t>(lua_rawlen(ref_, -1));
+}
+
+template <typename T, typename F>
+size_t LuaSource::copyValuesT(std::span<T> values, const F& convert) const
+{
+    LuaStackGuard _{ref_};
+    const auto count = std::min<size_t>(values.size(), lua_rawlen(ref_, -1));
+    for (size_t i = 0; i < count; ++i) {
+        auto value = convert(lua_rawgeti(ref_, -1, static_cast<lua_Integer>(i + 1)));
+        lua_pop(ref_, 1);
+        if (!value.has_value())
+            return i;
+        values[i] = *std::move(value);
+    }
+    return count;
+}
+
+size_t LuaSource::copyValues(std::span<bool> values) const
+{
+    return copyValuesT(values, [this](int type) { return tryConvertToBoolean(invoke(type)); });
+}
+
+size_t LuaSource::copyValues(std::span<double> values) const
+{
+    return copyValuesT(values, [this](int type) { return tryConvertToDouble(invoke(type)); });
+}
+
+size_t LuaSource::copyValues(std::span<int64_t> values) const
+{
+    return copyValuesT(values, [this](int type) { return tryConvertToNumber(invoke(type)); });
+}
+
+size_t LuaSource::copyValues(std::span<uint64_t> values) const
+{
+    return copyValuesT(
+        values, [this](int type) { return tryConvertToUnsignedNumber(invoke(type)); });
+}
+
+size_t LuaSource::copyValues(std::span<std::string> values) const
+{
+    return copyValuesT(values, [this](int type) { return tryConvertToString(invoke(type)); });
+}
+
+size_t LuaSource::copyValues(std::span<std::string_view> values) const
+{
+    return copyValuesT(values, [this](int type) { return tryConvertToStringView(type); });
+}
+
+// Pushes the name of the table key at the index and returns true, unless the key is
+// an element of the array part of `size` elements or neither a string nor a number.
+// Numbers are converted on a copy, as converting a key in place breaks lua_next().
+static bool pushKeyName(lua_State* state, int index, lua_Integer size)
+{
+    switch (lua_type(state, index)) {
+        case LUA_TSTRING:
+            lua_pushvalue(state, index);
+            return true;
+        case LUA_TNUMBER:
+            if (lua_isinteger(state, index)) {
+                const auto n = lua_tointeger(state, index);
+                if (n >= 1 && n <= size)
+                    return false;
+            }
+            lua_pushvalue(state, index);
+            lua_tolstring(state, -1, nullptr);
+            return true;
+        default:
+            return false;
+    }
+}
+
 std::vector<std::string> LuaSource::getKeyList() const
 {
     std::vector<std::string> keys;
     LuaStackGuard _{ref_};
+    const auto size = static_cast<lua_Integer>(lua_rawlen(ref_, -1));
     lua_pushnil(ref_);
     while (lua_next(ref_, -2) != 0) {
+        if (pushKeyName(ref_, -2, size)) {
+            size_t length{};
+            auto name = lua_tolstring(ref_, -1, &length);
+            keys.emplace_back(name, length);
+            lua_pop(ref_, 1);
+        }
         lua_pop(ref_, 1);
-        size_t size = 0;
-        auto name = lua_tolstring(ref_, -1, &size);
-        if (name != nullptr && size > 0)
-            keys.emplace_back(std::string{name, size});
     }
     return keys;
 }
 
+// Keeps the current key and value in registry slots of its own rather than on the
+// stack, so that other reads may happen between steps. Key strings are referenced
+// by the slot, so views of them stay valid until the next step. Numeric keys are
+// converted into a buffer of the cursor.
+class LuaSource::ItemCursor final : public ConfigItemCursor {
+public:
+    explicit ItemCursor(const LuaSource& source)
+        : source_{source}
+        , keyRef_{createSlot(source.ref_)}
+        , valueRef_{createSlot(source.ref_)}
+        , size_{getArraySize(source)}
+    {
+        lua_pushnil(source_.ref_);
+        lua_rawseti(source_.ref_, LUA_REGISTRYINDEX, keyRef_);
+    }
+
+    ~ItemCursor() override
+    {
+        luaL_unref(source_.ref_, LUA_REGISTRYINDEX, valueRef_);
+        luaL_unref(source_.ref_, LUA_REGISTRYINDEX, keyRef_);
+    }
+
+    bool next() override
+    {
+        lua_State* state = source_.ref_;
+        LuaStackGuard _{source_.ref_};
+        lua_rawgeti(state, LUA_REGISTRYINDEX, keyRef_);
+        while (lua_next(state, -2) != 0) {
+            if (pushKeyName(state, -2, size_)) {
+                size_t size{};
+                auto data = lua_tolstring(state, -1, &size);
+                if (lua_type(state, -3) == LUA_TSTRING)
+                    key_ = {data, size};
+                else
+                    key_ = name_.assign(data, size);
+                lua_pop(state, 1);
+                lua_rawseti(state, LUA_REGISTRYINDEX, valueRef_);
+                lua_rawseti(state, LUA_REGISTRYINDEX, keyRef_);
+                return true;
+            }
+            // Array elements are not items, skip them and keep the key for the next step.
+            lua_pop(state, 1);
+        }
+        lua_pushnil(state);
+        lua_rawseti(state, LUA_REGISTRYINDEX, keyRef_);
+        key_ = {};
+        return false;
+    }
+
+    std::string_view getKey() const override { return key_; }
+
+    ConfigSourcePointer getChild() const override
+    {
+        LuaStackGuard _{source_.ref_};
+        return source_.tryConvertToChild(source_.invoke(pushValue()));
+    }
+
+    bool isTable() const override
+    {
+        LuaStackGuard _{source_.ref_};
+        return pushValue() == LUA_TTABLE;
+    }
+
+    std::optional<bool> getBoolean() const override
+    {
+        LuaStackGuard _{source_.ref_};
+        return source_.tryConvertToBoolean(source_.invoke(pushValue()));
+    }
+
+    std::optional<double> getDouble() const override
+    {
+        LuaStackGuard _{source_.ref_};
+        return source_.tryConvertToDouble(source_.invoke(pushValue()));
+    }
+
+    std::optional<int64_t> getNumber() const override
+    {
+        LuaStackGuard _{source_.ref_};
+        return source_.tryConvertToNumber(source_.invoke(pushValue()));
+    }
+
+    std::optional<uint64_t> getUnsignedNumber() const override
+    {
+        LuaStackGuard _{source_.ref_};
+        return source_.tryConvertToUnsignedNumber(source_.invoke(pushValue()));
+    }
+
+    std::optional<std::string> getString() const override
+    {
+        LuaStackGuard _{source_.ref_};
+        return source_.tryConvertToString(source_.invoke(pushValue()));
+    }
+
+    std::optional<std::string_view> getStringView() const override
+    {
+        LuaStackGuard _{source_.ref_};
+        return source_.tryConvertToStringView(pushValue());
+    }
+
+private:
+    static int createSlot(lua_State* state)
+    {
+        lua_pushboolean(state, 0);
+        return luaL_ref(state, LUA_REGISTRYINDEX);
+    }
+
+    static lua_Integer getArraySize(const LuaSource& source)
+    {
+        LuaStackGuard _{source.ref_};
+        return static_cast<lua_Integer>(lua_rawlen(source.ref_, -1));
+    }
+
+    int pushValue() const { return lua_rawgeti(source_.ref_, LUA_REGISTRYINDEX, valueRef_); }
+
+    const LuaSource& source_;
+    const int keyRef_;
+    const int valueRef_;
+    const lua_Integer size_;
+    std::string name_;
+    std::string_view key_;
+};
+
+std::unique_ptr<ConfigItemCursor> LuaSource::getItems() const
+{
+    return std::make_unique<ItemCursor>(*this);
+}
+
+void LuaSource::freezeValue(
+    SnapshotBuilder& builder, int type, std::vector<const void*>& tables) const
+{
+    switch (type) {
+        case LUA_TBOOLEAN:
+            builder.addBoolean(lua_toboolean(ref_, -1) != 0);
+            break;
+        case LUA_TNUMBER:
+            if (lua_isinteger(ref_, -1)) {
+                builder.addInteger(lua_tointeger(ref_, -1));
+            } else {
+                builder.addDouble(lua_tonumber(ref_, -1));
+            }
+            break;
+        case LUA_TSTRING: {
+            size_t size{};
+            auto data = lua_tolstring(ref_, -1, &size);
+            builder.addString({data, size});
+            break;
+        }
+        case LUA_TTABLE:
+            freezeTable(builder, tables);
+            break;
+        default:
+            builder.addNil();
+            break;
+    }
+}
+
+void LuaSource::freezeTable(SnapshotBuilder& builder, std::vector<const void*>& tables) const
+{
+    const auto table = lua_topointer(ref_, -1);
+    if (std::find(tables.begin(), tables.end(), table) != tables.end())
+        throw std::runtime_error{"Cannot freeze configuration with cyclic table references"};
+    if (!lua_checkstack(ref_, 4))
+        LuaException::raise("Lua stack overflow");
+    tables.push_back(table);
+    builder.beginTable();
+
+    const auto size = static_cast<lua_Integer>(lua_rawlen(ref_, -1));
+    for (lua_Integer i = 1; i <= size; ++i) {
+        freezeValue(builder, invoke(lua_rawgeti(ref_, -1, i)), tables);
+        lua_pop(ref_, 1);
+    }
+
+    lua_pushnil(ref_);
+    while (lua_next(ref_, -2) != 0) {
+        if (pushKeyName(ref_, -2, size)) {
+            size_t key_size{};
+            builder.setKey({lua_tolstring(ref_, -1, &key_size), key_size});
+            lua_pop(ref_, 1);
+            freezeValue(builder, invoke(lua_type(ref_, -1)), tables);
+        }
+        lua_pop(ref_, 1);
+    }
+
+    builder.endTable();
+    tables.pop_back();
+}
+
+ConfigSourcePointer LuaSource::freeze() const
+{
+    SnapshotBuilder builder;
+    std::vector<const void*> tables;
+    {
+        LuaStackGuard _{ref_};
+        freezeTable(builder, tables);
+    }
+    return builder.finish()->getRootSource();
+}
+
+const KeyIndex& LuaSource::getKeyIndex() const
+{
+    LuaStackGuard _{ref_};
+    return ref_->getKeyIndex(*this);
+}
+
+void LuaSource::invokeTable(std::unordered_set<const void*>& tables) const
+{
+    if (!tables.insert(lua_topointer(ref_, -1)).second)
+        return;
+    if (!lua_checkstack(ref_, 4))
+        LuaException::raise("Lua stack overflow");
+    lua_pushnil(ref_);
+    while (lua_next(ref_, -2) != 0) {
+        if (invoke(lua_type(ref_, -1)) == LUA_TTABLE)
+            invokeTable(tables);
+        lua_pop(ref_, 1);
+    }
+}
+
 template <typename T>
-ConfigSourcePointer LuaSource::load(const T& source)
+ConfigSourcePointer LuaSource::load(const T& source, const ConfigLoadOptions& options)
 {
-    LuaReference ref;
+    LuaReference ref{options.luaAllocator};
+    if (options.luaFunctions != LuaFunctions::EveryTime)
+        ref->keepFunctionResults();
     lua_newtable(ref);
     lua_pushvalue(ref, -1);
     lua_setglobal(ref, "confetti");
     ref.set();
     ref->run(source);
-    return std::make_shared<LuaSource>(SharedConstructTag{}, std::move(ref));
+    auto result = std::make_shared<LuaSource>(SharedConstructTag{}, std::move(ref));
+    if (options.luaFunctions == LuaFunctions::Eager) {
+        std::unordered_set<const void*> tables;
+        LuaStackGuard _{result->ref_};
+        result->invokeTable(tables);
+    }
+    return result;
 }
 
-ConfigSourcePointer LuaSource::loadCode(std::string_view code) { return load(code); }
+ConfigSourcePointer LuaSource::loadCode(std::string_view code, const ConfigLoadOptions& options)
+{
+    return load(code, options);
+}
 
-ConfigSourcePointer LuaSource::loadFile(const std::filesystem::path& file) { return load(file); }
+ConfigSourcePointer LuaSource::loadFile(
+    const std::filesystem::path& file, const ConfigLoadOptions& options)
+{
+    return load(file, options);
+}
 
 } // namespace confetti::internal
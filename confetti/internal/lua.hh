@@ -17,10 +17,17 @@
 #ifndef CONFETTI_INTERNAL_LUA_HH
 #define CONFETTI_INTERNAL_LUA_HH
 
+#include "../config_key.hh"
+#include "../config_options.hh"
 #include "../config_source.hh"
+#include "lua_heap.hh"
+#include "text_cache.hh"
 #include <cstddef>
 #include <filesystem>
 #include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 extern "C" {
 struct lua_State;
@@ -28,6 +35,9 @@ struct lua_State;
 
 namespace confetti::internal {
 
+class KeyIndex;
+class SnapshotBuilder;
+
 class LuaException final : public std::runtime_error {
     explicit LuaException(const char* message);
 
@@ -41,7 +51,7 @@ public:
 
 class LuaState final {
 public:
-    LuaState();
+    explicit LuaState(LuaAllocator allocator = LuaAllocator::System);
 
     LuaState(const LuaState&) = delete;
 
@@ -53,6 +63,8 @@ public:
 
     operator lua_State*() const noexcept { return state_; } // NOLINT(google-explicit-constructor)
 
+    [[nodiscard]] const LuaHeap* getHeap() const noexcept { return heap_.get(); }
+
     [[noreturn]] void raise() const;
 
     void check(int result) const;
@@ -61,12 +73,64 @@ public:
 
     void run(const std::filesystem::path& file);
 
+    // Pushes the key name as a string. Names of keys seen before are pinned in the
+    // registry, so pushing them again does not hash or allocate inside Lua.
+    void pushKey(const ConfigKey& key);
+
+    // Keeps values converted to strings for views.
+    [[nodiscard]] TextCache& getTextCache() noexcept { return texts_; }
+
+    // Recycles handles to child tables.
+    [[nodiscard]] LuaHandlePool* getHandlePool() const noexcept { return handles_; }
+
+    // Every handle to a child table takes a registry reference of its own, which
+    // pooling does not avoid. Counted for benchmarks.
+    void countChildReference() noexcept { ++childRefs_; }
+
+    [[nodiscard]] size_t getChildReferenceCount() const noexcept { return childRefs_; }
+
+    // Makes functions called as values run once, see getFunctionResults().
+    void keepFunctionResults();
+
+    // Registry reference to the table of results by function, LUA_NOREF unless kept.
+    [[nodiscard]] int getFunctionResults() const noexcept { return results_; }
+
+    // Index of the table on top of the stack, which `source` is a handle to. Handles
+    // are made anew for every lookup, so indexes are kept here by table instead.
+    [[nodiscard]] const KeyIndex& getKeyIndex(const ConfigSource& source);
+
 private:
+    static constexpr size_t maxPinnedKeys = 4096;
+    static constexpr size_t maxKeyIndexes = 256;
+
+    struct PinnedKey final {
+        std::string name;
+        int ref;
+    };
+
+    struct TableIndex final {
+        int ref; // Pins the table, so that its address is not reused.
+        std::unique_ptr<KeyIndex> index;
+    };
+
+    struct KeyHash final {
+        size_t operator()(uint64_t hash) const noexcept { return static_cast<size_t>(hash); }
+    };
+
+    std::unique_ptr<LuaHeap> heap_; // Must outlive the state.
     lua_State* state_;
+    std::unordered_map<uint64_t, PinnedKey, KeyHash> keys_;
+    TextCache texts_;
+    LuaHandlePool* handles_; // Released, not deleted, as handles may outlive the state.
+    size_t childRefs_;
+    int results_;
+    std::unordered_map<const void*, TableIndex> indexes_;
 
     /// @see http://www.lua.org/manual/5.1/manual.html#lua_Alloc
     static void* alloc(void* aux, void* ptr, size_t osize, size_t nsize) noexcept;
 
+    static void* allocFromHeap(void* aux, void* ptr, size_t osize, size_t nsize) noexcept;
+
     void run();
 };
 
@@ -74,6 +138,8 @@ class LuaReference final {
 public:
     LuaReference();
 
+    explicit LuaReference(LuaAllocator allocator);
+
     explicit LuaReference(std::shared_ptr<LuaState> state) noexcept;
 
     LuaReference(LuaReference&& other) noexcept;
@@ -116,9 +182,11 @@ private:
 
 class LuaSource final : public ConfigSource {
 public:
-    static ConfigSourcePointer loadCode(std::string_view code);
+    static ConfigSourcePointer loadCode(
+        std::string_view code, const ConfigLoadOptions& options = ConfigLoadOptions{});
 
-    static ConfigSourcePointer loadFile(const std::filesystem::path& file);
+    static ConfigSourcePointer loadFile(
+        const std::filesystem::path& file, const ConfigLoadOptions& options = ConfigLoadOptions{});
 
     ~LuaSource() override;
 
@@ -131,32 +199,107 @@ public:
 
     [[nodiscard]] ConfigSourcePointer tryGetChild(std::string_view name) const override;
 
+    [[nodiscard]] ConfigSourcePointer tryGetChild(const ConfigKey& key) const override;
+
     [[nodiscard]] std::optional<bool> tryGetBoolean(int index) const override;
 
     [[nodiscard]] std::optional<bool> tryGetBoolean(std::string_view name) const override;
 
+    [[nodiscard]] std::optional<bool> tryGetBoolean(const ConfigKey& key) const override;
+
     [[nodiscard]] std::optional<double> tryGetDouble(int index) const override;
 
     [[nodiscard]] std::optional<double> tryGetDouble(std::string_view name) const override;
 
+    [[nodiscard]] std::optional<double> tryGetDouble(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(int index) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(int index) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(
+        std::string_view name) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(
+        const ConfigKey& key) const override;
+
     [[nodiscard]] std::optional<std::string> tryGetString(int index) const override;
 
     [[nodiscard]] std::optional<std::string> tryGetString(std::string_view name) const override;
 
+    [[nodiscard]] std::optional<std::string> tryGetString(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(int index) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(
+        std::string_view name) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(
+        const ConfigKey& key) const override;
+
     [[nodiscard]] std::vector<std::string> getKeyList() const override;
 
+    [[nodiscard]] std::unique_ptr<ConfigItemCursor> getItems() const override;
+
+    [[nodiscard]] size_t getArraySize() const override;
+
+    [[nodiscard]] size_t copyValues(std::span<bool> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<double> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<int64_t> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<uint64_t> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<std::string> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<std::string_view> values) const override;
+
+    [[nodiscard]] ConfigSourcePointer freeze() const override;
+
+    [[nodiscard]] const KeyIndex& getKeyIndex() const override;
+
+    [[nodiscard]] const LuaState& getState() const noexcept { return *ref_.getState(); }
+
 private:
     struct SharedConstructTag final {
     };
 
+    class ItemCursor;
+
     template <typename T>
-    static ConfigSourcePointer load(const T& source);
+    static ConfigSourcePointer load(const T& source, const ConfigLoadOptions& options);
 
+    // Replaces a function on top of the stack with what it returns.
     [[nodiscard]] int invoke(int type) const;
 
-    [[nodiscard]] int getField(int index) const noexcept;
+    [[nodiscard]] int call(int type) const;
+
+    // Calls every function in the table on top of the stack, and in the tables it holds.
+    void invokeTable(std::unordered_set<const void*>& tables) const;
+
+    // Pushes the field without calling it if it is a function.
+    [[nodiscard]] int pushField(int index) const;
+
+    [[nodiscard]] int pushField(std::string_view name) const;
+
+    [[nodiscard]] int pushField(const ConfigKey& key) const;
 
-    [[nodiscard]] int getField(std::string_view name) const noexcept;
+    template <typename K>
+    [[nodiscard]] int getField(K key) const
+    {
+        return invoke(pushField(key));
+    }
+
+    // Takes the type of the field before invoke(), strings held by the table are not copied.
+    [[nodiscard]] std::optional<std::string_view> tryConvertToStringView(int type) const;
+
+    template <typename T, typename F>
+    [[nodiscard]] size_t copyValuesT(std::span<T> values, const F& convert) const;
 
     [[nodiscard]] ConfigSourcePointer tryConvertToChild(int type) const;
 
@@ -164,8 +307,16 @@ private:
 
     [[nodiscard]] std::optional<double> tryConvertToDouble(int type) const;
 
+    [[nodiscard]] std::optional<int64_t> tryConvertToNumber(int type) const;
+
+    [[nodiscard]] std::optional<uint64_t> tryConvertToUnsignedNumber(int type) const;
+
     [[nodiscard]] std::optional<std::string> tryConvertToString(int type) const;
 
+    void freezeValue(SnapshotBuilder& builder, int type, std::vector<const void*>& tables) const;
+
+    void freezeTable(SnapshotBuilder& builder, std::vector<const void*>& tables) const;
+
     LuaReference ref_;
 
 public:
@@ -0,0 +1,266 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "lua_heap.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace confetti::internal {
+
+// Lua expects the alignment of malloc().
+static constexpr size_t alignment = alignof(std::max_align_t);
+
+static constexpr size_t alignSize(size_t size) noexcept
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+LuaHeap::LuaHeap() noexcept
+    : chunks_{nullptr}
+    , capacity_{0}
+{
+}
+
+LuaHeap::~LuaHeap()
+{
+    while (chunks_ != nullptr)
+        std::free(std::exchange(chunks_, chunks_->next));
+}
+
+std::unique_ptr<LuaHeap> LuaHeap::create(LuaAllocator allocator)
+{
+    switch (allocator) {
+    case LuaAllocator::System:
+        break;
+    case LuaAllocator::Arena:
+        return std::make_unique<LuaArena>();
+    case LuaAllocator::SizeClass:
+        return std::make_unique<LuaSizeClassHeap>();
+    }
+    return {};
+}
+
+std::byte* LuaHeap::allocateChunk(size_t size) noexcept
+{
+    static_assert(sizeof(Chunk) % alignment == 0);
+    auto chunk = static_cast<Chunk*>(std::malloc(sizeof(Chunk) + size));
+    if (chunk == nullptr)
+        return nullptr;
+    chunk->next = chunks_;
+    chunk->size = size;
+    chunks_ = chunk;
+    capacity_ += size;
+    return reinterpret_cast<std::byte*>(chunk + 1);
+}
+
+std::byte* LuaHeap::adoptChunk(void* block, size_t size, size_t used) noexcept
+{
+    if (size < sizeof(Chunk) + used) {
+        size = sizeof(Chunk) + used;
+        block = std::realloc(block, size);
+        if (block == nullptr)
+            return nullptr;
+    }
+    auto chunk = static_cast<Chunk*>(block);
+    std::memmove(chunk + 1, chunk, used);
+    chunk->next = chunks_;
+    chunk->size = size - sizeof(Chunk);
+    chunks_ = chunk;
+    capacity_ += chunk->size;
+    return reinterpret_cast<std::byte*>(chunk + 1);
+}
+
+static constexpr size_t minChunkSize = 64 * 1024;
+static constexpr size_t maxChunkSize = 4 * 1024 * 1024;
+
+LuaArena::LuaArena() noexcept
+    : last_{nullptr}
+    , next_{nullptr}
+    , end_{nullptr}
+    , chunkSize_{minChunkSize}
+{
+}
+
+LuaArena::~LuaArena() = default;
+
+void* LuaArena::allocate(size_t size) noexcept
+{
+    size = alignSize(size);
+    if (size > chunkSize_ / 4) {
+        // Large blocks get a chunk of their own, so the current one is not wasted.
+        last_ = nullptr;
+        return allocateChunk(size);
+    }
+    if (static_cast<size_t>(end_ - next_) < size) {
+        auto chunk = allocateChunk(chunkSize_);
+        if (chunk == nullptr)
+            return nullptr;
+        next_ = chunk;
+        end_ = chunk + chunkSize_;
+        chunkSize_ = std::min(chunkSize_ * 2, maxChunkSize);
+    }
+    last_ = next_;
+    next_ += size;
+    return last_;
+}
+
+void* LuaArena::reallocate(void* ptr, size_t osize, size_t nsize) noexcept
+{
+    if (nsize == 0) {
+        if (ptr != nullptr && ptr == last_) {
+            next_ = last_;
+            last_ = nullptr;
+        }
+        return nullptr;
+    }
+    if (ptr == nullptr)
+        return allocate(nsize);
+    if (ptr == last_ && static_cast<size_t>(end_ - last_) >= alignSize(nsize)) {
+        next_ = last_ + alignSize(nsize);
+        return ptr;
+    }
+    if (nsize <= osize)
+        return ptr;
+    auto block = allocate(nsize);
+    if (block != nullptr)
+        std::memcpy(block, ptr, osize);
+    return block;
+}
+
+LuaSizeClassHeap::LuaSizeClassHeap() noexcept
+    : freeLists_{}
+    , next_{nullptr}
+    , end_{nullptr}
+{
+}
+
+LuaSizeClassHeap::~LuaSizeClassHeap() = default;
+
+void* LuaSizeClassHeap::allocate(size_t size) noexcept
+{
+    if (size > maxSize)
+        return std::malloc(size);
+    auto& list = freeLists_[getClass(size)];
+    if (list != nullptr)
+        return std::exchange(list, list->next);
+    size = (getClass(size) + 1) * granularity;
+    if (static_cast<size_t>(end_ - next_) < size) {
+        auto chunk = allocateChunk(minChunkSize);
+        if (chunk == nullptr)
+            return nullptr;
+        next_ = chunk;
+        end_ = chunk + minChunkSize;
+    }
+    return std::exchange(next_, next_ + size);
+}
+
+void LuaSizeClassHeap::deallocate(void* ptr, size_t size) noexcept
+{
+    if (size > maxSize) {
+        std::free(ptr);
+        return;
+    }
+    auto& list = freeLists_[getClass(size)];
+    auto block = static_cast<Block*>(ptr);
+    block->next = list;
+    list = block;
+}
+
+void* LuaSizeClassHeap::reallocate(void* ptr, size_t osize, size_t nsize) noexcept
+{
+    if (nsize == 0) {
+        if (ptr != nullptr)
+            deallocate(ptr, osize);
+        return nullptr;
+    }
+    if (ptr == nullptr)
+        return allocate(nsize);
+    if (osize > maxSize && nsize > maxSize)
+        return std::realloc(ptr, nsize);
+    if (osize <= maxSize && nsize <= maxSize && getClass(osize) == getClass(nsize))
+        return ptr;
+    auto block = allocate(nsize);
+    if (block == nullptr) {
+        // Lua assumes that shrinking never fails. A small block is big enough, but a
+        // large one from malloc() is going to be freed to a free list as a small one,
+        // so it becomes a chunk that lives as long as the heap.
+        if (nsize >= osize)
+            return nullptr;
+        if (osize <= maxSize)
+            return ptr;
+        return adoptChunk(ptr, osize, (getClass(nsize) + 1) * granularity);
+    }
+    std::memcpy(block, ptr, std::min(osize, nsize));
+    deallocate(ptr, osize);
+    return block;
+}
+
+LuaHandlePool::LuaHandlePool() noexcept
+    : free_{nullptr}
+    , freeCount_{0}
+    , blockSize_{0}
+    , used_{0}
+    , owned_{true}
+{
+}
+
+LuaHandlePool::~LuaHandlePool()
+{
+    while (free_ != nullptr)
+        ::operator delete(std::exchange(free_, free_->next));
+}
+
+LuaHandlePool* LuaHandlePool::create() { return new LuaHandlePool{}; }
+
+void LuaHandlePool::release() noexcept
+{
+    owned_ = false;
+    if (used_ == 0)
+        delete this;
+}
+
+void* LuaHandlePool::allocate(size_t size)
+{
+    if (blockSize_ == 0)
+        blockSize_ = std::max(size, sizeof(Block));
+    void* block;
+    if (size == blockSize_ && free_ != nullptr) {
+        block = std::exchange(free_, free_->next);
+        --freeCount_;
+    } else {
+        block = ::operator new(size);
+    }
+    ++used_;
+    return block;
+}
+
+void LuaHandlePool::deallocate(void* ptr, size_t size) noexcept
+{
+    --used_;
+    if (owned_ && size == blockSize_ && freeCount_ < maxFreeCount) {
+        free_ = new (ptr) Block{free_};
+        ++freeCount_;
+    } else {
+        ::operator delete(ptr);
+    }
+    if (!owned_ && used_ == 0)
+        delete this;
+}
+
+} // namespace confetti::internal
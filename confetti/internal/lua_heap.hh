@@ -0,0 +1,182 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_LUA_HEAP_HH
+#define CONFETTI_INTERNAL_LUA_HEAP_HH
+
+#include "../config_options.hh"
+#include <array>
+#include <cstddef>
+#include <memory>
+
+namespace confetti::internal {
+
+// Memory for a single Lua state, released in bulk when the heap is destroyed.
+// Follows the lua_Alloc contract: `osize` is the size of a block being resized
+// or freed, and a zero `nsize` frees it.
+class LuaHeap {
+public:
+    LuaHeap(const LuaHeap&) = delete;
+    LuaHeap& operator=(const LuaHeap&) = delete;
+
+    virtual ~LuaHeap();
+
+    // Returns nullptr for the system allocator, which needs no state.
+    [[nodiscard]] static std::unique_ptr<LuaHeap> create(LuaAllocator allocator);
+
+    [[nodiscard]] virtual void* reallocate(void* ptr, size_t osize, size_t nsize) noexcept = 0;
+
+    // Bytes reserved from the system.
+    [[nodiscard]] size_t getCapacity() const noexcept { return capacity_; }
+
+protected:
+    LuaHeap() noexcept;
+
+    [[nodiscard]] std::byte* allocateChunk(size_t size) noexcept;
+
+    // Makes a chunk of a `size` byte block from malloc(), keeping its first `used`
+    // bytes. Returns where they are now, or nullptr with the block left as it was.
+    [[nodiscard]] std::byte* adoptChunk(void* block, size_t size, size_t used) noexcept;
+
+private:
+    struct Chunk final {
+        Chunk* next;
+        size_t size;
+    };
+
+    Chunk* chunks_;
+    size_t capacity_;
+};
+
+class LuaArena final : public LuaHeap {
+public:
+    LuaArena() noexcept;
+
+    ~LuaArena() override;
+
+    [[nodiscard]] void* reallocate(void* ptr, size_t osize, size_t nsize) noexcept override;
+
+private:
+    [[nodiscard]] void* allocate(size_t size) noexcept;
+
+    std::byte* last_; // Most recent allocation, which can be resized or freed in place.
+    std::byte* next_;
+    std::byte* end_;
+    size_t chunkSize_;
+};
+
+class LuaSizeClassHeap final : public LuaHeap {
+public:
+    LuaSizeClassHeap() noexcept;
+
+    ~LuaSizeClassHeap() override;
+
+    [[nodiscard]] void* reallocate(void* ptr, size_t osize, size_t nsize) noexcept override;
+
+private:
+    static constexpr size_t granularity = 16;
+    static constexpr size_t maxSize = 512; // Larger blocks go to the system allocator.
+
+    struct Block final {
+        Block* next;
+    };
+
+    [[nodiscard]] static size_t getClass(size_t size) noexcept { return (size - 1) / granularity; }
+
+    [[nodiscard]] void* allocate(size_t size) noexcept;
+
+    void deallocate(void* ptr, size_t size) noexcept;
+
+    std::array<Block*, maxSize / granularity> freeLists_;
+    std::byte* next_;
+    std::byte* end_;
+};
+
+// Recycles the blocks of handles to Lua tables, so that walking a tree does not go
+// to the system allocator for every child. The pool is owned by a Lua state, but
+// stays alive until the last handle is gone, which may be after the state itself.
+// Not thread safe, just like the Lua state.
+class LuaHandlePool final {
+public:
+    LuaHandlePool(const LuaHandlePool&) = delete;
+    LuaHandlePool& operator=(const LuaHandlePool&) = delete;
+
+    [[nodiscard]] static LuaHandlePool* create();
+
+    // Called by the owner instead of deleting the pool.
+    void release() noexcept;
+
+    [[nodiscard]] void* allocate(size_t size);
+
+    void deallocate(void* ptr, size_t size) noexcept;
+
+    [[nodiscard]] size_t getFreeCount() const noexcept { return freeCount_; }
+
+private:
+    static constexpr size_t maxFreeCount = 1024;
+
+    struct Block final {
+        Block* next;
+    };
+
+    LuaHandlePool() noexcept;
+
+    ~LuaHandlePool();
+
+    Block* free_;
+    size_t freeCount_;
+    size_t blockSize_; // Size of the first block, handles are all of the same type.
+    size_t used_;
+    bool owned_;
+};
+
+// Standard allocator on top of a handle pool, for std::allocate_shared().
+template <typename T>
+class LuaHandleAllocator final {
+public:
+    using value_type = T;
+
+    explicit LuaHandleAllocator(LuaHandlePool* pool) noexcept
+        : pool_{pool}
+    {
+    }
+
+    template <typename U>
+    LuaHandleAllocator(const LuaHandleAllocator<U>& other) noexcept // NOLINT
+        : pool_{other.pool_}
+    {
+    }
+
+    [[nodiscard]] T* allocate(size_t n) { return static_cast<T*>(pool_->allocate(n * sizeof(T))); }
+
+    void deallocate(T* ptr, size_t n) noexcept { pool_->deallocate(ptr, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const LuaHandleAllocator<U>& other) const noexcept
+    {
+        return pool_ == other.pool_;
+    }
+
+private:
+    template <typename U>
+    friend class LuaHandleAllocator;
+
+    LuaHandlePool* pool_;
+};
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_LUA_HEAP_HH
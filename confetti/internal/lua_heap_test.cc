@@ -0,0 +1,134 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "lua_heap.hh"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using confetti::LuaAllocator;
+using confetti::internal::LuaHeap;
+
+namespace {
+
+struct Block final {
+    void* data;
+    size_t size;
+    unsigned char fill;
+};
+
+// Resizes and frees blocks at random the way Lua does, checking that contents survive.
+void exercise(LuaHeap& heap)
+{
+    std::mt19937 random{42};
+    std::vector<Block> blocks;
+    for (int i = 0; i < 20000; ++i) {
+        const auto action = random() % 4;
+        if (action < 2 || blocks.empty()) {
+            const size_t size = 1 + random() % (random() % 8 ? 128 : 4096);
+            auto data = heap.reallocate(nullptr, 0, size);
+            ASSERT_NE(nullptr, data);
+            ASSERT_EQ(0, reinterpret_cast<uintptr_t>(data) % alignof(std::max_align_t));
+            const auto fill = static_cast<unsigned char>(i);
+            std::memset(data, fill, size);
+            blocks.push_back({data, size, fill});
+            continue;
+        }
+        auto& block = blocks[random() % blocks.size()];
+        const auto copied = std::string(static_cast<const char*>(block.data), block.size);
+        ASSERT_EQ(std::string(block.size, static_cast<char>(block.fill)), copied);
+        if (action == 2) {
+            const size_t size = 1 + random() % 1024;
+            auto data = heap.reallocate(block.data, block.size, size);
+            ASSERT_NE(nullptr, data);
+            ASSERT_EQ(0, std::memcmp(data, copied.data(), std::min(size, block.size)));
+            std::memset(data, block.fill, size);
+            block.data = data;
+            block.size = size;
+        } else {
+            EXPECT_EQ(nullptr, heap.reallocate(block.data, block.size, 0));
+            block = blocks.back();
+            blocks.pop_back();
+        }
+    }
+    for (auto& block : blocks)
+        EXPECT_EQ(nullptr, heap.reallocate(block.data, block.size, 0));
+}
+
+} // namespace
+
+TEST(LuaHeap, Create)
+{
+    EXPECT_FALSE(LuaHeap::create(LuaAllocator::System));
+    EXPECT_TRUE(LuaHeap::create(LuaAllocator::Arena));
+    EXPECT_TRUE(LuaHeap::create(LuaAllocator::SizeClass));
+}
+
+TEST(LuaHeap, Arena)
+{
+    auto heap = LuaHeap::create(LuaAllocator::Arena);
+    exercise(*heap);
+    EXPECT_LT(0, heap->getCapacity());
+
+    // The most recent block is resized and freed in place.
+    const auto capacity = heap->getCapacity();
+    auto data = heap->reallocate(nullptr, 0, 16);
+    EXPECT_EQ(data, heap->reallocate(data, 16, 64));
+    EXPECT_EQ(nullptr, heap->reallocate(data, 64, 0));
+    EXPECT_EQ(data, heap->reallocate(nullptr, 0, 32));
+    EXPECT_EQ(capacity, heap->getCapacity());
+}
+
+TEST(LuaHeap, SizeClass)
+{
+    auto heap = LuaHeap::create(LuaAllocator::SizeClass);
+    exercise(*heap);
+    EXPECT_LT(0, heap->getCapacity());
+
+    // Freed blocks are reused, and resizing within a size class does not move.
+    const auto capacity = heap->getCapacity();
+    auto data = heap->reallocate(nullptr, 0, 20);
+    EXPECT_EQ(data, heap->reallocate(data, 20, 32));
+    EXPECT_EQ(nullptr, heap->reallocate(data, 32, 0));
+    EXPECT_EQ(data, heap->reallocate(nullptr, 0, 17));
+    EXPECT_EQ(capacity, heap->getCapacity());
+}
+
+TEST(LuaHeap, HandlePool)
+{
+    using confetti::internal::LuaHandleAllocator;
+    using confetti::internal::LuaHandlePool;
+
+    auto pool = LuaHandlePool::create();
+    const LuaHandleAllocator<std::string> allocator{pool};
+
+    // Blocks of released handles are reused.
+    auto first = std::allocate_shared<std::string>(allocator, "first");
+    auto block = first.get();
+    first.reset();
+    EXPECT_EQ(1, pool->getFreeCount());
+    auto second = std::allocate_shared<std::string>(allocator, "second");
+    EXPECT_EQ(block, second.get());
+    EXPECT_EQ(0, pool->getFreeCount());
+
+    // Handles may outlive the owner of the pool.
+    pool->release();
+    EXPECT_EQ("second", *second);
+    second.reset();
+}
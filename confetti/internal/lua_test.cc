@@ -15,6 +15,7 @@
 //
 
 #include "lua.hh"
+#include "key_index.hh"
 
 extern "C" {
 #include <lauxlib.h>
@@ -94,6 +95,26 @@ TEST(LuaState, RunCode)
     EXPECT_THROW(state.run(R"!(wrong syntax)!"sv), confetti::internal::LuaException);
 }
 
+TEST(LuaState, Allocators)
+{
+    using confetti::LuaAllocator;
+    for (auto allocator : {LuaAllocator::System, LuaAllocator::Arena, LuaAllocator::SizeClass}) {
+        auto source = confetti::internal::LuaSource::loadCode(R"!(
+local t = {}
+for i = 1, 10000 do t[i] = {name = "item-" .. i, value = i * 2} end
+confetti.items = t
+collectgarbage()
+)!",
+            confetti::ConfigLoadOptions{allocator});
+        auto items = source->tryGetChild("items");
+        ASSERT_TRUE(items);
+        auto item = items->tryGetChild(9999);
+        ASSERT_TRUE(item);
+        EXPECT_EQ("item-10000", item->tryGetString("name").value());
+        EXPECT_EQ(20000, item->tryGetNumber("value").value());
+    }
+}
+
 static decltype(auto) loadTestFile()
 {
     return confetti::internal::LuaSource::loadFile(
@@ -163,6 +184,22 @@ TEST(LuaTree, Number)
     EXPECT_FALSE(source->tryGetUnsignedNumber("this_key_should_not_exist"));
 }
 
+TEST(LuaTree, ExactIntegers)
+{
+    auto source = confetti::internal::LuaSource::loadCode(R"!(
+confetti.id = 9007199254740993
+confetti.text = "9223372036854775807"
+confetti.mask = "18446744073709551615"
+confetti.negative = -1
+)!");
+    EXPECT_EQ(9007199254740993, source->tryGetNumber("id").value());
+    EXPECT_EQ(9007199254740993U, source->tryGetUnsignedNumber("id").value());
+    EXPECT_EQ(INT64_MAX, source->tryGetNumber("text").value());
+    EXPECT_EQ(UINT64_MAX, source->tryGetUnsignedNumber("mask").value());
+    EXPECT_EQ(UINT64_MAX, source->tryGetUnsignedNumber("negative").value());
+    EXPECT_THROW((void)source->tryGetNumber("mask"), std::range_error);
+}
+
 TEST(LuaTree, String)
 {
     auto source = loadTestFile();
@@ -181,6 +218,183 @@ TEST(LuaTree, String)
     EXPECT_EQ("6", source->tryGetString("simple_nested_func").value());
 }
 
+TEST(LuaTree, StringView)
+{
+    auto source = loadTestFile();
+    const auto text = source->tryGetStringView("simple_string").value();
+    EXPECT_EQ("Hello, Lua!", text);
+    EXPECT_EQ(text.data(), source->tryGetStringView(confetti::ConfigKey{"simple_string"})->data());
+    EXPECT_EQ("12345", source->tryGetStringView("simple_number").value());
+    EXPECT_EQ("4", source->tryGetStringView("simple_func").value());
+    EXPECT_EQ("Monday", source->tryGetChild("days")->tryGetStringView(0).value());
+    EXPECT_FALSE(source->tryGetStringView("user"));
+    EXPECT_FALSE(source->tryGetStringView("this_key_should_not_exist"));
+}
+
+TEST(LuaTree, BulkValues)
+{
+    auto source = confetti::internal::LuaSource::loadCode(R"!(
+local weights = {}
+for i = 1, 100000 do weights[i] = i / 4 end
+confetti.weights = weights
+confetti.mixed = {1, "2", function() return 3 end, {}, 5}
+)!");
+    auto weights = source->tryGetChild("weights");
+    ASSERT_TRUE(weights);
+    EXPECT_EQ(100000, weights->getArraySize());
+    std::vector<double> values(100000);
+    EXPECT_EQ(100000, weights->copyValues(std::span<double>{values}));
+    EXPECT_DOUBLE_EQ(25000.0, values.back());
+
+    auto mixed = source->tryGetChild("mixed");
+    ASSERT_TRUE(mixed);
+    EXPECT_EQ(5, mixed->getArraySize());
+    std::vector<int64_t> numbers(5);
+    EXPECT_EQ(3, mixed->copyValues(std::span<int64_t>{numbers}));
+    EXPECT_EQ(3, numbers[2]);
+    std::vector<std::string_view> views(5);
+    EXPECT_EQ(3, mixed->copyValues(std::span<std::string_view>{views}));
+    EXPECT_EQ("2", views[1]);
+}
+
+TEST(LuaTree, Items)
+{
+    auto source = confetti::internal::LuaSource::loadCode(R"!(
+confetti.section = {
+    "array element",
+    name = "section",
+    port = 8080,
+    lazy = function() return "called" end,
+    child = {key = "value"},
+}
+)!");
+    auto section = source->tryGetChild("section");
+    ASSERT_TRUE(section);
+    std::vector<std::string> keys;
+    auto cursor = section->getItems();
+    while (cursor->next()) {
+        keys.emplace_back(cursor->getKey());
+        // Reads in between steps must not disturb the traversal.
+        EXPECT_EQ("section", section->tryGetString("name").value());
+        if (cursor->getKey() == "port") {
+            EXPECT_EQ(8080, cursor->getNumber().value());
+            EXPECT_EQ("8080", cursor->getStringView().value());
+        } else if (cursor->getKey() == "lazy") {
+            EXPECT_EQ("called", cursor->getString().value());
+        } else if (cursor->getKey() == "child") {
+            auto child = cursor->getChild();
+            ASSERT_TRUE(child);
+            EXPECT_EQ("value", child->tryGetString("key").value());
+        } else {
+            EXPECT_EQ("section", cursor->getStringView().value());
+            EXPECT_FALSE(cursor->getChild());
+        }
+    }
+    EXPECT_THAT(keys, testing::UnorderedElementsAre("name", "port", "lazy", "child"));
+}
+
+TEST(LuaTree, MixedKeys)
+{
+    auto source = confetti::internal::LuaSource::loadCode(R"!(
+confetti.mixed = {"first", "second", [5] = "five", [2.5] = "half", [0] = "zero", name = "mixed"}
+)!");
+    auto mixed = source->tryGetChild("mixed");
+    ASSERT_TRUE(mixed);
+    const auto keys = mixed->getKeyList();
+    EXPECT_THAT(keys, testing::UnorderedElementsAre("5", "2.5", "0", "name"));
+
+    std::vector<std::string> items;
+    auto cursor = mixed->getItems();
+    while (cursor->next()) {
+        items.emplace_back(cursor->getKey());
+        if (cursor->getKey() == "5")
+            EXPECT_EQ("five", cursor->getStringView().value());
+    }
+    EXPECT_THAT(items, testing::UnorderedElementsAreArray(keys));
+    EXPECT_THAT(mixed->freeze()->getKeyList(), testing::UnorderedElementsAreArray(keys));
+    EXPECT_EQ(2, mixed->getArraySize());
+}
+
+TEST(LuaTree, FunctionResults)
+{
+    using confetti::LuaFunctions;
+    static const char* code = R"!(
+calls = 0
+local function count() calls = calls + 1 return calls end
+confetti.count = count
+confetti.pool = {size = function() calls = calls + 1 return "size " .. calls end, again = count}
+confetti.empty = function() calls = calls + 1 end
+)!";
+    auto everyTime = confetti::internal::LuaSource::loadCode(code);
+    EXPECT_EQ(1, everyTime->tryGetNumber("count").value());
+    EXPECT_EQ(2, everyTime->tryGetNumber("count").value());
+
+    auto once = confetti::internal::LuaSource::loadCode(
+        code, confetti::ConfigLoadOptions{confetti::LuaAllocator::System, LuaFunctions::Once});
+    EXPECT_EQ(1, once->tryGetNumber("count").value());
+    EXPECT_EQ(1, once->tryGetNumber(confetti::ConfigKey{"count"}).value());
+    auto pool = once->tryGetChild("pool");
+    ASSERT_TRUE(pool);
+    EXPECT_EQ(1, pool->tryGetNumber("again").value());
+    const auto size = pool->tryGetStringView("size").value();
+    EXPECT_EQ("size 2", size);
+    EXPECT_EQ(size.data(), pool->tryGetStringView("size")->data());
+    // Nil is not kept, so the function runs again.
+    EXPECT_FALSE(once->tryGetString("empty"));
+    EXPECT_FALSE(once->tryGetString("empty"));
+    EXPECT_EQ("size 2", pool->tryGetString("size").value());
+
+    auto eager = confetti::internal::LuaSource::loadCode(
+        code, confetti::ConfigLoadOptions{confetti::LuaAllocator::System, LuaFunctions::Eager});
+    const auto first = eager->tryGetNumber("count").value();
+    const auto second = eager->tryGetChild("pool")->tryGetString("size").value();
+    EXPECT_NE(first, std::stoll(second.substr(5)));
+    EXPECT_EQ(first, eager->tryGetNumber("count").value());
+    EXPECT_EQ(second, eager->tryGetChild("pool")->tryGetString("size").value());
+    EXPECT_EQ(first, eager->tryGetChild("pool")->tryGetNumber("again").value());
+    EXPECT_EQ(second, eager->freeze()->tryGetChild("pool")->tryGetString("size").value());
+}
+
+TEST(LuaTree, EagerFunctionsManyTables)
+{
+    constexpr auto code = R"!(
+calls = 0
+local shared = {port = function() calls = calls + 1 return 80 end}
+confetti.servers = {}
+for i = 1, 20000 do
+    confetti.servers[i] = {id = function() return i end, shared = shared}
+end
+confetti.shared = shared
+)!";
+    auto eager = confetti::internal::LuaSource::loadCode(
+        code, confetti::ConfigLoadOptions{confetti::LuaAllocator::System, LuaFunctions::Eager});
+    auto servers = eager->tryGetChild("servers");
+    ASSERT_TRUE(servers);
+    EXPECT_EQ(1, servers->tryGetChild(0)->tryGetNumber("id").value());
+    EXPECT_EQ(20000, servers->tryGetChild(19999)->tryGetNumber("id").value());
+    EXPECT_EQ(80, servers->tryGetChild(7)->tryGetChild("shared")->tryGetNumber("port").value());
+    EXPECT_EQ(80, eager->tryGetChild("shared")->tryGetNumber("port").value());
+}
+
+TEST(LuaTree, KeyIndex)
+{
+    auto source = confetti::internal::LuaSource::loadCode(R"!(
+calls = 0
+confetti.pool = {size = 1, computed = function() calls = calls + 1 return {inner = 1} end}
+confetti.count = function() calls = calls + 1 return calls end
+)!");
+    auto pool = source->tryGetChild("pool");
+    ASSERT_TRUE(pool);
+    const auto& index = pool->getKeyIndex();
+    EXPECT_EQ(2, index.size());
+    EXPECT_EQ("size", index.suggest("szie"));
+    // Handles are made for every lookup, the index is kept for the table.
+    EXPECT_EQ(&index, &source->tryGetChild("pool")->getKeyIndex());
+    EXPECT_EQ(4, source->getKeyIndex().size());
+    // Indexing runs no functions.
+    EXPECT_EQ(1, source->tryGetNumber("count").value());
+}
+
 TEST(LuaTree, StringByIndex)
 {
     static const char* values[]
@@ -202,3 +416,25 @@ TEST(LuaTree, Child)
     EXPECT_EQ("Vlad Lazarenko", userTree->tryGetString("name").value());
     EXPECT_EQ("vlad@lazarenko.me", userTree->tryGetString("email").value());
 }
+
+TEST(LuaTree, ConfigKey)
+{
+    using confetti::ConfigKey;
+    auto source = loadTestFile();
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ("Hello, Lua!", source->tryGetString(ConfigKey{"simple_string"}).value());
+        EXPECT_DOUBLE_EQ(19.86, source->tryGetDouble(ConfigKey{"simple_double_number"}).value());
+        EXPECT_TRUE(source->tryGetBoolean(ConfigKey{"simple_yes"}).value());
+        EXPECT_EQ("4", source->tryGetString(ConfigKey{"simple_func"}).value());
+        EXPECT_FALSE(source->tryGetString(ConfigKey{"this_key_should_not_exist"}));
+        auto user = source->tryGetChild(ConfigKey{"user"});
+        ASSERT_TRUE(user);
+        EXPECT_EQ("Vlad Lazarenko", user->tryGetString(ConfigKey{"name"}).value());
+    }
+
+    // A key whose hash belongs to another name is still looked up by its own name.
+    const ConfigKey collision{"email", ConfigKey{"name"}.getHash()};
+    auto user = source->tryGetChild("user");
+    EXPECT_EQ("vlad@lazarenko.me", user->tryGetString(collision).value());
+    EXPECT_EQ("Vlad Lazarenko", user->tryGetString(ConfigKey{"name"}).value());
+}
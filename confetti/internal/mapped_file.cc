@@ -0,0 +1,71 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "mapped_file.hh"
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace confetti::internal {
+
+[[noreturn]] static void throwSystemError(const char* what, const std::filesystem::path& file)
+{
+    throw std::system_error{
+        errno, std::generic_category(), std::string{what}.append(" ").append(file.native())};
+}
+
+MappedFile::MappedFile(const std::filesystem::path& file, Access access)
+    : data_{nullptr}
+    , size_{0}
+{
+    const auto fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throwSystemError("Cannot open", file);
+
+    struct stat info {
+    };
+    if (::fstat(fd, &info) != 0) {
+        const auto error = errno;
+        ::close(fd);
+        errno = error;
+        throwSystemError("Cannot stat", file);
+    }
+
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ != 0) {
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data_ == MAP_FAILED) {
+            const auto error = errno;
+            ::close(fd);
+            errno = error;
+            throwSystemError("Cannot map", file);
+        }
+        ::madvise(data_, size_, access == Access::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (size_ != 0)
+        ::munmap(data_, size_);
+}
+
+} // namespace confetti::internal
@@ -0,0 +1,57 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_MAPPED_FILE_HH
+#define CONFETTI_INTERNAL_MAPPED_FILE_HH
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+namespace confetti::internal {
+
+// Read-only memory mapping of a whole file.
+class MappedFile final {
+public:
+    // How the mapping is going to be read, passed to the kernel as a hint.
+    enum class Access {
+        // Parsed from start to end.
+        Sequential,
+
+        // Looked up in place.
+        Random,
+    };
+
+    explicit MappedFile(const std::filesystem::path& file, Access access = Access::Sequential);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    [[nodiscard]] std::string_view getData() const noexcept
+    {
+        return {static_cast<const char*>(data_), size_};
+    }
+
+private:
+    void* data_;
+    size_t size_;
+};
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_MAPPED_FILE_HH
@@ -0,0 +1,155 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "overrides.hh"
+#include "convert.hh"
+#include "snapshot.hh"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <string>
+#include <vector>
+
+namespace confetti::internal {
+
+namespace {
+
+struct Override final {
+    std::vector<std::string> path;
+    std::string_view value;
+};
+
+} // namespace
+
+// Values are typed once here, so reads do not parse them again. Numbers are typed only
+// if they read back as the same text, as "08080" or "1.10" are likely not numbers.
+static void addValue(SnapshotBuilder& builder, std::string_view text)
+{
+    if (text == "true" || text == "false") {
+        builder.addBoolean(text == "true");
+        return;
+    }
+    const auto* end = text.data() + text.size();
+    int64_t integer{};
+    if (auto [ptr, error] = std::from_chars(text.data(), end, integer);
+        error == std::errc{} && ptr == end && formatNumber(integer) == text) {
+        builder.addInteger(integer);
+        return;
+    }
+    double number{};
+    if (auto [ptr, error] = std::from_chars(text.data(), end, number);
+        error == std::errc{} && ptr == end && formatNumber(number) == text) {
+        builder.addDouble(number);
+        return;
+    }
+    builder.addString(text);
+}
+
+// Overrides are sorted by path, so those under the same key are next to each other,
+// with the one for the key itself first. A key with paths below it is a table, else
+// the last value for it wins.
+static void addTable(SnapshotBuilder& builder, std::span<const Override> overrides, size_t depth)
+{
+    builder.beginTable();
+    for (size_t begin = 0; begin < overrides.size();) {
+        const auto& key = overrides[begin].path[depth];
+        auto end = begin + 1;
+        while (end < overrides.size() && overrides[end].path[depth] == key)
+            ++end;
+        auto nested = begin;
+        while (nested < end && overrides[nested].path.size() == depth + 1)
+            ++nested;
+        builder.setKey(key);
+        if (nested < end) {
+            addTable(builder, overrides.subspan(nested, end - nested), depth + 1);
+        } else {
+            addValue(builder, overrides[end - 1].value);
+        }
+        begin = end;
+    }
+    builder.endTable();
+}
+
+static ConfigSourcePointer build(std::vector<Override>& overrides)
+{
+    std::stable_sort(overrides.begin(), overrides.end(),
+        [](const Override& lhs, const Override& rhs) { return lhs.path < rhs.path; });
+    SnapshotBuilder builder;
+    addTable(builder, overrides, 0);
+    return builder.finish()->getRootSource();
+}
+
+// Splits at every separator. Returns nothing if any segment is empty.
+static std::vector<std::string> splitPath(std::string_view path, std::string_view separator)
+{
+    std::vector<std::string> result;
+    for (;;) {
+        const auto end = path.find(separator);
+        const auto segment = path.substr(0, end);
+        if (segment.empty())
+            return {};
+        result.emplace_back(segment);
+        if (end == std::string_view::npos)
+            return result;
+        path.remove_prefix(end + separator.size());
+    }
+}
+
+ConfigSourcePointer loadEnvironment(
+    std::string_view prefix, std::span<const char* const> variables)
+{
+    const std::string head = std::string{prefix} + "__";
+    std::vector<Override> overrides;
+    for (const auto* variable : variables) {
+        const std::string_view entry{variable};
+        const auto equals = entry.find('=');
+        if (equals == std::string_view::npos || !entry.starts_with(head))
+            continue;
+        auto path = splitPath(entry.substr(head.size(), equals - head.size()), "__");
+        if (path.empty())
+            continue;
+        for (auto& segment : path) {
+            std::transform(segment.begin(), segment.end(), segment.begin(),
+                [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        }
+        overrides.push_back(Override{std::move(path), entry.substr(equals + 1)});
+    }
+    return build(overrides);
+}
+
+ConfigSourcePointer loadArguments(std::span<const char* const> arguments)
+{
+    std::vector<Override> overrides;
+    for (const auto* argument : arguments) {
+        std::string_view option{argument};
+        if (option == "--")
+            break;
+        if (!option.starts_with("--"))
+            continue;
+        option.remove_prefix(2);
+        const auto equals = option.find('=');
+        auto path = splitPath(option.substr(0, equals), ".");
+        if (path.empty())
+            continue;
+        std::string_view value{"true"};
+        if (equals != std::string_view::npos)
+            value = option.substr(equals + 1);
+        overrides.push_back(Override{std::move(path), value});
+    }
+    return build(overrides);
+}
+
+} // namespace confetti::internal
@@ -0,0 +1,38 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_OVERRIDES_HH
+#define CONFETTI_INTERNAL_OVERRIDES_HH
+
+#include "../config_source.hh"
+#include <span>
+#include <string_view>
+
+namespace confetti::internal {
+
+// Builds a tree out of "NAME=value" environment entries named after the prefix and
+// path segments, all separated by "__", such as APP__SERVER__PORT for server.port
+// with prefix APP. Segments are lowercased. Other entries are ignored.
+[[nodiscard]] ConfigSourcePointer loadEnvironment(
+    std::string_view prefix, std::span<const char* const> variables);
+
+// Builds a tree out of "--server.port=8080" arguments. "--name" alone is true, other
+// arguments are ignored, and "--" ends the options.
+[[nodiscard]] ConfigSourcePointer loadArguments(std::span<const char* const> arguments);
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_OVERRIDES_HH
@@ -0,0 +1,76 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "overrides.hh"
+#include "../config_tree.hh"
+#include "../overlay_config.hh"
+#include <gmock/gmock.h>
+#include <cstdlib>
+
+using confetti::ConfigPath;
+
+TEST(Overrides, Environment)
+{
+    const char* variables[] = {"PATH=/usr/bin", "APP__SERVER__PORT=8080",
+        "APP__SERVER__HOST=localhost", "APP__MAX_CONNECTIONS=100", "APP__DEBUG=true",
+        "APP__RATIO=0.25", "APP__VERSION=1.10", "APP__ZIP=08080", "APP____BAD=1", "APPX__A=1",
+        "APP__EMPTY=", "APP__SERVER__PORT=9090"};
+    const confetti::ConfigTree tree{confetti::internal::loadEnvironment("APP", variables)};
+
+    EXPECT_EQ(9090, tree.get<int>(ConfigPath{"server.port"}));
+    EXPECT_EQ("localhost", tree.get<std::string>(ConfigPath{"server.host"}));
+    EXPECT_EQ(100, tree.get<int>("max_connections"));
+    EXPECT_TRUE(tree.get<bool>("debug"));
+    EXPECT_EQ(0.25, tree.get<double>("ratio"));
+    EXPECT_EQ("1.10", tree.get<std::string>("version"));
+    EXPECT_EQ("08080", tree.get<std::string>("zip"));
+    EXPECT_EQ("", tree.get<std::string>("empty"));
+    EXPECT_FALSE(tree.tryGet<std::string>("path"));
+    EXPECT_FALSE(tree.tryGetChild("a"));
+    EXPECT_TRUE(tree.isThreadSafe());
+    EXPECT_EQ("9090", tree["server"].get<std::string>("port"));
+}
+
+TEST(Overrides, Arguments)
+{
+    const char* arguments[] = {"input.txt", "--server.port=8080", "--verbose", "-x",
+        "--server.tls.cert=/etc/cert.pem", "--server=ignored", "--.bad=1", "--", "--after=1"};
+    const confetti::ConfigTree tree{confetti::internal::loadArguments(arguments)};
+
+    // Paths below a key win over a value for it.
+    EXPECT_EQ(8080, tree.get<int>(ConfigPath{"server.port"}));
+    EXPECT_EQ("/etc/cert.pem", tree.get<std::string>(ConfigPath{"server.tls.cert"}));
+    EXPECT_TRUE(tree.get<bool>("verbose"));
+    EXPECT_FALSE(tree.tryGet<std::string>("after"));
+    EXPECT_FALSE(tree.tryGet<std::string>("x"));
+}
+
+TEST(Overrides, ComposeWithLayers)
+{
+    ASSERT_EQ(0, setenv("CONFETTI_TEST__SERVER__PORT", "8081", 1));
+    const char* argv[] = {"program", "--server.host=example.com"};
+    confetti::OverlayConfig config{{
+        {"environment", confetti::ConfigTree::loadEnvironment("CONFETTI_TEST")},
+        {"arguments", confetti::ConfigTree::loadArguments(2, argv)},
+    }};
+    unsetenv("CONFETTI_TEST__SERVER__PORT");
+
+    const auto tree = config.getTree();
+    EXPECT_EQ(8081, tree.get<int>(ConfigPath{"server.port"}));
+    EXPECT_EQ("example.com", tree.get<std::string>(ConfigPath{"server.host"}));
+    EXPECT_EQ("environment", config.findLayer(ConfigPath{"server.port"}));
+    EXPECT_FALSE(confetti::ConfigTree::loadArguments(0, nullptr).tryGetChild("server"));
+}
@@ -0,0 +1,68 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_PATH_HH
+#define CONFETTI_INTERNAL_PATH_HH
+
+#include "../config_key.hh"
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+namespace confetti::internal {
+
+[[nodiscard]] constexpr bool isValidPath(
+    std::string_view path, std::string_view separators) noexcept
+{
+    std::string_view::size_type begin = 0;
+    for (;;) {
+        const auto end = path.find_first_of(separators, begin);
+        if (end == begin || (end == std::string_view::npos && begin == path.size()))
+            return false;
+        if (end == std::string_view::npos)
+            return true;
+        begin = end + 1;
+    }
+}
+
+[[nodiscard]] constexpr size_t countPathSegments(
+    std::string_view path, std::string_view separators) noexcept
+{
+    size_t count = 1;
+    for (auto c : path) {
+        if (separators.find(c) != std::string_view::npos)
+            ++count;
+    }
+    return count;
+}
+
+template <size_t N>
+[[nodiscard]] constexpr std::array<ConfigKey, N> splitPath(
+    std::string_view path, std::string_view separators) noexcept
+{
+    std::array<ConfigKey, N> keys;
+    std::string_view::size_type begin = 0;
+    for (auto& key : keys) {
+        const auto end = path.find_first_of(separators, begin);
+        key = ConfigKey{path.substr(begin, end - begin)};
+        begin = end + 1;
+    }
+    return keys;
+}
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_PATH_HH
@@ -0,0 +1,904 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "snapshot.hh"
+#include "convert.hh"
+#include "hash.hh"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace confetti::internal {
+
+SnapshotImage::SnapshotImage(
+    std::vector<uint64_t> nodes, std::string strings, uint64_t root, uint32_t tableCount)
+    : nodeBuffer_{std::move(nodes)}
+    , stringBuffer_{std::move(strings)}
+    , nodes_{reinterpret_cast<const std::byte*>(nodeBuffer_.data())}
+    , strings_{stringBuffer_.data()}
+    , nodeSize_{nodeBuffer_.size() * sizeof(uint64_t)}
+    , stringSize_{stringBuffer_.size()}
+    , root_{root}
+    , tableCount_{tableCount}
+    , sources_{new std::atomic<SnapshotSource*>[tableCount]}
+{
+    for (uint32_t i = 0; i < tableCount_; ++i)
+        sources_[i].store(nullptr, std::memory_order_relaxed);
+}
+
+static constexpr char fileMagic[8] = {'C', 'O', 'N', 'F', 'E', 'T', 'T', 'I'};
+static constexpr uint32_t fileByteOrder = 0x01020304;
+
+static SnapshotFileHeader readHeader(std::string_view data, std::string_view name)
+{
+    auto fail = [name](std::string_view message) {
+        throw std::runtime_error{std::string{name} + ": " + std::string{message}};
+    };
+
+    SnapshotFileHeader header;
+    if (data.size() < sizeof(header))
+        fail("Not a compiled configuration");
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0)
+        fail("Not a compiled configuration");
+    if (header.byteOrder != fileByteOrder)
+        fail("Compiled configuration has a different byte order");
+    if (header.version != SnapshotImage::fileVersion)
+        fail("Unsupported compiled configuration version " + std::to_string(header.version));
+
+    const auto size = data.size() - sizeof(header);
+    if (header.nodeSize > size || header.stringSize != size - header.nodeSize
+        || header.nodeSize % sizeof(uint64_t) != 0 || header.nodeSize < sizeof(SnapshotTable)
+        || header.root > header.nodeSize - sizeof(SnapshotTable)
+        || header.tableCount > header.nodeSize / sizeof(SnapshotTable)
+        || (header.stringSize != 0 && data.back() != '\0')) {
+        fail("Compiled configuration is truncated or corrupt");
+    }
+    return header;
+}
+
+SnapshotImage::SnapshotImage(std::unique_ptr<MappedFile> file, std::string_view name)
+    : file_{std::move(file)}
+    , nodes_{nullptr}
+    , strings_{nullptr}
+    , nodeSize_{0}
+    , stringSize_{0}
+    , root_{0}
+    , tableCount_{0}
+{
+    const auto data = file_->getData();
+    const auto header = readHeader(data, name);
+    nodes_ = reinterpret_cast<const std::byte*>(data.data() + sizeof(header));
+    strings_ = data.data() + sizeof(header) + header.nodeSize;
+    nodeSize_ = header.nodeSize;
+    stringSize_ = header.stringSize;
+    root_ = header.root;
+    tableCount_ = header.tableCount;
+    sources_.reset(new std::atomic<SnapshotSource*>[tableCount_]);
+    for (uint32_t i = 0; i < tableCount_; ++i)
+        sources_[i].store(nullptr, std::memory_order_relaxed);
+}
+
+SnapshotImagePointer SnapshotImage::loadFile(const std::filesystem::path& file)
+{
+    return std::make_shared<SnapshotImage>(std::make_unique<MappedFile>(file, MappedFile::Access::Random), file.native());
+}
+
+void SnapshotImage::saveFile(const std::filesystem::path& file, const SnapshotTable& root) const
+{
+    SnapshotFileHeader header{};
+    std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.byteOrder = fileByteOrder;
+    header.root = static_cast<uint64_t>(reinterpret_cast<const std::byte*>(&root) - nodes_);
+    header.nodeSize = nodeSize_;
+    header.stringSize = stringSize_;
+    header.tableCount = tableCount_;
+
+    // Write next to the target and rename, so readers never map a partial file.
+    auto temp = file;
+    temp += ".tmp";
+    {
+        std::ofstream stream{temp, std::ios::binary | std::ios::trunc};
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(
+            reinterpret_cast<const char*>(nodes_), static_cast<std::streamsize>(nodeSize_));
+        stream.write(strings_, static_cast<std::streamsize>(stringSize_));
+        stream.close();
+        if (!stream) {
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            throw std::runtime_error{"Cannot write " + file.native()};
+        }
+    }
+    std::filesystem::rename(temp, file);
+}
+
+void SnapshotImage::checkTable(const SnapshotTable& table) const
+{
+    const auto address = reinterpret_cast<const std::byte*>(&table);
+    const auto offset = static_cast<uint64_t>(address - nodes_);
+    // The values and entries that follow the table hold 64-bit numbers, and the
+    // table size keeps them aligned if the table is.
+    if (address < nodes_ || offset % alignof(SnapshotValue) != 0
+        || offset > nodeSize_ - sizeof(SnapshotTable)) {
+        throw std::runtime_error{"Compiled configuration is corrupt"};
+    }
+    const auto available = nodeSize_ - offset - sizeof(SnapshotTable);
+    const auto required = uint64_t{table.arraySize} * sizeof(SnapshotValue)
+        + uint64_t{table.entryCount} * sizeof(SnapshotEntry);
+    if (table.index >= tableCount_ || required > available)
+        throw std::runtime_error{"Compiled configuration is corrupt"};
+}
+
+// Strings must end with the NUL the pool has after each of them. Tables are
+// checked when a source is made for them.
+void SnapshotImage::checkValues(const SnapshotTable& table) const
+{
+    const auto checkString = [this](uint64_t offset, uint32_t size) {
+        if (offset >= stringSize_ || size >= stringSize_ - offset
+            || strings_[offset + size] != '\0')
+            throw std::runtime_error{"Compiled configuration is corrupt"};
+    };
+    const auto checkValue = [&](const SnapshotValue& value) {
+        if (value.type > SnapshotType::Table)
+            throw std::runtime_error{"Compiled configuration is corrupt"};
+        if (value.type == SnapshotType::String)
+            checkString(value.offset, value.size);
+    };
+    for (uint32_t i = 0; i < table.arraySize; ++i)
+        checkValue(table.getValues()[i]);
+    for (uint32_t i = 0; i < table.entryCount; ++i) {
+        const auto& entry = table.getEntries()[i];
+        checkString(entry.key, entry.keySize);
+        checkValue(entry.value);
+    }
+}
+
+SnapshotImage::~SnapshotImage()
+{
+    for (uint32_t i = 0; i < tableCount_; ++i)
+        delete sources_[i].load(std::memory_order_relaxed);
+}
+
+ConfigSourcePointer SnapshotImage::getSource(const SnapshotTable& table) const
+{
+    // Sources share the lifetime of the image, so handing them out costs no allocation.
+    return ConfigSourcePointer{shared_from_this(), getSourceView(table)};
+}
+
+SnapshotSource* SnapshotImage::getSourceView(const SnapshotTable& table) const
+{
+    if (file_)
+        checkTable(table);
+    auto& slot = sources_[table.index];
+    auto source = slot.load(std::memory_order_acquire);
+    if (source == nullptr) {
+        if (file_)
+            checkValues(table);
+        auto created = std::make_unique<SnapshotSource>(*this, table);
+        if (slot.compare_exchange_strong(source, created.get(), std::memory_order_acq_rel))
+            source = created.release();
+    }
+    return source;
+}
+
+static SnapshotValue makeValue(SnapshotType type) noexcept
+{
+    SnapshotValue value{};
+    value.type = type;
+    return value;
+}
+
+template <typename T>
+static uint32_t checkSize(T size)
+{
+    if (size > std::numeric_limits<uint32_t>::max())
+        throw std::length_error{"Configuration snapshot is too large"};
+    return static_cast<uint32_t>(size);
+}
+
+SnapshotBuilder::SnapshotBuilder()
+    : depth_{0}
+    , key_{}
+    , hasKey_{false}
+    , hasRoot_{false}
+    , root_{0}
+    , tableCount_{0}
+{
+}
+
+SnapshotBuilder::~SnapshotBuilder() = default;
+
+uint64_t SnapshotBuilder::addStringData(std::string_view value)
+{
+    const auto offset = strings_.size();
+    strings_.append(value).push_back('\0');
+    return offset;
+}
+
+void SnapshotBuilder::setKey(std::string_view key)
+{
+    key_.hash = hash(key);
+    key_.keySize = checkSize(key.size());
+    key_.key = checkSize(addStringData(key));
+    hasKey_ = true;
+}
+
+void SnapshotBuilder::add(const SnapshotValue& value)
+{
+    if (depth_ == 0)
+        throw std::logic_error{"Configuration values must be added to a table"};
+    auto& frame = frames_[depth_ - 1];
+    if (hasKey_) {
+        hasKey_ = false;
+        if (value.type != SnapshotType::Nil) {
+            key_.value = value;
+            frame.entries.push_back(key_);
+        }
+    } else {
+        frame.values.push_back(value);
+    }
+}
+
+void SnapshotBuilder::addNil() { add(makeValue(SnapshotType::Nil)); }
+
+void SnapshotBuilder::addBoolean(bool value)
+{
+    auto result = makeValue(SnapshotType::Boolean);
+    result.integer = value;
+    add(result);
+}
+
+void SnapshotBuilder::addInteger(int64_t value)
+{
+    auto result = makeValue(SnapshotType::Integer);
+    result.integer = value;
+    add(result);
+}
+
+void SnapshotBuilder::addDouble(double value)
+{
+    auto result = makeValue(SnapshotType::Double);
+    result.number = value;
+    add(result);
+}
+
+void SnapshotBuilder::addString(std::string_view value)
+{
+    auto result = makeValue(SnapshotType::String);
+    result.size = checkSize(value.size());
+    result.offset = addStringData(value);
+    add(result);
+}
+
+void SnapshotBuilder::beginTable()
+{
+    if (depth_ == 0 && hasRoot_)
+        throw std::logic_error{"Configuration snapshot already has a root table"};
+    if (depth_ == frames_.size())
+        frames_.emplace_back();
+    auto& frame = frames_[depth_++];
+    frame.values.clear();
+    frame.entries.clear();
+    frame.key = key_;
+    frame.hasKey = hasKey_;
+    hasKey_ = false;
+}
+
+void SnapshotBuilder::endTable()
+{
+    if (depth_ == 0)
+        throw std::logic_error{"Unbalanced configuration table"};
+
+    auto& frame = frames_[depth_ - 1];
+    auto& entries = frame.entries;
+    const auto keyOf = [this](const SnapshotEntry& entry) noexcept {
+        return std::string_view{strings_.data() + entry.key, entry.keySize};
+    };
+    const auto equal = [&](const SnapshotEntry& lhs, const SnapshotEntry& rhs) noexcept {
+        return lhs.hash == rhs.hash && keyOf(lhs) == keyOf(rhs);
+    };
+
+    // Sort by hash for lookups and drop duplicate keys, the last one wins.
+    const auto less = [&](const SnapshotEntry& lhs, const SnapshotEntry& rhs) noexcept {
+        return lhs.hash != rhs.hash ? lhs.hash < rhs.hash : keyOf(lhs) < keyOf(rhs);
+    };
+    if (entries.size() <= 16) {
+        // Typical small objects: insertion sort is stable and needs no buffer.
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            const auto entry = *it;
+            auto hole = it;
+            for (; hole != entries.begin() && less(entry, *std::prev(hole)); --hole)
+                *hole = *std::prev(hole);
+            *hole = entry;
+        }
+    } else {
+        std::stable_sort(entries.begin(), entries.end(), less);
+    }
+    auto last = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (std::next(it) == entries.end() || !equal(*it, *std::next(it)))
+            *last++ = *it;
+    }
+    entries.erase(last, entries.end());
+
+    const SnapshotTable header{
+        checkSize(frame.values.size()), checkSize(entries.size()), tableCount_++, 0};
+    const auto offset = nodes_.size() * sizeof(uint64_t);
+    const auto valueBytes = frame.values.size() * sizeof(SnapshotValue);
+    const auto entryBytes = entries.size() * sizeof(SnapshotEntry);
+    nodes_.resize(nodes_.size() + (sizeof(header) + valueBytes + entryBytes) / sizeof(uint64_t));
+    auto data = reinterpret_cast<std::byte*>(nodes_.data()) + offset;
+    std::memcpy(data, &header, sizeof(header));
+    if (valueBytes != 0)
+        std::memcpy(data + sizeof(header), frame.values.data(), valueBytes);
+    if (entryBytes != 0)
+        std::memcpy(data + sizeof(header) + valueBytes, entries.data(), entryBytes);
+
+    key_ = frame.key;
+    hasKey_ = frame.hasKey;
+    if (--depth_ == 0) {
+        hasRoot_ = true;
+        root_ = offset;
+    } else {
+        auto table = makeValue(SnapshotType::Table);
+        table.offset = offset;
+        add(table);
+    }
+}
+
+SnapshotImagePointer SnapshotBuilder::finish()
+{
+    if (!hasRoot_ || depth_ != 0)
+        throw std::logic_error{"Configuration snapshot is incomplete"};
+    frames_.clear();
+    hasRoot_ = false;
+    auto image = std::make_shared<SnapshotImage>(
+        std::move(nodes_), std::move(strings_), root_, std::exchange(tableCount_, 0));
+    // Ready for the next snapshot.
+    nodes_.clear();
+    strings_.clear();
+    return image;
+}
+
+SnapshotSource::SnapshotSource(const SnapshotImage& image, const SnapshotTable& table) noexcept
+    : image_{&image}
+    , table_{&table}
+{
+}
+
+SnapshotSource::~SnapshotSource() = default;
+
+const SnapshotValue* SnapshotSource::find(int index) const noexcept
+{
+    if (index < 0 || static_cast<uint32_t>(index) >= table_->arraySize)
+        return nullptr;
+    auto value = table_->getValues() + index;
+    return value->type != SnapshotType::Nil ? value : nullptr;
+}
+
+const SnapshotValue* SnapshotSource::find(std::string_view name) const noexcept
+{
+    return find(ConfigKey{name});
+}
+
+const SnapshotValue* SnapshotSource::find(const ConfigKey& key) const noexcept
+{
+    const auto end = table_->getEntries() + table_->entryCount;
+    auto it = std::lower_bound(table_->getEntries(), end, key.getHash(),
+        [](const SnapshotEntry& entry, uint64_t value) noexcept { return entry.hash < value; });
+    for (; it != end && it->hash == key.getHash(); ++it) {
+        if (image_->getKey(*it) == key.getName())
+            return &it->value;
+    }
+    return nullptr;
+}
+
+bool SnapshotSource::hasValueAt(int index) const
+{
+    if (auto value = find(index))
+        return value->type != SnapshotType::Table;
+    return false;
+}
+
+ConfigSourcePointer SnapshotSource::tryConvertToChild(const SnapshotValue* value) const
+{
+    ConfigSourcePointer result;
+    if (value && value->type == SnapshotType::Table)
+        result = image_->getSource(image_->getTable(value->offset));
+    return result;
+}
+
+ConfigSourcePointer SnapshotSource::tryGetChild(int index) const
+{
+    return tryConvertToChild(find(index));
+}
+
+ConfigSourcePointer SnapshotSource::tryGetChild(std::string_view name) const
+{
+    return tryConvertToChild(find(name));
+}
+
+ConfigSourcePointer SnapshotSource::tryGetChild(const ConfigKey& key) const
+{
+    return tryConvertToChild(find(key));
+}
+
+ConfigSource* SnapshotSource::tryGetChildView(const ConfigKey& key, ConfigSourcePointer&) const
+{
+    const auto value = find(key);
+    if (value && value->type == SnapshotType::Table)
+        return image_->getSourceView(image_->getTable(value->offset));
+    return nullptr;
+}
+
+std::optional<bool> SnapshotSource::tryConvertToBoolean(const SnapshotValue* value) const
+{
+    std::optional<bool> result;
+    if (value) {
+        switch (value->type) {
+            case SnapshotType::Boolean:
+                result.emplace(value->integer != 0);
+                break;
+            case SnapshotType::Integer:
+                result.emplace(value->integer > 0);
+                break;
+            case SnapshotType::Double:
+                result.emplace(value->number > 0);
+                break;
+            case SnapshotType::String:
+                result.emplace(parseBoolean(image_->getData(value->offset), value->size));
+                break;
+            case SnapshotType::Nil:
+            case SnapshotType::Table:
+                break;
+        }
+    }
+    return result;
+}
+
+std::optional<bool> SnapshotSource::tryGetBoolean(int index) const
+{
+    return tryConvertToBoolean(find(index));
+}
+
+std::optional<bool> SnapshotSource::tryGetBoolean(std::string_view name) const
+{
+    return tryConvertToBoolean(find(name));
+}
+
+std::optional<bool> SnapshotSource::tryGetBoolean(const ConfigKey& key) const
+{
+    return tryConvertToBoolean(find(key));
+}
+
+std::optional<double> SnapshotSource::tryConvertToDouble(const SnapshotValue* value) const
+{
+    std::optional<double> result;
+    if (value) {
+        switch (value->type) {
+            case SnapshotType::Boolean:
+            case SnapshotType::Integer:
+                result.emplace(static_cast<double>(value->integer));
+                break;
+            case SnapshotType::Double:
+                result.emplace(value->number);
+                break;
+            case SnapshotType::String:
+                result.emplace(parseDouble(image_->getData(value->offset), value->size));
+                break;
+            case SnapshotType::Nil:
+            case SnapshotType::Table:
+                break;
+        }
+    }
+    return result;
+}
+
+std::optional<double> SnapshotSource::tryGetDouble(int index) const
+{
+    return tryConvertToDouble(find(index));
+}
+
+std::optional<double> SnapshotSource::tryGetDouble(std::string_view name) const
+{
+    return tryConvertToDouble(find(name));
+}
+
+std::optional<double> SnapshotSource::tryGetDouble(const ConfigKey& key) const
+{
+    return tryConvertToDouble(find(key));
+}
+
+std::optional<int64_t> SnapshotSource::tryConvertToNumber(const SnapshotValue* value) const
+{
+    std::optional<int64_t> result;
+    if (value) {
+        switch (value->type) {
+            case SnapshotType::Boolean:
+            case SnapshotType::Integer:
+                result.emplace(value->integer);
+                break;
+            case SnapshotType::Double:
+                result.emplace(roundToInteger(value->number));
+                break;
+            case SnapshotType::String:
+                result.emplace(parseInteger(image_->getString(value->offset, value->size)));
+                break;
+            case SnapshotType::Nil:
+            case SnapshotType::Table:
+                break;
+        }
+    }
+    return result;
+}
+
+std::optional<int64_t> SnapshotSource::tryGetNumber(int index) const
+{
+    return tryConvertToNumber(find(index));
+}
+
+std::optional<int64_t> SnapshotSource::tryGetNumber(std::string_view name) const
+{
+    return tryConvertToNumber(find(name));
+}
+
+std::optional<int64_t> SnapshotSource::tryGetNumber(const ConfigKey& key) const
+{
+    return tryConvertToNumber(find(key));
+}
+
+std::optional<uint64_t> SnapshotSource::tryConvertToUnsignedNumber(
+    const SnapshotValue* value) const
+{
+    std::optional<uint64_t> result;
+    if (value) {
+        switch (value->type) {
+            case SnapshotType::Boolean:
+            case SnapshotType::Integer:
+                result.emplace(static_cast<uint64_t>(value->integer));
+                break;
+            case SnapshotType::Double:
+                result.emplace(roundToUnsignedInteger(value->number));
+                break;
+            case SnapshotType::String:
+                result.emplace(
+                    parseUnsignedInteger(image_->getString(value->offset, value->size)));
+                break;
+            case SnapshotType::Nil:
+            case SnapshotType::Table:
+                break;
+        }
+    }
+    return result;
+}
+
+std::optional<uint64_t> SnapshotSource::tryGetUnsignedNumber(int index) const
+{
+    return tryConvertToUnsignedNumber(find(index));
+}
+
+std::optional<uint64_t> SnapshotSource::tryGetUnsignedNumber(std::string_view name) const
+{
+    return tryConvertToUnsignedNumber(find(name));
+}
+
+std::optional<uint64_t> SnapshotSource::tryGetUnsignedNumber(const ConfigKey& key) const
+{
+    return tryConvertToUnsignedNumber(find(key));
+}
+
+std::optional<std::string> SnapshotSource::tryConvertToString(const SnapshotValue* value) const
+{
+    std::optional<std::string> result;
+    if (value) {
+        switch (value->type) {
+            case SnapshotType::Boolean:
+                result.emplace(1, static_cast<char>('0' + value->integer));
+                break;
+            case SnapshotType::Integer:
+                result.emplace(formatNumber(value->integer));
+                break;
+            case SnapshotType::Double:
+                result.emplace(formatNumber(value->number));
+                break;
+            case SnapshotType::String:
+                result.emplace(image_->getString(value->offset, value->size));
+                break;
+            case SnapshotType::Nil:
+            case SnapshotType::Table:
+                break;
+        }
+    }
+    return result;
+}
+
+std::optional<std::string> SnapshotSource::tryGetString(int index) const
+{
+    return tryConvertToString(find(index));
+}
+
+std::optional<std::string> SnapshotSource::tryGetString(std::string_view name) const
+{
+    return tryConvertToString(find(name));
+}
+
+std::optional<std::string> SnapshotSource::tryGetString(const ConfigKey& key) const
+{
+    return tryConvertToString(find(key));
+}
+
+std::optional<std::string_view> SnapshotSource::tryConvertToStringView(
+    const SnapshotValue* value) const
+{
+    std::optional<std::string_view> result;
+    if (value != nullptr && value->type == SnapshotType::String) {
+        result.emplace(image_->getString(value->offset, value->size));
+    } else if (value != nullptr && value->type == SnapshotType::Boolean) {
+        result.emplace(value->integer ? "1" : "0");
+    } else if (auto text = tryConvertToString(value)) {
+        // Numbers have no text in the image, so this is the one read that takes a lock.
+        result.emplace(image_->getTextCache().intern(*text));
+    }
+    return result;
+}
+
+std::optional<std::string_view> SnapshotSource::tryGetStringView(int index) const
+{
+    return tryConvertToStringView(find(index));
+}
+
+std::optional<std::string_view> SnapshotSource::tryGetStringView(std::string_view name) const
+{
+    return tryConvertToStringView(find(name));
+}
+
+std::optional<std::string_view> SnapshotSource::tryGetStringView(const ConfigKey& key) const
+{
+    return tryConvertToStringView(find(key));
+}
+
+size_t SnapshotSource::getArraySize() const { return table_->arraySize; }
+
+template <typename T, typename R>
+size_t SnapshotSource::copyValuesT(
+    std::span<T> values, R (SnapshotSource::*convert)(const SnapshotValue*) const) const
+{
+    const auto count = std::min<size_t>(values.size(), table_->arraySize);
+    const auto array = table_->getValues();
+    for (size_t i = 0; i < count; ++i) {
+        auto value = (this->*convert)(&array[i]);
+        if (!value.has_value())
+            return i;
+        values[i] = *std::move(value);
+    }
+    return count;
+}
+
+size_t SnapshotSource::copyValues(std::span<bool> values) const
+{
+    return copyValuesT(values, &SnapshotSource::tryConvertToBoolean);
+}
+
+size_t SnapshotSource::copyValues(std::span<double> values) const
+{
+    return copyValuesT(values, &SnapshotSource::tryConvertToDouble);
+}
+
+size_t SnapshotSource::copyValues(std::span<int64_t> values) const
+{
+    return copyValuesT(values, &SnapshotSource::tryConvertToNumber);
+}
+
+size_t SnapshotSource::copyValues(std::span<uint64_t> values) const
+{
+    return copyValuesT(values, &SnapshotSource::tryConvertToUnsignedNumber);
+}
+
+size_t SnapshotSource::copyValues(std::span<std::string> values) const
+{
+    return copyValuesT(values, &SnapshotSource::tryConvertToString);
+}
+
+size_t SnapshotSource::copyValues(std::span<std::string_view> values) const
+{
+    return copyValuesT(values, &SnapshotSource::tryConvertToStringView);
+}
+
+std::vector<std::string> SnapshotSource::getKeyList() const
+{
+    std::vector<std::string> keys;
+    keys.reserve(table_->entryCount);
+    const auto entries = table_->getEntries();
+    for (uint32_t i = 0; i < table_->entryCount; ++i)
+        keys.emplace_back(image_->getKey(entries[i]));
+    return keys;
+}
+
+class SnapshotSource::ItemCursor final : public ConfigItemCursor {
+public:
+    explicit ItemCursor(const SnapshotSource& source) noexcept
+        : source_{source}
+        , entry_{nullptr}
+    {
+    }
+
+    bool next() override
+    {
+        const auto& table = *source_.table_;
+        entry_ = entry_ ? entry_ + 1 : table.getEntries();
+        return entry_ != table.getEntries() + table.entryCount;
+    }
+
+    std::string_view getKey() const override { return source_.image_->getKey(*entry_); }
+
+    ConfigSourcePointer getChild() const override
+    {
+        return source_.tryConvertToChild(&entry_->value);
+    }
+
+    bool isTable() const override { return entry_->value.type == SnapshotType::Table; }
+
+    std::optional<bool> getBoolean() const override
+    {
+        return source_.tryConvertToBoolean(&entry_->value);
+    }
+
+    std::optional<double> getDouble() const override
+    {
+        return source_.tryConvertToDouble(&entry_->value);
+    }
+
+    std::optional<int64_t> getNumber() const override
+    {
+        return source_.tryConvertToNumber(&entry_->value);
+    }
+
+    std::optional<uint64_t> getUnsignedNumber() const override
+    {
+        return source_.tryConvertToUnsignedNumber(&entry_->value);
+    }
+
+    std::optional<std::string> getString() const override
+    {
+        return source_.tryConvertToString(&entry_->value);
+    }
+
+    std::optional<std::string_view> getStringView() const override
+    {
+        return source_.tryConvertToStringView(&entry_->value);
+    }
+
+private:
+    const SnapshotSource& source_;
+    const SnapshotEntry* entry_;
+};
+
+std::unique_ptr<ConfigItemCursor> SnapshotSource::getItems() const
+{
+    return std::make_unique<ItemCursor>(*this);
+}
+
+ConfigSourcePointer SnapshotSource::freeze() const { return {}; }
+
+bool SnapshotSource::isThreadSafe() const noexcept { return true; }
+
+static void mergeTables(SnapshotBuilder& builder, std::span<const SnapshotSource* const> tables);
+
+static void copyValue(
+    SnapshotBuilder& builder, const SnapshotImage& image, const SnapshotValue& value)
+{
+    switch (value.type) {
+        case SnapshotType::Boolean:
+            builder.addBoolean(value.integer != 0);
+            break;
+        case SnapshotType::Integer:
+            builder.addInteger(value.integer);
+            break;
+        case SnapshotType::Double:
+            builder.addDouble(value.number);
+            break;
+        case SnapshotType::String:
+            builder.addString(image.getString(value.offset, value.size));
+            break;
+        case SnapshotType::Table: {
+            const auto child = image.getSource(image.getTable(value.offset));
+            const auto* table = static_cast<const SnapshotSource*>(child.get());
+            mergeTables(builder, {&table, 1});
+            break;
+        }
+        default:
+            builder.addNil();
+            break;
+    }
+}
+
+static void mergeTables(SnapshotBuilder& builder, std::span<const SnapshotSource* const> tables)
+{
+    builder.beginTable();
+    for (auto it = tables.rbegin(); it != tables.rend(); ++it) {
+        const auto& table = (*it)->getTable();
+        if (table.arraySize > 0) {
+            for (uint32_t i = 0; i < table.arraySize; ++i)
+                copyValue(builder, (*it)->getImage(), table.getValues()[i]);
+            break;
+        }
+    }
+
+    if (tables.size() == 1) {
+        const auto& image = tables[0]->getImage();
+        const auto& table = tables[0]->getTable();
+        for (uint32_t i = 0; i < table.entryCount; ++i) {
+            const auto& entry = table.getEntries()[i];
+            builder.setKey(image.getKey(entry));
+            copyValue(builder, image, entry.value);
+        }
+        builder.endTable();
+        return;
+    }
+
+    // Keys go in order of first appearance, so the result does not depend on hashing.
+    using Value = std::pair<const SnapshotImage*, const SnapshotValue*>;
+    std::vector<std::string_view> keys;
+    std::unordered_map<std::string_view, std::vector<Value>> values;
+    for (const auto* source : tables) {
+        const auto& image = source->getImage();
+        const auto& table = source->getTable();
+        for (uint32_t i = 0; i < table.entryCount; ++i) {
+            const auto& entry = table.getEntries()[i];
+            const auto [it, inserted] = values.try_emplace(image.getKey(entry));
+            if (inserted)
+                keys.push_back(it->first);
+            it->second.emplace_back(&image, &entry.value);
+        }
+    }
+
+    for (auto key : keys) {
+        const auto& list = values[key];
+        builder.setKey(key);
+        auto first = list.size();
+        while (first > 0 && list[first - 1].second->type == SnapshotType::Table)
+            --first;
+        if (first == list.size()) {
+            copyValue(builder, *list.back().first, *list.back().second);
+            continue;
+        }
+        // Tables merge with the tables right before them, up to the last other value.
+        std::vector<ConfigSourcePointer> children;
+        std::vector<const SnapshotSource*> merged;
+        for (auto i = first; i < list.size(); ++i) {
+            const auto& [image, value] = list[i];
+            children.push_back(image->getSource(image->getTable(value->offset)));
+            merged.push_back(static_cast<const SnapshotSource*>(children.back().get()));
+        }
+        mergeTables(builder, merged);
+    }
+    builder.endTable();
+}
+
+SnapshotImagePointer mergeSnapshots(std::span<const SnapshotSource* const> sources)
+{
+    SnapshotBuilder builder;
+    mergeTables(builder, sources);
+    return builder.finish();
+}
+
+} // namespace confetti::internal
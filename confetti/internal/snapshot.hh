@@ -0,0 +1,351 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_SNAPSHOT_HH
+#define CONFETTI_INTERNAL_SNAPSHOT_HH
+
+#include "../config_source.hh"
+#include "mapped_file.hh"
+#include "text_cache.hh"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+namespace confetti::internal {
+
+enum class SnapshotType : uint8_t { Nil, Boolean, Integer, Double, String, Table };
+
+// Image layout. Tables live in the node buffer and are referenced by byte offsets
+// into it, strings (NUL-terminated) live in the string pool. Nothing in the image
+// is a pointer, so it can be copied or mapped anywhere as is.
+
+struct SnapshotValue final {
+    SnapshotType type;
+    uint8_t reserved[3];
+    uint32_t size; // String length.
+    union {
+        int64_t integer;
+        double number;
+        uint64_t offset; // String pool offset or node buffer offset of a table.
+    };
+};
+
+struct SnapshotEntry final {
+    uint64_t hash;
+    uint32_t key;
+    uint32_t keySize;
+    SnapshotValue value;
+};
+
+// Followed by `arraySize` values and `entryCount` entries sorted by hash.
+struct SnapshotTable final {
+    uint32_t arraySize;
+    uint32_t entryCount;
+    uint32_t index; // Ordinal of the table within the image.
+    uint32_t reserved;
+
+    [[nodiscard]] const SnapshotValue* getValues() const noexcept
+    {
+        return reinterpret_cast<const SnapshotValue*>(this + 1);
+    }
+
+    [[nodiscard]] const SnapshotEntry* getEntries() const noexcept
+    {
+        return reinterpret_cast<const SnapshotEntry*>(getValues() + arraySize);
+    }
+};
+
+static_assert(sizeof(SnapshotValue) == 16);
+static_assert(sizeof(SnapshotEntry) == 32);
+static_assert(sizeof(SnapshotTable) == 16);
+
+// Compiled configuration file. The header is followed by the node buffer and
+// then the string pool, so a mapped file is an image without any decoding.
+struct SnapshotFileHeader final {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // Written in native order, so a mismatch means different endianness.
+    uint64_t root;
+    uint64_t nodeSize;
+    uint64_t stringSize;
+    uint32_t tableCount;
+    uint32_t reserved[3];
+};
+
+static_assert(alignof(SnapshotValue) >= alignof(SnapshotTable));
+static_assert(alignof(SnapshotEntry) == alignof(SnapshotValue));
+static_assert(sizeof(SnapshotTable) % alignof(SnapshotValue) == 0);
+static_assert(sizeof(SnapshotValue) % alignof(SnapshotEntry) == 0);
+static_assert(sizeof(SnapshotFileHeader) % alignof(SnapshotValue) == 0);
+
+class SnapshotImage;
+class SnapshotSource;
+
+using SnapshotImagePointer = std::shared_ptr<const SnapshotImage>;
+
+// Immutable, so any number of threads may read it concurrently. Sources for
+// individual tables are created on first access and owned by the image.
+class SnapshotImage final : public std::enable_shared_from_this<SnapshotImage> {
+public:
+    static constexpr uint32_t fileVersion = 1;
+
+    SnapshotImage(
+        std::vector<uint64_t> nodes, std::string strings, uint64_t root, uint32_t tableCount);
+
+    // Uses the image in a compiled file in place. Tables, and the values and keys
+    // in them, are checked to be within the mapping when first accessed.
+    SnapshotImage(std::unique_ptr<MappedFile> file, std::string_view name);
+
+    [[nodiscard]] static SnapshotImagePointer loadFile(const std::filesystem::path& file);
+
+    // Writes the whole image with `root` as the root table.
+    void saveFile(const std::filesystem::path& file, const SnapshotTable& root) const;
+
+    SnapshotImage(const SnapshotImage&) = delete;
+    SnapshotImage& operator=(const SnapshotImage&) = delete;
+
+    ~SnapshotImage();
+
+    [[nodiscard]] ConfigSourcePointer getSource(const SnapshotTable& table) const;
+
+    // Same as getSource(), without taking a reference to the image.
+    [[nodiscard]] SnapshotSource* getSourceView(const SnapshotTable& table) const;
+
+    [[nodiscard]] ConfigSourcePointer getRootSource() const { return getSource(getRoot()); }
+
+    [[nodiscard]] const SnapshotTable& getRoot() const noexcept { return getTable(root_); }
+
+    [[nodiscard]] const SnapshotTable& getTable(uint64_t offset) const noexcept
+    {
+        return *reinterpret_cast<const SnapshotTable*>(nodes_ + offset);
+    }
+
+    [[nodiscard]] const char* getData(uint64_t offset) const noexcept { return strings_ + offset; }
+
+    [[nodiscard]] std::string_view getString(uint64_t offset, uint32_t size) const noexcept
+    {
+        return {getData(offset), size};
+    }
+
+    [[nodiscard]] std::string_view getKey(const SnapshotEntry& entry) const noexcept
+    {
+        return getString(entry.key, entry.keySize);
+    }
+
+    // Keeps values converted to strings for views into the image.
+    [[nodiscard]] TextCache& getTextCache() const noexcept { return texts_; }
+
+private:
+    void checkTable(const SnapshotTable& table) const;
+
+    void checkValues(const SnapshotTable& table) const;
+
+    std::vector<uint64_t> nodeBuffer_;
+    std::string stringBuffer_;
+    std::unique_ptr<MappedFile> file_;
+    const std::byte* nodes_;
+    const char* strings_;
+    uint64_t nodeSize_;
+    uint64_t stringSize_;
+    uint64_t root_;
+    uint32_t tableCount_;
+    std::unique_ptr<std::atomic<SnapshotSource*>[]> sources_;
+    mutable TextCache texts_;
+};
+
+// Builds an image from a depth-first stream of events. The first value must be
+// a table, which becomes the root. Values added after setKey() go into the
+// keyed part of the current table, all others are appended to its array part.
+class SnapshotBuilder final {
+public:
+    SnapshotBuilder();
+
+    SnapshotBuilder(const SnapshotBuilder&) = delete;
+    SnapshotBuilder& operator=(const SnapshotBuilder&) = delete;
+
+    ~SnapshotBuilder();
+
+    void setKey(std::string_view key);
+
+    void addNil();
+
+    void addBoolean(bool value);
+
+    void addInteger(int64_t value);
+
+    void addDouble(double value);
+
+    void addString(std::string_view value);
+
+    void beginTable();
+
+    void endTable();
+
+    [[nodiscard]] SnapshotImagePointer finish();
+
+private:
+    struct Frame final {
+        std::vector<SnapshotValue> values;
+        std::vector<SnapshotEntry> entries;
+        SnapshotEntry key;
+        bool hasKey;
+    };
+
+    [[nodiscard]] uint64_t addStringData(std::string_view value);
+
+    void add(const SnapshotValue& value);
+
+    std::vector<uint64_t> nodes_;
+    std::string strings_;
+    std::vector<Frame> frames_;
+    size_t depth_;
+    SnapshotEntry key_;
+    bool hasKey_;
+    bool hasRoot_;
+    uint64_t root_;
+    uint32_t tableCount_;
+};
+
+class SnapshotSource final : public ConfigSource {
+public:
+    SnapshotSource(const SnapshotImage& image, const SnapshotTable& table) noexcept;
+
+    ~SnapshotSource() override;
+
+    SnapshotSource(const SnapshotSource&) = delete;
+    SnapshotSource& operator=(const SnapshotSource&) = delete;
+
+    [[nodiscard]] bool hasValueAt(int index) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(int index) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(std::string_view name) const override;
+
+    [[nodiscard]] ConfigSourcePointer tryGetChild(const ConfigKey& key) const override;
+
+    [[nodiscard]] ConfigSource* tryGetChildView(
+        const ConfigKey& key, ConfigSourcePointer& owner) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(int index) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<bool> tryGetBoolean(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(int index) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<double> tryGetDouble(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(int index) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<int64_t> tryGetNumber(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(int index) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(
+        std::string_view name) const override;
+
+    [[nodiscard]] std::optional<uint64_t> tryGetUnsignedNumber(
+        const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(int index) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(std::string_view name) const override;
+
+    [[nodiscard]] std::optional<std::string> tryGetString(const ConfigKey& key) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(int index) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(
+        std::string_view name) const override;
+
+    [[nodiscard]] std::optional<std::string_view> tryGetStringView(
+        const ConfigKey& key) const override;
+
+    [[nodiscard]] std::vector<std::string> getKeyList() const override;
+
+    [[nodiscard]] std::unique_ptr<ConfigItemCursor> getItems() const override;
+
+    [[nodiscard]] size_t getArraySize() const override;
+
+    [[nodiscard]] size_t copyValues(std::span<bool> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<double> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<int64_t> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<uint64_t> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<std::string> values) const override;
+
+    [[nodiscard]] size_t copyValues(std::span<std::string_view> values) const override;
+
+    [[nodiscard]] ConfigSourcePointer freeze() const override;
+
+    [[nodiscard]] bool isThreadSafe() const noexcept override;
+
+    [[nodiscard]] const SnapshotImage& getImage() const noexcept { return *image_; }
+
+    [[nodiscard]] const SnapshotTable& getTable() const noexcept { return *table_; }
+
+private:
+    class ItemCursor;
+
+    [[nodiscard]] const SnapshotValue* find(int index) const noexcept;
+
+    [[nodiscard]] const SnapshotValue* find(std::string_view name) const noexcept;
+
+    [[nodiscard]] const SnapshotValue* find(const ConfigKey& key) const noexcept;
+
+    [[nodiscard]] ConfigSourcePointer tryConvertToChild(const SnapshotValue* value) const;
+
+    [[nodiscard]] std::optional<bool> tryConvertToBoolean(const SnapshotValue* value) const;
+
+    [[nodiscard]] std::optional<double> tryConvertToDouble(const SnapshotValue* value) const;
+
+    [[nodiscard]] std::optional<int64_t> tryConvertToNumber(const SnapshotValue* value) const;
+
+    [[nodiscard]] std::optional<uint64_t> tryConvertToUnsignedNumber(
+        const SnapshotValue* value) const;
+
+    [[nodiscard]] std::optional<std::string> tryConvertToString(const SnapshotValue* value) const;
+
+    [[nodiscard]] std::optional<std::string_view> tryConvertToStringView(
+        const SnapshotValue* value) const;
+
+    template <typename T, typename R>
+    [[nodiscard]] size_t copyValuesT(
+        std::span<T> values, R (SnapshotSource::*convert)(const SnapshotValue*) const) const;
+
+    const SnapshotImage* image_;
+    const SnapshotTable* table_;
+};
+
+// Deep-merges the tables into a new image, later ones taking precedence. Keyed tables
+// merge recursively. Any other keyed value, and the array part as a whole, replaces
+// that of the tables before.
+[[nodiscard]] SnapshotImagePointer mergeSnapshots(std::span<const SnapshotSource* const> sources);
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_SNAPSHOT_HH
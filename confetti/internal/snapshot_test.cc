@@ -0,0 +1,492 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "snapshot.hh"
+#include "../config_tree.hh"
+#include "hash.hh"
+#include <gmock/gmock.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using confetti::internal::SnapshotBuilder;
+using confetti::internal::SnapshotEntry;
+using confetti::internal::SnapshotType;
+using confetti::internal::SnapshotValue;
+
+static decltype(auto) buildTestSnapshot()
+{
+    SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("string");
+    builder.addString("Hello, World!");
+    builder.setKey("integer");
+    builder.addInteger(9007199254740993);
+    builder.setKey("double");
+    builder.addDouble(19.86);
+    builder.setKey("whole_double");
+    builder.addDouble(2.0);
+    builder.setKey("yes");
+    builder.addBoolean(true);
+    builder.setKey("no");
+    builder.addBoolean(false);
+    builder.setKey("numeric_string");
+    builder.addString("-19.86");
+    builder.setKey("nothing");
+    builder.addNil();
+    builder.setKey("duplicate");
+    builder.addString("first");
+    builder.setKey("duplicate");
+    builder.addString("last");
+    builder.setKey("days");
+    builder.beginTable();
+    for (auto day : {"Monday", "Tuesday", "Wednesday"})
+        builder.addString(day);
+    builder.endTable();
+    builder.setKey("user");
+    builder.beginTable();
+    builder.setKey("name");
+    builder.addString("Vlad Lazarenko");
+    builder.endTable();
+    builder.addString("first");
+    builder.addNil();
+    builder.addInteger(3);
+    builder.endTable();
+    return builder.finish()->getRootSource();
+}
+
+TEST(Snapshot, Scalars)
+{
+    auto source = buildTestSnapshot();
+
+    EXPECT_EQ("Hello, World!", source->tryGetString("string").value());
+    EXPECT_EQ("9007199254740993", source->tryGetString("integer").value());
+    EXPECT_EQ("19.86", source->tryGetString("double").value());
+    EXPECT_EQ("2.0", source->tryGetString("whole_double").value());
+    EXPECT_EQ("1", source->tryGetString("yes").value());
+    EXPECT_EQ("0", source->tryGetString("no").value());
+    EXPECT_EQ("last", source->tryGetString("duplicate").value());
+
+    EXPECT_DOUBLE_EQ(19.86, source->tryGetDouble("double").value());
+    EXPECT_DOUBLE_EQ(-19.86, source->tryGetDouble("numeric_string").value());
+    EXPECT_DOUBLE_EQ(1.0, source->tryGetDouble("yes").value());
+    EXPECT_ANY_THROW((void)source->tryGetDouble("string"));
+
+    EXPECT_TRUE(source->tryGetBoolean("yes").value());
+    EXPECT_FALSE(source->tryGetBoolean("no").value());
+    EXPECT_TRUE(source->tryGetBoolean("double").value());
+    EXPECT_FALSE(source->tryGetBoolean("string").value());
+
+    EXPECT_EQ(20, source->tryGetNumber("double").value());
+    EXPECT_EQ(-20, source->tryGetNumber("numeric_string").value());
+
+    for (auto key : {"nothing", "this_key_should_not_exist", "user"}) {
+        EXPECT_FALSE(source->tryGetString(key)) << key;
+        EXPECT_FALSE(source->tryGetDouble(key)) << key;
+        EXPECT_FALSE(source->tryGetBoolean(key)) << key;
+    }
+}
+
+TEST(Snapshot, Children)
+{
+    auto source = buildTestSnapshot();
+
+    EXPECT_FALSE(source->tryGetChild("string"));
+    EXPECT_FALSE(source->tryGetChild("this_key_should_not_exist"));
+
+    auto user = source->tryGetChild("user");
+    ASSERT_TRUE(user);
+    EXPECT_EQ("Vlad Lazarenko", user->tryGetString("name").value());
+    EXPECT_THAT(user->getKeyList(), testing::ElementsAre("name"));
+
+    auto days = source->tryGetChild("days");
+    ASSERT_TRUE(days);
+    EXPECT_EQ("Monday", days->tryGetString(0).value());
+    EXPECT_EQ("Wednesday", days->tryGetString(2).value());
+    EXPECT_TRUE(days->hasValueAt(2));
+    EXPECT_FALSE(days->hasValueAt(3));
+    EXPECT_FALSE(days->hasValueAt(-1));
+}
+
+TEST(Snapshot, Array)
+{
+    auto source = buildTestSnapshot();
+
+    EXPECT_TRUE(source->hasValueAt(0));
+    EXPECT_FALSE(source->hasValueAt(1));
+    EXPECT_TRUE(source->hasValueAt(2));
+    EXPECT_EQ("first", source->tryGetString(0).value());
+    EXPECT_FALSE(source->tryGetString(1));
+    EXPECT_EQ(3, source->tryGetNumber(2).value());
+}
+
+TEST(Snapshot, ExactIntegers)
+{
+    SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("integer");
+    builder.addInteger(9007199254740993);
+    builder.setKey("max_string");
+    builder.addString("9223372036854775807");
+    builder.setKey("unsigned_string");
+    builder.addString("18446744073709551615");
+    builder.setKey("negative");
+    builder.addInteger(-1);
+    builder.setKey("small");
+    builder.addString("300");
+    builder.setKey("huge");
+    builder.addDouble(1e300);
+    builder.endTable();
+    const confetti::ConfigTree tree{builder.finish()->getRootSource()};
+
+    EXPECT_EQ(9007199254740993, tree.get<int64_t>("integer"));
+    EXPECT_EQ(9007199254740993U, tree.get<uint64_t>("integer"));
+    EXPECT_EQ(INT64_MAX, tree.get<int64_t>("max_string"));
+    EXPECT_EQ(UINT64_MAX, tree.get<uint64_t>("unsigned_string"));
+    EXPECT_EQ(300, tree.get<int16_t>("small"));
+    EXPECT_EQ(300, tree.get<uint16_t>("small"));
+    EXPECT_EQ(-1, tree.get<int16_t>("negative"));
+    EXPECT_EQ(UINT64_MAX, tree.get<uint64_t>("negative"));
+
+    EXPECT_THROW((void)tree.get<int32_t>("integer"), std::range_error);
+    EXPECT_THROW((void)tree.get<uint32_t>("negative"), std::range_error);
+    EXPECT_THROW((void)tree.get<int64_t>("unsigned_string"), std::range_error);
+    EXPECT_THROW((void)tree.get<int64_t>("huge"), std::range_error);
+    EXPECT_THROW((void)tree.get<uint16_t>(confetti::ConfigPath{"integer"}), std::range_error);
+    EXPECT_FALSE(tree.tryGet<int16_t>("missing"));
+}
+
+TEST(Snapshot, StringViews)
+{
+    auto source = buildTestSnapshot();
+    const auto text = source->tryGetStringView("string").value();
+    EXPECT_EQ("Hello, World!", text);
+    EXPECT_EQ(text.data(), source->tryGetStringView(confetti::ConfigKey{"string"})->data());
+    EXPECT_EQ("first", source->tryGetStringView(0).value());
+
+    const auto number = source->tryGetStringView("integer").value();
+    EXPECT_EQ("9007199254740993", number);
+    EXPECT_EQ(number.data(), source->tryGetStringView("integer")->data());
+    EXPECT_EQ("1", source->tryGetStringView("yes").value());
+    EXPECT_EQ(source->tryGetStringView("yes")->data(),
+        buildTestSnapshot()->tryGetStringView("yes")->data());
+    EXPECT_FALSE(source->tryGetStringView("nothing"));
+    EXPECT_FALSE(source->tryGetStringView("user"));
+    EXPECT_FALSE(source->tryGetStringView("this_key_should_not_exist"));
+
+    // Views into the image outlive the handle they came from.
+    std::string_view name;
+    {
+        const confetti::ConfigTree tree{source};
+        name = tree["user"].getStringView("name");
+    }
+    EXPECT_EQ("Vlad Lazarenko", name);
+}
+
+TEST(Snapshot, BulkValues)
+{
+    SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("numbers");
+    builder.beginTable();
+    for (int i = 0; i < 1000; ++i)
+        builder.addInteger(i * 3);
+    builder.endTable();
+    builder.setKey("mixed");
+    builder.beginTable();
+    builder.addDouble(0.5);
+    builder.addString("70000");
+    builder.addNil();
+    builder.addInteger(4);
+    builder.endTable();
+    builder.addBoolean(true);
+    builder.addInteger(0);
+    builder.beginTable();
+    builder.endTable();
+    builder.endTable();
+    const confetti::ConfigTree tree{builder.finish()->getRootSource()};
+
+    const auto numbers = tree["numbers"];
+    EXPECT_EQ(1000, numbers.size());
+    const auto ints = numbers.toVector<int>();
+    ASSERT_EQ(1000, ints.size());
+    EXPECT_EQ(2997, ints.back());
+    EXPECT_EQ(std::vector<int>(numbers.values<int>()), ints);
+
+    std::array<double, 10> doubles{};
+    EXPECT_EQ(10, numbers.copyValues(std::span<double>{doubles}));
+    EXPECT_EQ(27.0, doubles[9]);
+
+    const auto mixed = tree["mixed"];
+    EXPECT_EQ(4, mixed.size());
+    EXPECT_THAT(mixed.toVector<std::string>(), testing::ElementsAre("0.5", "70000"));
+    EXPECT_THAT(mixed.toVector<std::string_view>(), testing::ElementsAre("0.5", "70000"));
+    EXPECT_THAT(mixed.toVector<uint64_t>(), testing::ElementsAre(1, 70000));
+    EXPECT_THROW((void)mixed.toVector<int16_t>(), std::range_error);
+
+    EXPECT_EQ(3, tree.size());
+    EXPECT_THAT(tree.toVector<bool>(), testing::ElementsAre(true, false));
+    EXPECT_EQ(0, confetti::ConfigTree{}.size());
+    EXPECT_TRUE(confetti::ConfigTree{}.toVector<double>().empty());
+}
+
+TEST(Snapshot, Items)
+{
+    auto source = buildTestSnapshot();
+    std::vector<std::string> keys;
+    auto cursor = source->getItems();
+    while (cursor->next()) {
+        keys.emplace_back(cursor->getKey());
+        if (cursor->getKey() == "integer") {
+            EXPECT_EQ(9007199254740993, cursor->getNumber().value());
+        } else if (cursor->getKey() == "days") {
+            ASSERT_TRUE(cursor->getChild());
+            EXPECT_FALSE(cursor->getStringView());
+        } else if (cursor->getKey() == "string") {
+            EXPECT_EQ("Hello, World!", cursor->getStringView().value());
+            EXPECT_FALSE(cursor->getChild());
+        }
+    }
+    EXPECT_EQ(source->getKeyList(), keys);
+}
+
+TEST(Snapshot, Keys)
+{
+    auto source = buildTestSnapshot();
+    EXPECT_THAT(source->getKeyList(),
+        testing::UnorderedElementsAre("string", "integer", "double", "whole_double", "yes", "no",
+            "numeric_string", "duplicate", "days", "user"));
+}
+
+TEST(Snapshot, HashedKeys)
+{
+    using confetti::ConfigKey;
+    auto source = buildTestSnapshot();
+
+    EXPECT_EQ("last", source->tryGetString(ConfigKey{"duplicate"}).value());
+    EXPECT_TRUE(source->tryGetBoolean(ConfigKey{"yes"}).value());
+    EXPECT_DOUBLE_EQ(19.86, source->tryGetDouble(ConfigKey{"double"}).value());
+    EXPECT_EQ(20, source->tryGetNumber(ConfigKey{"double"}).value());
+    EXPECT_TRUE(source->tryGetChild(ConfigKey{"user"}));
+    EXPECT_FALSE(source->tryGetString(ConfigKey{"nothing"}));
+
+    // A matching hash alone is not enough.
+    EXPECT_FALSE(source->tryGetString(ConfigKey{"string", confetti::internal::hash("yes")}));
+    EXPECT_FALSE(source->tryGetString(ConfigKey{"yes", confetti::internal::hash("string")}));
+}
+
+TEST(Snapshot, FreezeIsNoOp) { EXPECT_FALSE(buildTestSnapshot()->freeze()); }
+
+TEST(Snapshot, BuilderMisuse)
+{
+    {
+        SnapshotBuilder builder;
+        EXPECT_THROW(builder.addInteger(1), std::logic_error);
+        EXPECT_THROW(builder.endTable(), std::logic_error);
+        EXPECT_THROW((void)builder.finish(), std::logic_error);
+    }
+    {
+        SnapshotBuilder builder;
+        builder.beginTable();
+        EXPECT_THROW((void)builder.finish(), std::logic_error);
+        builder.endTable();
+        EXPECT_THROW(builder.beginTable(), std::logic_error);
+        EXPECT_TRUE(builder.finish());
+    }
+}
+
+TEST(Snapshot, SaveFile)
+{
+    const auto file = std::filesystem::path{testing::TempDir()} / "confetti-snapshot.cfb";
+    const confetti::ConfigTree tree{buildTestSnapshot()};
+
+    tree.saveBinaryFile(file);
+    auto loaded = confetti::ConfigTree::loadFile(file);
+    EXPECT_TRUE(loaded.isThreadSafe());
+    EXPECT_EQ("Hello, World!", loaded.get<std::string>("string"));
+    EXPECT_EQ("9007199254740993", loaded.get<std::string>("integer"));
+    EXPECT_EQ(19.86, loaded.get<double>("double"));
+    EXPECT_TRUE(loaded.get<bool>("yes"));
+    EXPECT_EQ("Vlad Lazarenko", loaded.get<std::string>(confetti::ConfigPath{"user.name"}));
+    EXPECT_EQ("Wednesday", loaded["days"].get<std::string>(2));
+    EXPECT_EQ(3, loaded.get<int>(2));
+    EXPECT_FALSE(loaded.tryGetChild("nothing"));
+
+    tree["user"].saveBinaryFile(file);
+    loaded = confetti::ConfigTree::loadBinaryFile(file);
+    EXPECT_EQ("Vlad Lazarenko", loaded.get<std::string>("name"));
+    EXPECT_FALSE(loaded.tryGetChild("user"));
+
+    confetti::ConfigTree{}.saveBinaryFile(file);
+    EXPECT_FALSE(confetti::ConfigTree::loadBinaryFile(file).tryGetChild("user"));
+
+    std::filesystem::remove(file);
+}
+
+TEST(Snapshot, CorruptFile)
+{
+    const auto file = std::filesystem::path{testing::TempDir()} / "confetti-corrupt.cfb";
+    confetti::ConfigTree{buildTestSnapshot()}.saveBinaryFile(file);
+    std::string data;
+    {
+        std::ifstream stream{file, std::ios::binary};
+        data.assign(std::istreambuf_iterator<char>{stream}, {});
+    }
+
+    auto load = [&file](std::string_view contents) {
+        std::ofstream{file, std::ios::binary | std::ios::trunc}.write(
+            contents.data(), static_cast<std::streamsize>(contents.size()));
+        return confetti::ConfigTree::loadBinaryFile(file);
+    };
+
+    EXPECT_NO_THROW((void)load(data));
+    EXPECT_THROW((void)load(""), std::runtime_error);
+    EXPECT_THROW((void)load(std::string_view{data}.substr(0, data.size() - 1)), std::runtime_error);
+    EXPECT_THROW((void)load("Not a compiled configuration, just some text"), std::runtime_error);
+
+    auto version = data;
+    version[8] = 99;
+    EXPECT_THROW((void)load(version), std::runtime_error);
+
+    // Point the root at the end of the node buffer.
+    auto root = data;
+    const uint64_t offset = data.size();
+    std::memcpy(root.data() + 16, &offset, sizeof(offset));
+    EXPECT_THROW((void)load(root), std::runtime_error);
+
+    // Point the root half way into a 64-bit value, which a table offset must never be.
+    const auto aligned = [&data] {
+        confetti::internal::SnapshotFileHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        return header.root;
+    }();
+    auto misaligned = data;
+    const uint64_t shifted = aligned + alignof(confetti::internal::SnapshotTable);
+    std::memcpy(misaligned.data() + 16, &shifted, sizeof(shifted));
+    EXPECT_THROW((void)load(misaligned).get<std::string>("string"), std::runtime_error);
+
+    // Point keys and strings of the root table past the string pool.
+    const auto tableAt = [&data] {
+        confetti::internal::SnapshotFileHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        return sizeof(header) + header.root;
+    }();
+    confetti::internal::SnapshotTable table;
+    std::memcpy(&table, data.data() + tableAt, sizeof(table));
+    ASSERT_GT(table.entryCount, 0);
+    const auto entriesAt = tableAt + sizeof(table) + table.arraySize * sizeof(SnapshotValue);
+    auto key = data;
+    const uint32_t keySize = 0xFFFFFFFF;
+    std::memcpy(key.data() + entriesAt + offsetof(SnapshotEntry, keySize), &keySize,
+        sizeof(keySize));
+    EXPECT_THROW((void)load(key).get<std::string>("string"), std::runtime_error);
+    for (uint32_t i = 0; i < table.entryCount; ++i) {
+        const auto entryAt = entriesAt + i * sizeof(SnapshotEntry);
+        SnapshotEntry entry;
+        std::memcpy(&entry, data.data() + entryAt, sizeof(entry));
+        if (entry.value.type != SnapshotType::String)
+            continue;
+        auto string = data;
+        entry.value.offset = data.size();
+        std::memcpy(string.data() + entryAt, &entry, sizeof(entry));
+        EXPECT_THROW((void)load(string).get<std::string>("string"), std::runtime_error);
+        break;
+    }
+
+    std::filesystem::remove(file);
+}
+
+TEST(Snapshot, ConcurrentReads)
+{
+    const confetti::ConfigTree tree{buildTestSnapshot()};
+    ASSERT_TRUE(tree.isThreadSafe());
+
+    std::atomic<bool> start{false};
+    std::atomic<size_t> failures{0};
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < std::max(4U, std::thread::hardware_concurrency()); ++i) {
+        threads.emplace_back([&] {
+            while (!start.load())
+                std::this_thread::yield();
+            for (int n = 0; n < 10000; ++n) {
+                const auto user = tree["user"];
+                std::vector<std::string> days = tree["days"].values<std::string>();
+                size_t children = 0;
+                for ([[maybe_unused]] auto child : tree.children())
+                    ++children;
+                if (user.get<std::string>("name") != "Vlad Lazarenko"
+                    || tree.get<std::string>(confetti::ConfigPath{"user.name"}) != "Vlad Lazarenko"
+                    || tree.get<double>("double") != 19.86 || !tree.get<bool>("yes")
+                    || days.size() != 3 || children != 0) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    start.store(true);
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(0, failures.load());
+}
+
+TEST(Snapshot, ConcurrentReadsScale)
+{
+    const auto threads = std::min(4U, std::thread::hardware_concurrency());
+    if (threads < 2)
+        GTEST_SKIP() << "Needs at least two hardware threads";
+
+    const confetti::ConfigTree tree{buildTestSnapshot()};
+    const confetti::CompiledConfigPath path{"user.name"};
+
+    // Path reads done by `count` threads together in a fixed time.
+    auto measure = [&](unsigned count) {
+        std::atomic<bool> start{false};
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> total{0};
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < count; ++i) {
+            workers.emplace_back([&] {
+                while (!start.load())
+                    std::this_thread::yield();
+                uint64_t reads = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    for (int n = 0; n < 64; ++n)
+                        reads += tree.tryGetStringView(path).value().size();
+                }
+                total += reads;
+            });
+        }
+        start.store(true);
+        std::this_thread::sleep_for(std::chrono::milliseconds{200});
+        stop.store(true);
+        for (auto& worker : workers)
+            worker.join();
+        return total.load();
+    };
+
+    // Reads share nothing writable, so throughput grows with threads. A reference count
+    // taken at every step would keep it flat or make it drop.
+    const auto single = measure(1);
+    const auto parallel = measure(threads);
+    EXPECT_GE(parallel, single * threads / 2)
+        << "single: " << single << ", " << threads << " threads: " << parallel;
+}
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstddef>
 #include <string_view>
 
 namespace confetti::internal {
@@ -35,6 +36,20 @@ inline bool strCaseIsAnyOf(std::string_view lhs, T... rhs) noexcept
     return (strCaseEq(lhs, rhs) || ...);
 }
 
+/// String literal that can be passed as a template argument.
+template <size_t N>
+struct FixedString final {
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    constexpr FixedString(const char (&str)[N]) noexcept
+    {
+        std::copy_n(str, N, data);
+    }
+
+    [[nodiscard]] constexpr std::string_view view() const noexcept { return {data, N - 1}; }
+
+    char data[N]{};
+};
+
 } // namespace confetti::internal
 
 #endif // CONFETTI_INTERNAL_STRING_HH
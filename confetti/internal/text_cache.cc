@@ -0,0 +1,34 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "text_cache.hh"
+
+namespace confetti::internal {
+
+TextCache::TextCache() = default;
+
+TextCache::~TextCache() = default;
+
+std::string_view TextCache::intern(std::string_view text)
+{
+    std::lock_guard lock{mutex_};
+    auto it = strings_.find(text);
+    if (it == strings_.end())
+        it = strings_.emplace(text).first;
+    return *it;
+}
+
+} // namespace confetti::internal
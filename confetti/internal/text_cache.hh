@@ -0,0 +1,58 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_INTERNAL_TEXT_CACHE_HH
+#define CONFETTI_INTERNAL_TEXT_CACHE_HH
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace confetti::internal {
+
+// Owns strings that views handed out point to, such as numbers converted to
+// text. Strings are never removed, so views stay valid as long as the cache.
+// Equal strings are stored once, which bounds the growth by distinct values.
+class TextCache final {
+public:
+    TextCache();
+
+    TextCache(const TextCache&) = delete;
+    TextCache& operator=(const TextCache&) = delete;
+
+    ~TextCache();
+
+    [[nodiscard]] std::string_view intern(std::string_view text);
+
+private:
+    struct Hash final {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view text) const noexcept
+        {
+            return std::hash<std::string_view>{}(text);
+        }
+    };
+
+    std::mutex mutex_;
+    std::unordered_set<std::string, Hash, std::equal_to<>> strings_;
+};
+
+} // namespace confetti::internal
+
+#endif // CONFETTI_INTERNAL_TEXT_CACHE_HH
@@ -17,13 +17,27 @@
 #ifndef CONFETTI_INTERNAL_TYPE_TRAITS_HH
 #define CONFETTI_INTERNAL_TYPE_TRAITS_HH
 
+#include <optional>
 #include <type_traits>
+#include <vector>
 
 namespace confetti::internal {
 
 template <typename T, typename... N>
 constexpr static auto is_any_of_v = (std::is_same_v<T, N> || ...);
 
+template <typename T>
+constexpr static auto is_optional_v = false;
+
+template <typename T>
+constexpr static auto is_optional_v<std::optional<T>> = true;
+
+template <typename T>
+constexpr static auto is_vector_v = false;
+
+template <typename T, typename A>
+constexpr static auto is_vector_v<std::vector<T, A>> = true;
+
 } // namespace confetti::internal
 
 #endif // CONFETTI_INTERNAL_TYPE_TRAITS_HH
@@ -0,0 +1,296 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "live_config.hh"
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <memory>
+#include <system_error>
+#include <utility>
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#    include <sys/inotify.h>
+#endif
+
+namespace confetti {
+
+struct LiveConfig::Version final {
+    ConfigTree tree;
+    uint64_t generation;
+};
+
+// Identifies the file contents: replacing the file changes the inode, and
+// modification times alone may not change between quick successive writes.
+struct LiveConfig::FileStamp final {
+    std::filesystem::file_time_type writeTime;
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+
+    bool operator==(const FileStamp&) const = default;
+};
+
+LiveConfig::FileStamp LiveConfig::getFileStamp(const std::filesystem::path& file)
+{
+    std::error_code ec;
+    struct stat info {
+    };
+    if (::stat(file.c_str(), &info) != 0)
+        return {};
+    return {std::filesystem::last_write_time(file, ec), static_cast<uint64_t>(info.st_dev),
+        static_cast<uint64_t>(info.st_ino), static_cast<uint64_t>(info.st_size)};
+}
+
+struct alignas(64) LiveConfig::Slot final {
+    std::atomic<uint64_t> epoch{0}; // Epoch observed by the active reader, or zero.
+    Slot* next{nullptr};
+};
+
+LiveConfig::Reader::Reader(Slot* slot, const Version* version) noexcept
+    : slot_{slot}
+    , version_{version}
+{
+}
+
+LiveConfig::Reader::Reader(Reader&& other) noexcept
+    : slot_{std::exchange(other.slot_, nullptr)}
+    , version_{other.version_}
+{
+}
+
+LiveConfig::Reader::~Reader()
+{
+    if (slot_ != nullptr)
+        slot_->epoch.store(0, std::memory_order_release);
+}
+
+const ConfigTree& LiveConfig::Reader::operator*() const noexcept { return version_->tree; }
+
+uint64_t LiveConfig::Reader::getGeneration() const noexcept { return version_->generation; }
+
+LiveConfig::LiveConfig(std::filesystem::path file)
+    : LiveConfig{std::move(file), Options{}}
+{
+}
+
+LiveConfig::LiveConfig(std::filesystem::path file, Options options)
+    : file_{std::move(file)}
+    , options_{std::move(options)}
+    , current_{nullptr}
+    , generation_{1}
+    , epoch_{1}
+    , slots_{nullptr}
+    , stopPipe_{-1, -1}
+    , notifyFd_{-1}
+{
+#if defined(__linux__)
+    // Watch before loading, so that no later change goes unnoticed.
+    const auto directory = file_.has_parent_path() ? file_.parent_path() : ".";
+    notifyFd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd_ >= 0
+        && ::inotify_add_watch(notifyFd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+            < 0) {
+        ::close(std::exchange(notifyFd_, -1));
+    }
+#endif
+
+    const auto stamp = getFileStamp(file_);
+    std::unique_ptr<Version> version;
+    try {
+        version.reset(load());
+        version->generation = 1;
+        if (::pipe(stopPipe_) != 0)
+            throw std::system_error{errno, std::generic_category(), "Cannot create pipe"};
+        current_.store(version.get());
+        watcher_ = std::thread{&LiveConfig::watch, this, stamp};
+        version.release();
+    } catch (...) {
+        for (auto fd : {notifyFd_, stopPipe_[0], stopPipe_[1]}) {
+            if (fd >= 0)
+                ::close(fd);
+        }
+        throw;
+    }
+}
+
+LiveConfig::~LiveConfig()
+{
+    const char stop = 0;
+    [[maybe_unused]] const auto written = ::write(stopPipe_[1], &stop, sizeof(stop));
+    watcher_.join();
+    ::close(stopPipe_[0]);
+    ::close(stopPipe_[1]);
+    if (notifyFd_ >= 0)
+        ::close(notifyFd_);
+    for (auto& retired : retired_)
+        delete retired.first;
+    delete current_.load();
+    for (auto slot = slots_.load(); slot != nullptr;) {
+        auto next = slot->next;
+        delete slot;
+        slot = next;
+    }
+}
+
+LiveConfig::Slot* LiveConfig::acquireSlot(uint64_t epoch) const
+{
+    for (auto slot = slots_.load(); slot != nullptr; slot = slot->next) {
+        uint64_t expected = 0;
+        if (slot->epoch.load(std::memory_order_relaxed) == 0
+            && slot->epoch.compare_exchange_strong(expected, epoch)) {
+            return slot;
+        }
+    }
+    // More concurrent readers than ever before, add a slot. Slots are never removed.
+    auto slot = new Slot;
+    slot->epoch.store(epoch, std::memory_order_relaxed);
+    auto head = slots_.load();
+    do {
+        slot->next = head;
+    } while (!slots_.compare_exchange_weak(head, slot));
+    return slot;
+}
+
+LiveConfig::Reader LiveConfig::read() const
+{
+    // Announce the epoch before loading the pointer: a version retired in a later
+    // epoch is not reclaimed until this reader is gone.
+    auto slot = acquireSlot(epoch_.load());
+    return Reader{slot, current_.load()};
+}
+
+LiveConfig::Version* LiveConfig::load() const
+{
+    auto tree = ConfigTree::loadFile(file_, options_.load).freeze();
+    if (options_.validate)
+        options_.validate(tree);
+    return new Version{std::move(tree), 0};
+}
+
+void LiveConfig::publish(Version* version)
+{
+    version->generation = generation_.load(std::memory_order_relaxed) + 1;
+    auto previous = current_.exchange(version);
+    generation_.store(version->generation, std::memory_order_release);
+    retired_.emplace_back(previous, epoch_.fetch_add(1) + 1);
+    reclaim();
+}
+
+void LiveConfig::reclaim()
+{
+    auto minimum = std::numeric_limits<uint64_t>::max();
+    for (auto slot = slots_.load(); slot != nullptr; slot = slot->next) {
+        const auto epoch = slot->epoch.load();
+        if (epoch != 0)
+            minimum = std::min(minimum, epoch);
+    }
+    const auto end = std::remove_if(retired_.begin(), retired_.end(), [minimum](auto& retired) {
+        if (retired.second > minimum)
+            return false;
+        delete retired.first;
+        return true;
+    });
+    retired_.erase(end, retired_.end());
+}
+
+bool LiveConfig::reload()
+{
+    std::lock_guard reloadLock{reloadMutex_};
+    std::unique_ptr<Version> version;
+    try {
+        version.reset(load());
+    } catch (...) {
+        notify(std::current_exception());
+        return false;
+    }
+    std::lock_guard lock{writeMutex_};
+    publish(version.release());
+    return true;
+}
+
+void LiveConfig::notify(std::exception_ptr error) const
+{
+    if (options_.onError)
+        options_.onError(std::move(error));
+}
+
+#if defined(__linux__)
+
+static bool readEvents(int fd, const std::string& name)
+{
+    bool changed = false;
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        const auto size = ::read(fd, buffer, sizeof(buffer));
+        if (size <= 0)
+            break;
+        for (auto data = buffer; data < buffer + size;) {
+            auto event = reinterpret_cast<const inotify_event*>(data);
+            if (event->len != 0 && name == event->name)
+                changed = true;
+            data += sizeof(inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+
+#endif
+
+void LiveConfig::watch(FileStamp stamp)
+{
+    [[maybe_unused]] const auto name = file_.filename().native();
+
+    bool notified = false;
+    for (;;) {
+        // Not every file system supports inotify, so the file is checked on every
+        // wakeup as well. This also catches changes made while the initial version
+        // was loading.
+        const auto current = getFileStamp(file_);
+        const bool modified = current != stamp;
+        stamp = current;
+
+        if (notified || modified) {
+            reload();
+        } else {
+            std::lock_guard lock{writeMutex_};
+            reclaim();
+        }
+        notified = false;
+
+        pollfd fds[] = {{stopPipe_[0], POLLIN, 0}, {notifyFd_, POLLIN, 0}};
+        if (::poll(fds, std::size(fds), static_cast<int>(options_.pollInterval.count())) < 0) {
+            if (errno == EINTR)
+                continue;
+            notify(std::make_exception_ptr(
+                std::system_error{errno, std::generic_category(), "Cannot watch " + file_.native()}));
+            break;
+        }
+        if (fds[0].revents != 0)
+            break;
+
+#if defined(__linux__)
+        if (notifyFd_ >= 0 && (fds[1].revents & POLLIN))
+            notified = readEvents(notifyFd_, name);
+#endif
+    }
+}
+
+} // namespace confetti
@@ -0,0 +1,145 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_LIVE_CONFIG_HH
+#define CONFETTI_LIVE_CONFIG_HH
+
+#include "config_tree.hh"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace confetti {
+
+/// Configuration file that is reloaded in the background whenever it changes.
+///
+/// Every version is frozen, validated and then published with a single atomic
+/// pointer swap, so readers never block. Versions that readers may still hold
+/// are reclaimed once all of them are done (epoch-based reclamation).
+class LiveConfig final {
+    struct Version;
+    struct Slot;
+    struct FileStamp;
+
+public:
+    struct Options final {
+        /// Throws to reject a new version, the previous one stays in use.
+        std::function<void(const ConfigTree&)> validate;
+
+        /// Reports failed reloads, which are otherwise ignored.
+        std::function<void(std::exception_ptr)> onError;
+
+        /// How often to check for changes where file notifications are not available,
+        /// and to reclaim old versions.
+        std::chrono::milliseconds pollInterval{1000};
+
+        /// Versions are frozen right after loading, so an arena suits Lua configs best,
+        /// and a function shared by several entries needs to run only once.
+        ConfigLoadOptions load{LuaAllocator::Arena, LuaFunctions::Once};
+    };
+
+    /// Pins the current version for as long as it is alive.
+    class Reader final {
+    public:
+        Reader(Reader&& other) noexcept;
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        Reader& operator=(Reader&&) = delete;
+
+        ~Reader();
+
+        [[nodiscard]] const ConfigTree& operator*() const noexcept;
+
+        [[nodiscard]] const ConfigTree* operator->() const noexcept { return &**this; }
+
+        [[nodiscard]] uint64_t getGeneration() const noexcept;
+
+    private:
+        friend class LiveConfig;
+
+        Reader(Slot* slot, const Version* version) noexcept;
+
+        Slot* slot_;
+        const Version* version_;
+    };
+
+    explicit LiveConfig(std::filesystem::path file);
+
+    LiveConfig(std::filesystem::path file, Options options);
+
+    LiveConfig(const LiveConfig&) = delete;
+    LiveConfig& operator=(const LiveConfig&) = delete;
+
+    /// All readers must be gone by now.
+    ~LiveConfig();
+
+    [[nodiscard]] Reader read() const;
+
+    /// Returns a handle to the current version that stays valid after reloads.
+    [[nodiscard]] ConfigTree get() const { return *read(); }
+
+    /// Starts at 1 and increases with every published version.
+    [[nodiscard]] uint64_t getGeneration() const noexcept
+    {
+        return generation_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] const std::filesystem::path& getFile() const noexcept { return file_; }
+
+    /// Reloads the file on the calling thread. Returns false if the new version
+    /// failed to load or validate.
+    bool reload();
+
+private:
+    [[nodiscard]] Version* load() const;
+
+    void publish(Version* version);
+
+    void reclaim();
+
+    [[nodiscard]] Slot* acquireSlot(uint64_t epoch) const;
+
+    [[nodiscard]] static FileStamp getFileStamp(const std::filesystem::path& file);
+
+    void watch(FileStamp stamp);
+
+    void notify(std::exception_ptr error) const;
+
+    const std::filesystem::path file_;
+    const Options options_;
+    std::atomic<Version*> current_;
+    std::atomic<uint64_t> generation_;
+    std::atomic<uint64_t> epoch_;
+    mutable std::atomic<Slot*> slots_;
+    // Held across load and publish so that concurrent reloads publish in order.
+    std::mutex reloadMutex_;
+    std::mutex writeMutex_;
+    std::vector<std::pair<Version*, uint64_t>> retired_;
+    int stopPipe_[2];
+    int notifyFd_;
+    std::thread watcher_;
+};
+
+} // namespace confetti
+
+#endif // CONFETTI_LIVE_CONFIG_HH
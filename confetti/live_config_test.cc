@@ -0,0 +1,107 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "live_config.hh"
+#include <gtest/gtest.h>
+#include <fstream>
+
+namespace {
+
+class LiveConfigTest : public testing::Test {
+protected:
+    void SetUp() override
+    {
+        directory_ = std::filesystem::path{testing::TempDir()}
+            / (std::string{"confetti-"} + testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory_);
+        std::filesystem::create_directories(directory_);
+        file_ = directory_ / "live.json";
+        write(1);
+    }
+
+    void TearDown() override { std::filesystem::remove_all(directory_); }
+
+    // Replace the file the way editors do, by renaming a new one over it.
+    void write(int value) const
+    {
+        auto temp = file_;
+        temp += ".tmp";
+        std::ofstream{temp} << "{\"value\": " << value << "}\n";
+        std::filesystem::rename(temp, file_);
+    }
+
+    std::filesystem::path directory_;
+    std::filesystem::path file_;
+};
+
+} // namespace
+
+TEST_F(LiveConfigTest, Reload)
+{
+    confetti::LiveConfig cfg{file_};
+    EXPECT_EQ(1, cfg.getGeneration());
+    EXPECT_EQ(1, cfg.read()->get<int>("value"));
+    EXPECT_TRUE(cfg.get().isThreadSafe());
+
+    write(2);
+    EXPECT_TRUE(cfg.reload());
+    EXPECT_LE(2, cfg.getGeneration());
+    EXPECT_EQ(2, cfg.read()->get<int>("value"));
+}
+
+TEST_F(LiveConfigTest, ReaderKeepsVersion)
+{
+    confetti::LiveConfig cfg{file_};
+    auto reader = cfg.read();
+    auto tree = cfg.get();
+    for (int i = 2; i < 10; ++i) {
+        write(i);
+        ASSERT_TRUE(cfg.reload());
+    }
+    EXPECT_EQ(1, reader.getGeneration());
+    EXPECT_EQ(1, reader->get<int>("value"));
+    EXPECT_EQ(1, tree.get<int>("value"));
+    EXPECT_EQ(9, cfg.read()->get<int>("value"));
+}
+
+TEST_F(LiveConfigTest, RejectInvalid)
+{
+    size_t errors = 0;
+    confetti::LiveConfig::Options options;
+    options.validate = [](const confetti::ConfigTree& tree) {
+        if (tree.get<int>("value") < 0)
+            throw std::runtime_error{"negative value"};
+    };
+    options.onError = [&](std::exception_ptr) { ++errors; };
+    confetti::LiveConfig cfg{file_, options};
+
+    write(-1);
+    EXPECT_FALSE(cfg.reload());
+    EXPECT_EQ(1, cfg.read()->get<int>("value"));
+    EXPECT_LE(1, errors);
+
+    EXPECT_THROW(confetti::LiveConfig(directory_ / "missing.json"), std::exception);
+}
+
+TEST_F(LiveConfigTest, WatchFile)
+{
+    confetti::LiveConfig cfg{file_};
+    write(2);
+    for (int i = 0; i < 1000 && cfg.read()->get<int>("value") != 2; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    EXPECT_EQ(2, cfg.read()->get<int>("value"));
+    EXPECT_LE(2, cfg.getGeneration());
+}
@@ -0,0 +1,95 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "overlay_config.hh"
+#include "internal/snapshot.hh"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace confetti {
+
+OverlayConfig::OverlayConfig(std::vector<Layer> layers)
+    : layers_{std::move(layers)}
+{
+    flatten();
+}
+
+OverlayConfig::~OverlayConfig() = default;
+
+void OverlayConfig::flatten()
+{
+    std::vector<ConfigSourcePointer> snapshots;
+    std::vector<const internal::SnapshotSource*> tables;
+    snapshots.reserve(layers_.size());
+    tables.reserve(layers_.size());
+    for (const auto& layer : layers_) {
+        snapshots.push_back(layer.tree.getSnapshotSource());
+        tables.push_back(static_cast<const internal::SnapshotSource*>(snapshots.back().get()));
+    }
+    tree_ = ConfigTree{internal::mergeSnapshots(tables)->getRootSource()};
+    snapshots_ = std::move(snapshots);
+}
+
+ConfigTree OverlayConfig::getTree() const
+{
+    std::lock_guard lock{mutex_};
+    return tree_;
+}
+
+void OverlayConfig::setLayer(std::string_view name, ConfigTree tree)
+{
+    std::lock_guard lock{mutex_};
+    const auto it = std::find_if(layers_.begin(), layers_.end(),
+        [name](const Layer& layer) { return layer.name == name; });
+    if (it == layers_.end())
+        throw std::invalid_argument{"Unknown configuration layer '" + std::string{name} + "'"};
+    auto previous = std::exchange(it->tree, std::move(tree));
+    try {
+        flatten();
+    } catch (...) {
+        it->tree = std::move(previous);
+        throw;
+    }
+}
+
+std::optional<std::string> OverlayConfig::findLayer(const ConfigPath& path) const
+{
+    const CompiledConfigPath compiled{path};
+    const auto keys = compiled.getKeys();
+    std::lock_guard lock{mutex_};
+    for (auto i = snapshots_.size(); i-- > 0;) {
+        auto node = snapshots_[i];
+        size_t depth = 0;
+        for (; depth + 1 < keys.size(); ++depth) {
+            auto child = node->tryGetChild(keys[depth]);
+            if (!child)
+                break;
+            node = std::move(child);
+        }
+        if (depth + 1 < keys.size()) {
+            // A value on the way hides the path in the layers below, as it replaces them.
+            if (node->tryGetString(keys[depth]))
+                return {};
+            continue;
+        }
+        if (node->tryGetChild(keys.back()) || node->tryGetString(keys.back()))
+            return layers_[i].name;
+    }
+    return {};
+}
+
+} // namespace confetti
@@ -0,0 +1,73 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef CONFETTI_OVERLAY_CONFIG_HH
+#define CONFETTI_OVERLAY_CONFIG_HH
+
+#include "config_tree.hh"
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace confetti {
+
+/// Layers of configuration, such as defaults, site, host and command line overrides,
+/// flattened into one tree. Precedence is resolved whenever the layers change, so
+/// reads of the flattened tree cost a single lookup no matter how many layers there
+/// are. Tables merge by key, and any other value of a layer, arrays as a whole,
+/// replaces that of the layers below.
+class OverlayConfig final {
+public:
+    struct Layer final {
+        std::string name;
+        ConfigTree tree;
+    };
+
+    /// Takes the layers lowest precedence first.
+    explicit OverlayConfig(std::vector<Layer> layers);
+
+    OverlayConfig(const OverlayConfig&) = delete;
+    OverlayConfig& operator=(const OverlayConfig&) = delete;
+
+    ~OverlayConfig();
+
+    /// The flattened tree. It is frozen, and stays as is when layers change later.
+    [[nodiscard]] ConfigTree getTree() const;
+
+    [[nodiscard]] ConfigSourcePointer getSource() const { return getTree().source_; }
+
+    /// Replaces the tree of the named layer and flattens the layers again.
+    void setLayer(std::string_view name, ConfigTree tree);
+
+    /// Name of the layer the value or table at the path comes from, or nothing if the
+    /// flattened tree has nothing there. A merged table comes from the highest layer
+    /// that has it. Walks the layers, so it is meant for diagnostics rather than reads.
+    [[nodiscard]] std::optional<std::string> findLayer(const ConfigPath& path) const;
+
+private:
+    void flatten();
+
+    mutable std::mutex mutex_;
+    std::vector<Layer> layers_;
+    std::vector<ConfigSourcePointer> snapshots_; // Of the layers, as merged.
+    ConfigTree tree_;
+};
+
+} // namespace confetti
+
+#endif // CONFETTI_OVERLAY_CONFIG_HH
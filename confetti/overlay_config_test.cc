@@ -0,0 +1,101 @@
+//
+// Copyright (C) 2021 Vlad Lazarenko <vlad@lazarenko.me>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "overlay_config.hh"
+#include "internal/snapshot.hh"
+#include <gmock/gmock.h>
+
+using confetti::ConfigPath;
+
+static confetti::ConfigTree buildDefaults()
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("server");
+    builder.beginTable();
+    builder.setKey("host");
+    builder.addString("localhost");
+    builder.setKey("port");
+    builder.addInteger(80);
+    builder.setKey("limits");
+    builder.beginTable();
+    builder.setKey("connections");
+    builder.addInteger(100);
+    builder.endTable();
+    builder.endTable();
+    builder.setKey("log");
+    builder.beginTable();
+    builder.setKey("level");
+    builder.addString("info");
+    builder.endTable();
+    builder.endTable();
+    return confetti::ConfigTree{builder.finish()->getRootSource()};
+}
+
+static confetti::ConfigTree buildHost(int64_t port)
+{
+    confetti::internal::SnapshotBuilder builder;
+    builder.beginTable();
+    builder.setKey("server");
+    builder.beginTable();
+    builder.setKey("port");
+    builder.addInteger(port);
+    builder.endTable();
+    builder.setKey("log");
+    builder.addString("off");
+    builder.endTable();
+    return confetti::ConfigTree{builder.finish()->getRootSource()};
+}
+
+TEST(OverlayConfig, Flattens)
+{
+    confetti::OverlayConfig config{{{"defaults", buildDefaults()}, {"host", buildHost(8080)}}};
+    const auto tree = config.getTree();
+    EXPECT_TRUE(tree.isThreadSafe());
+    EXPECT_EQ("localhost", tree.get<std::string>(ConfigPath{"server.host"}));
+    EXPECT_EQ(8080, tree.get<int>(ConfigPath{"server.port"}));
+    EXPECT_EQ(100, tree.get<int>(ConfigPath{"server.limits.connections"}));
+    EXPECT_EQ("off", tree.get<std::string>("log"));
+    EXPECT_FALSE(tree.tryGet<std::string>(ConfigPath{"log.level"}));
+    EXPECT_EQ(8080, config.getSource()->tryGetChild("server")->tryGetNumber("port").value());
+}
+
+TEST(OverlayConfig, FindLayer)
+{
+    confetti::OverlayConfig config{{{"defaults", buildDefaults()}, {"host", buildHost(8080)}}};
+    EXPECT_EQ("defaults", config.findLayer(ConfigPath{"server.host"}));
+    EXPECT_EQ("host", config.findLayer(ConfigPath{"server.port"}));
+    EXPECT_EQ("host", config.findLayer(ConfigPath{"server"}));
+    EXPECT_EQ("defaults", config.findLayer(ConfigPath{"server.limits.connections"}));
+    EXPECT_EQ("host", config.findLayer(ConfigPath{"log"}));
+    EXPECT_FALSE(config.findLayer(ConfigPath{"log.level"}));
+    EXPECT_FALSE(config.findLayer(ConfigPath{"server.missing"}));
+}
+
+TEST(OverlayConfig, SetLayer)
+{
+    confetti::OverlayConfig config{
+        {{"defaults", buildDefaults()}, {"host", buildHost(8080)}, {"cli", {}}}};
+    const auto before = config.getTree();
+    config.setLayer("cli", buildHost(9090));
+    EXPECT_EQ(9090, config.getTree().get<int>(ConfigPath{"server.port"}));
+    EXPECT_EQ("cli", config.findLayer(ConfigPath{"server.port"}));
+    EXPECT_EQ(8080, before.get<int>(ConfigPath{"server.port"}));
+
+    config.setLayer("cli", {});
+    EXPECT_EQ(8080, config.getTree().get<int>(ConfigPath{"server.port"}));
+    EXPECT_THROW(config.setLayer("site", {}), std::invalid_argument);
+}